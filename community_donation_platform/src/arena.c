@@ -0,0 +1,42 @@
+// arena.c
+// Chunked record storage. Growing the table only ever allocates a new chunk and, once in a
+// while, a longer list of chunk pointers. Records already stored are never copied or moved.
+
+#include "arena.h"
+
+void arena_init(RecordArena *arena, size_t record_size) {
+    arena->record_size = record_size;
+    arena->count = 0;
+    arena->chunks = NULL;
+    arena->chunk_count = 0;
+    arena->chunk_capacity = 0;
+}
+
+void *arena_add(RecordArena *arena) {
+    // Need a new chunk when every existing one is full
+    if (arena->count == arena->chunk_count * ARENA_CHUNK_RECORDS) {
+        if (arena->chunk_count == arena->chunk_capacity) {
+            int new_capacity = arena->chunk_capacity ? arena->chunk_capacity * 2 : 16;
+            char **bigger = realloc(arena->chunks, sizeof(char *) * new_capacity);
+            if (!bigger) {
+                return NULL;
+            }
+            arena->chunks = bigger;
+            arena->chunk_capacity = new_capacity;
+        }
+        char *chunk = malloc(arena->record_size * ARENA_CHUNK_RECORDS);
+        if (!chunk) {
+            return NULL;
+        }
+        arena->chunks[arena->chunk_count++] = chunk;
+    }
+
+    void *record = arena_at(arena, arena->count);
+    memset(record, 0, arena->record_size);
+    arena->count++;
+    return record;
+}
+
+void arena_clear(RecordArena *arena) {
+    arena->count = 0;
+}
@@ -0,0 +1,42 @@
+// arena.h
+// A growable table of fixed-size records (items, requests, users). Records live in chunks
+// of ARENA_CHUNK_RECORDS; when a chunk fills up we allocate a new one instead of moving
+// the old ones, so a pointer to a record stays valid for as long as the program runs and
+// there is no upper limit on how many records we can hold.
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Each chunk holds 2^ARENA_CHUNK_SHIFT records
+#define ARENA_CHUNK_SHIFT 12
+#define ARENA_CHUNK_RECORDS (1 << ARENA_CHUNK_SHIFT)
+
+typedef struct {
+    size_t record_size;   // sizeof the record type
+    int count;            // how many records are in use
+    char **chunks;        // list of chunk pointers (only this list is ever reallocated)
+    int chunk_count;
+    int chunk_capacity;
+} RecordArena;
+
+// Sets up an empty arena for records of the given size
+void arena_init(RecordArena *arena, size_t record_size);
+
+// Makes room for one more record at the end and returns it (zeroed), or NULL if out of memory
+void *arena_add(RecordArena *arena);
+
+// Empties the arena but keeps its chunks to be filled again. Only for reloading a table
+// from scratch: pointers to old records will then point at whatever is stored there next.
+void arena_clear(RecordArena *arena);
+
+// Returns the record at a position (0 .. count - 1). No bounds check, so it stays cheap.
+static inline void *arena_at(const RecordArena *arena, int index) {
+    return arena->chunks[index >> ARENA_CHUNK_SHIFT] +
+           (size_t)(index & (ARENA_CHUNK_RECORDS - 1)) * arena->record_size;
+}
+
+#endif /* ARENA_H */
@@ -0,0 +1,607 @@
+// batch.c
+// Runs text commands against the same item, request and user code the menus use, but with
+// no prompts and no tables. Each command prints "ok ..." or "error ...", and listing commands
+// print one comma-separated row per record (quoted like the data files, see csv.h) before
+// their "ok <count>" line.
+//
+// Arguments are separated by spaces; put an argument in double quotes if it has spaces,
+// and write a double quote inside one as two ("").
+//   signup <username> <password> <donor|recipient>
+//   login <username> <password>
+//   add_item <donor> <category> <condition> <description>
+//   list                              (all available items)
+//   search <category>
+//   find <keywords...>                (best matches first, at most 50; see text_index.h)
+//   lookup <item|request> <id>        (through items.idx / requests.idx, see id_index.h;
+//                                      prints id,donor,category,description,condition,status
+//                                      or request_id,item_id,recipient,status)
+//   request <recipient> <item_id>
+//   approve <donor> <request_id>
+//   reject <donor> <request_id>
+//   decide <donor> <request_id> <approve|reject> [<request_id> <approve|reject> ...]
+//                                     (all in one group; prints request_id,outcome rows)
+//   allocate <donor> <item_id>        (approves whoever asked first, rejects the rest)
+//   inbox <donor>
+//   count <donor>
+//   inventory <recipient>
+//   wish <recipient> <category|any> <conditions|any> [keywords...]
+//                                     (conditions like New/Good; prints the wishlist_id)
+//   wishlists <recipient>             (wishlist_id,category,keywords,conditions rows)
+//   unwish <recipient> <wishlist_id>
+//   notifications <recipient>         (new matches since last time, as
+//                                      item_id,donor,category,description,condition,wishlist_id)
+//   stats [text|json]                 (call counts, latencies and file activity; see stats.h)
+//   help
+//   quit
+// Blank lines and lines starting with # are skipped.
+
+#include "batch.h"
+#include "user.h"
+#include "items.h"
+#include "requests.h"
+#include "wishlist.h"
+#include "text_index.h"
+#include "item_columns.h"
+#include "id_index.h"
+#include "stats.h"
+#include "csv.h"
+#include "data_watch.h"
+#include <ctype.h>
+
+#define MAX_DECISIONS 30   // request/decision pairs one decide command can take
+#define MAX_ARGS (2 + MAX_DECISIONS * 2 + 1)  // one spare, to notice a line with too many
+
+// Splits a line into arguments in place. Double quotes group words together, and a
+// doubled quote inside them ("") stands for one quote, like in the data files.
+// Returns the number of arguments found.
+static int split_args(char *line, char *args[], int max_args) {
+    int count = 0;
+    char *p = line;
+    while (*p && count < max_args) {
+        while (isspace((unsigned char)*p)) {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        if (*p == '"') {
+            p++;
+            args[count++] = p;
+            char *end = p;  // where the next character of the argument goes
+            while (*p && !(*p == '"' && p[1] != '"')) {
+                if (*p == '"') {
+                    p++;  // the first of two quotes
+                }
+                *end++ = *p++;
+            }
+            if (*p) {
+                p++;  // the closing quote
+            }
+            *end = '\0';
+            continue;
+        }
+        args[count++] = p;
+        while (*p && !isspace((unsigned char)*p)) {
+            p++;
+        }
+        if (*p) {
+            *p++ = '\0';
+        }
+    }
+    return count;
+}
+
+// Prints one item as a row: id,donor,category,description,condition
+// (rows are quoted like the data files, so a description may contain commas)
+static void print_item_row(const Item *item, void *context) {
+    char id[12];
+    snprintf(id, sizeof(id), "%d", item->item_id);
+    const char *row[] = { id, item->donor_username, item_category(item), item->description,
+                          item_condition(item) };
+    csv_write_row((FILE *)context, row, 5);
+}
+
+// Prints one item with its status: id,donor,category,description,condition,status
+static void print_indexed_item(const Item *item, FILE *out) {
+    char id[12];
+    snprintf(id, sizeof(id), "%d", item->item_id);
+    const char *row[] = { id, item->donor_username, item_category(item), item->description,
+                          item_condition(item), item_status(item) };
+    csv_write_row(out, row, 6);
+}
+
+// Prints one pending request as a row: request_id,item_id,recipient
+static void print_inbox_row(const Request *req, const Item *item, void *context) {
+    (void)item;
+    fprintf((FILE *)context, "%d,%d,%s\n", req->request_id, req->item_id, req->recipient_username);
+}
+
+// Prints one approved item as a row: request_id,item_id,category,description
+static void print_inventory_row(const Request *req, const Item *item, void *context) {
+    char request_id[12], item_id[12];
+    snprintf(request_id, sizeof(request_id), "%d", req->request_id);
+    snprintf(item_id, sizeof(item_id), "%d", req->item_id);
+    const char *row[] = { request_id, item_id, item_category(item), item->description };
+    csv_write_row((FILE *)context, row, 4);
+}
+
+// Prints one wishlist as a row: wishlist_id,category,keywords,conditions
+static void print_wishlist_row(const Wishlist *wishlist, void *context) {
+    char id[12];
+    snprintf(id, sizeof(id), "%d", wishlist->wishlist_id);
+    const char *row[] = { id, wishlist->category, wishlist->keywords, wishlist->conditions };
+    csv_write_row((FILE *)context, row, 4);
+}
+
+// Prints one notification as a row: item_id,donor,category,description,condition,wishlist_id
+static void print_notification_row(const Item *item, int wishlist_id, void *context) {
+    char item_id[12], wishlist_text[12];
+    snprintf(item_id, sizeof(item_id), "%d", item->item_id);
+    snprintf(wishlist_text, sizeof(wishlist_text), "%d", wishlist_id);
+    const char *row[] = { item_id, item->donor_username, item_category(item), item->description,
+                          item_condition(item), wishlist_text };
+    csv_write_row((FILE *)context, row, 6);
+}
+
+// Turns a WISHLIST_* error code into the words we print
+static const char *wishlist_error(int code) {
+    switch (code) {
+        case WISHLIST_TOO_BROAD:    return "need a category or a keyword";
+        case WISHLIST_TOO_LONG:     return "too long";
+        case WISHLIST_NOT_FOUND:    return "wishlist not found";
+        case WISHLIST_WRITE_FAILED: return "write failed";
+        default:                    return "failed";
+    }
+}
+
+// Turns a REQUEST_* error code into the word we print
+static const char *request_error(int code) {
+    switch (code) {
+        case REQUEST_NOT_FOUND:        return "request not found";
+        case REQUEST_ITEM_UNAVAILABLE: return "item not available";
+        case REQUEST_BAD_DECISION:     return "bad decision";
+        case REQUEST_WRITE_FAILED:     return "write failed";
+        case REQUEST_ALREADY_DECIDED:  return "already decided";
+        case REQUEST_OWN_ITEM:         return "own item";
+        default:                       return "failed";
+    }
+}
+
+// Checks the argument count; prints a usage error if it's wrong
+static int need_args(int argc, int wanted, const char *usage, FILE *out) {
+    if (argc != wanted) {
+        fprintf(out, "error usage: %s\n", usage);
+        return 0;
+    }
+    return 1;
+}
+
+// Checks that a command may act as the user it names, and (if role isn't NULL) that the
+// user has that role, as the menus would. In server mode it must be the logged-in user;
+// in plain batch mode it must at least be a user that exists.
+static int acting_as(const Session *session, const char *username, const char *role, FILE *out) {
+    if (!session->require_login) {
+        if (!role) {
+            return 1;  // only reads, which find nothing for an unknown user
+        }
+        User *user = find_user(username);
+        if (!user) {
+            fprintf(out, "error no such user\n");
+            return 0;
+        }
+        if (strcmp(user->role, role) != 0) {
+            fprintf(out, "error only a %s can do that\n", role);
+            return 0;
+        }
+        return 1;
+    }
+    if (!session->logged_in) {
+        fprintf(out, "error not logged in\n");
+        return 0;
+    }
+    if (strcmp(session->username, username) != 0) {
+        fprintf(out, "error logged in as %s\n", session->username);
+        return 0;
+    }
+    if (role && strcmp(session->role, role) != 0) {
+        fprintf(out, "error only a %s can do that\n", role);
+        return 0;
+    }
+    return 1;
+}
+
+// Returns 1 if the first word on the line is one of the count names, 0 if not
+static int command_is_one_of(const char *line, const char *const *names, size_t count) {
+    while (isspace((unsigned char)*line)) {
+        line++;
+    }
+    size_t length = strcspn(line, " \t\r\n");
+    for (size_t i = 0; i < count; i++) {
+        if (strlen(names[i]) == length && strncmp(line, names[i], length) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int is_write_command(const char *line) {
+    // login can read in accounts other programs have added, and lookup can catch an index
+    // up, so they count as writes
+    static const char *writers[] = {
+        "signup", "login", "add_item", "request", "approve", "reject", "decide", "allocate",
+        "wish", "unwish", "notifications", "lookup"
+    };
+    return command_is_one_of(line, writers, sizeof(writers) / sizeof(writers[0]));
+}
+
+int run_command(char *line, FILE *out, Session *session) {
+    line[strcspn(line, "\r\n")] = '\0';
+    char *args[MAX_ARGS];
+    int argc = split_args(line, args, MAX_ARGS);
+    if (argc == 0 || args[0][0] == '#') {
+        return BATCH_OK;
+    }
+    const char *cmd = args[0];
+
+    if (strcmp(cmd, "quit") == 0) {
+        fprintf(out, "ok bye\n");
+        return BATCH_QUIT;
+    } else if (strcmp(cmd, "help") == 0) {
+        fprintf(out, "ok commands: signup login add_item list search filter find lookup request "
+                     "approve reject decide allocate inbox count inventory wish wishlists unwish "
+                     "notifications stats help quit\n");
+    } else if (strcmp(cmd, "signup") == 0) {
+        if (!need_args(argc, 4, "signup <username> <password> <donor|recipient>", out)) {
+            return BATCH_ERROR;
+        }
+        if (strcmp(args[3], "donor") != 0 && strcmp(args[3], "recipient") != 0) {
+            fprintf(out, "error role must be donor or recipient\n");
+            return BATCH_ERROR;
+        }
+        if (strlen(args[1]) > 20 || strlen(args[2]) > 49 ||
+            strchr(args[1], ',') || strchr(args[2], ',')) {
+            fprintf(out, "error invalid username or password\n");
+            return BATCH_ERROR;
+        }
+        if (find_user(args[1])) {
+            fprintf(out, "error username taken\n");
+            return BATCH_ERROR;
+        }
+        User user;
+        memset(&user, 0, sizeof(user));
+        strcpy(user.username, args[1]);
+        strcpy(user.password, args[2]);
+        strcpy(user.role, args[3]);
+        if (!save_user(user)) {
+            fprintf(out, "error username taken\n");
+            return BATCH_ERROR;
+        }
+        fprintf(out, "ok\n");
+    } else if (strcmp(cmd, "login") == 0) {
+        if (!need_args(argc, 3, "login <username> <password>", out)) {
+            return BATCH_ERROR;
+        }
+        char role[10];
+        if (!validate_credentials(args[1], args[2], role)) {
+            fprintf(out, "error invalid credentials\n");
+            return BATCH_ERROR;
+        }
+        strncpy(session->username, args[1], sizeof(session->username) - 1);
+        session->username[sizeof(session->username) - 1] = '\0';
+        strcpy(session->role, role);
+        session->logged_in = 1;
+        fprintf(out, "ok %s\n", role);
+    } else if (strcmp(cmd, "add_item") == 0) {
+        if (!need_args(argc, 5, "add_item <donor> <category> <condition> <description>", out) ||
+            !acting_as(session, args[1], "donor", out)) {
+            return BATCH_ERROR;
+        }
+        int item_id = create_item(args[1], args[2], args[4], args[3]);
+        if (item_id <= 0) {
+            fprintf(out, "error write failed\n");
+            return BATCH_ERROR;
+        }
+        fprintf(out, "ok %d\n", item_id);
+    } else if (strcmp(cmd, "list") == 0) {
+        int count = visit_available_items(NULL, print_item_row, out);
+        fprintf(out, "ok %d\n", count);
+    } else if (strcmp(cmd, "search") == 0) {
+        if (!need_args(argc, 2, "search <category>", out)) {
+            return BATCH_ERROR;
+        }
+        int count = visit_available_items(args[1], print_item_row, out);
+        fprintf(out, "ok %d\n", count);
+    } else if (strcmp(cmd, "filter") == 0) {
+        if (argc < 3 || argc > 5) {
+            fprintf(out, "error usage: filter <category|any> <conditions|any> [donor|any] [from_item_id]\n");
+            return BATCH_ERROR;
+        }
+        ItemFilter filter;
+        item_filter_any(&filter);
+        filter.status = STATUS_AVAILABLE;
+        int possible = item_filter_for(args[1], args[2], &filter);
+        if (argc > 3 && strcmp(args[3], "any") != 0) {
+            use_item_columns();  // donor numbers come from the columns
+            filter.donor = item_columns_donor(args[3]);
+            possible = possible && filter.donor >= 0;
+        }
+        if (argc > 4) {
+            filter.min_id = atoi(args[4]);
+        }
+        int count = possible ? visit_filtered_items(&filter, print_item_row, out) : 0;
+        fprintf(out, "ok %d\n", count);
+    } else if (strcmp(cmd, "find") == 0) {
+        if (argc < 2) {
+            fprintf(out, "error usage: find <keywords...>\n");
+            return BATCH_ERROR;
+        }
+        // The keywords may come as separate arguments; put them back into one query
+        char query[200] = "";
+        for (int i = 1; i < argc; i++) {
+            if (i > 1) {
+                strncat(query, " ", sizeof(query) - strlen(query) - 1);
+            }
+            strncat(query, args[i], sizeof(query) - strlen(query) - 1);
+        }
+        int total = visit_keyword_matches(query, SEARCH_RESULT_LIMIT, print_item_row, out);
+        fprintf(out, "ok %d of %d\n", total < SEARCH_RESULT_LIMIT ? total : SEARCH_RESULT_LIMIT, total);
+    } else if (strcmp(cmd, "lookup") == 0) {
+        if (!need_args(argc, 3, "lookup <item|request> <id>", out)) {
+            return BATCH_ERROR;
+        }
+        int is_item = strcmp(args[1], "item") == 0;
+        if (!is_item && strcmp(args[1], "request") != 0) {
+            fprintf(out, "error usage: lookup <item|request> <id>\n");
+            return BATCH_ERROR;
+        }
+        Item item;
+        Request req;
+        int found = is_item ? find_indexed_item(atoi(args[2]), &item)
+                            : find_indexed_request(atoi(args[2]), &req);
+        if (found < 0) {
+            fprintf(out, "error no usable index (run --to-index)\n");
+            return BATCH_ERROR;
+        }
+        if (found == 0) {
+            fprintf(out, "error not found\n");
+            return BATCH_ERROR;
+        }
+        if (is_item) {
+            print_indexed_item(&item, out);
+        } else {
+            fprintf(out, "%d,%d,%s,%s\n", req.request_id, req.item_id, req.recipient_username,
+                    request_status(&req));
+        }
+        fprintf(out, "ok 1\n");
+    } else if (strcmp(cmd, "request") == 0) {
+        if (!need_args(argc, 3, "request <recipient> <item_id>", out) ||
+            !acting_as(session, args[1], "recipient", out)) {
+            return BATCH_ERROR;
+        }
+        int request_id = submit_request(args[1], atoi(args[2]));
+        if (request_id <= 0) {
+            fprintf(out, "error %s\n", request_error(request_id));
+            return BATCH_ERROR;
+        }
+        fprintf(out, "ok %d\n", request_id);
+    } else if (strcmp(cmd, "approve") == 0 || strcmp(cmd, "reject") == 0) {
+        if (!need_args(argc, 3, "approve|reject <donor> <request_id>", out) ||
+            !acting_as(session, args[1], "donor", out)) {
+            return BATCH_ERROR;
+        }
+        int code = decide_request(args[1], atoi(args[2]), cmd);
+        if (code != 0) {
+            fprintf(out, "error %s\n", request_error(code));
+            return BATCH_ERROR;
+        }
+        fprintf(out, "ok\n");
+    } else if (strcmp(cmd, "decide") == 0) {
+        if (argc < 4 || argc % 2 != 0 || argc > 2 + MAX_DECISIONS * 2) {
+            fprintf(out, "error usage: decide <donor> <request_id> <approve|reject> ... "
+                         "(at most %d pairs)\n", MAX_DECISIONS);
+            return BATCH_ERROR;
+        }
+        if (!acting_as(session, args[1], "donor", out)) {
+            return BATCH_ERROR;
+        }
+        Decision decisions[MAX_DECISIONS];
+        int count = (argc - 2) / 2;
+        for (int i = 0; i < count; i++) {
+            decisions[i].request_id = atoi(args[2 + i * 2]);
+            strncpy(decisions[i].decision, args[3 + i * 2], sizeof(decisions[i].decision) - 1);
+            decisions[i].decision[sizeof(decisions[i].decision) - 1] = '\0';
+        }
+        int applied = decide_requests(args[1], decisions, count);
+        if (applied == REQUEST_WRITE_FAILED) {
+            fprintf(out, "error %s\n", request_error(applied));
+            return BATCH_ERROR;
+        }
+        // One row per decision: request_id,approved|rejected or request_id,<error>
+        for (int i = 0; i < count; i++) {
+            const char *outcome = strcmp(decisions[i].decision, "approve") == 0 ? "approved" : "rejected";
+            fprintf(out, "%d,%s\n", decisions[i].request_id,
+                    decisions[i].result == 0 ? outcome : request_error(decisions[i].result));
+        }
+        fprintf(out, "ok %d of %d\n", applied, count);
+    } else if (strcmp(cmd, "allocate") == 0) {
+        if (!need_args(argc, 3, "allocate <donor> <item_id>", out) ||
+            !acting_as(session, args[1], "donor", out)) {
+            return BATCH_ERROR;
+        }
+        int request_id = allocate_item(args[1], atoi(args[2]));
+        if (request_id <= 0) {
+            fprintf(out, "error %s\n", request_error(request_id));
+            return BATCH_ERROR;
+        }
+        fprintf(out, "ok %d\n", request_id);
+    } else if (strcmp(cmd, "inbox") == 0) {
+        if (!need_args(argc, 2, "inbox <donor>", out) ||
+            !acting_as(session, args[1], NULL, out)) {
+            return BATCH_ERROR;
+        }
+        int count = visit_inbox(args[1], print_inbox_row, out);
+        fprintf(out, "ok %d\n", count);
+    } else if (strcmp(cmd, "count") == 0) {
+        if (!need_args(argc, 2, "count <donor>", out) ||
+            !acting_as(session, args[1], NULL, out)) {
+            return BATCH_ERROR;
+        }
+        fprintf(out, "ok %d\n", count_pending_requests(args[1]));
+    } else if (strcmp(cmd, "inventory") == 0) {
+        if (!need_args(argc, 2, "inventory <recipient>", out) ||
+            !acting_as(session, args[1], NULL, out)) {
+            return BATCH_ERROR;
+        }
+        int count = visit_inventory(args[1], print_inventory_row, out);
+        fprintf(out, "ok %d\n", count);
+    } else if (strcmp(cmd, "wish") == 0) {
+        if (argc < 4) {
+            fprintf(out, "error usage: wish <recipient> <category|any> <conditions|any> [keywords...]\n");
+            return BATCH_ERROR;
+        }
+        if (!acting_as(session, args[1], "recipient", out)) {
+            return BATCH_ERROR;
+        }
+        // The keywords may come as separate arguments; put them back together
+        char keywords[200] = "";
+        for (int i = 4; i < argc; i++) {
+            if (i > 4) {
+                strncat(keywords, " ", sizeof(keywords) - strlen(keywords) - 1);
+            }
+            strncat(keywords, args[i], sizeof(keywords) - strlen(keywords) - 1);
+        }
+        int wishlist_id = add_wishlist(args[1], args[2], keywords, args[3]);
+        if (wishlist_id <= 0) {
+            fprintf(out, "error %s\n", wishlist_error(wishlist_id));
+            return BATCH_ERROR;
+        }
+        fprintf(out, "ok %d\n", wishlist_id);
+    } else if (strcmp(cmd, "wishlists") == 0) {
+        if (!need_args(argc, 2, "wishlists <recipient>", out) ||
+            !acting_as(session, args[1], NULL, out)) {
+            return BATCH_ERROR;
+        }
+        int count = visit_wishlists(args[1], print_wishlist_row, out);
+        fprintf(out, "ok %d\n", count);
+    } else if (strcmp(cmd, "unwish") == 0) {
+        if (!need_args(argc, 3, "unwish <recipient> <wishlist_id>", out) ||
+            !acting_as(session, args[1], "recipient", out)) {
+            return BATCH_ERROR;
+        }
+        int code = cancel_wishlist(args[1], atoi(args[2]));
+        if (code != 0) {
+            fprintf(out, "error %s\n", wishlist_error(code));
+            return BATCH_ERROR;
+        }
+        fprintf(out, "ok\n");
+    } else if (strcmp(cmd, "notifications") == 0) {
+        if (!need_args(argc, 2, "notifications <recipient>", out) ||
+            !acting_as(session, args[1], "recipient", out)) {
+            return BATCH_ERROR;
+        }
+        int count = visit_new_notifications(args[1], print_notification_row, out);
+        fprintf(out, "ok %d\n", count);
+    } else if (strcmp(cmd, "stats") == 0) {
+        if (argc > 2 || (argc == 2 && strcmp(args[1], "text") != 0 && strcmp(args[1], "json") != 0)) {
+            fprintf(out, "error usage: stats [text|json]\n");
+            return BATCH_ERROR;
+        }
+        stats_dump(out, argc == 2 && strcmp(args[1], "json") == 0);
+        fprintf(out, "ok\n");
+    } else {
+        fprintf(out, "error unknown command %s\n", cmd);
+        return BATCH_ERROR;
+    }
+    return BATCH_OK;
+}
+
+int read_command_line(FILE *input, char *line, int size) {
+    if (!fgets(line, size, input)) {
+        return 0;
+    }
+    size_t length = strlen(line);
+    if (length > 0 && line[length - 1] == '\n') {
+        return 1;
+    }
+    // No line end: either this is the last line of the input, the line exactly filled the
+    // buffer, or it is too long. Only the last case is a problem.
+    int c = getc(input);
+    if (c == EOF || c == '\n') {
+        return 1;
+    }
+    while (c != '\n' && c != EOF) {
+        c = getc(input);
+    }
+    return LINE_TOO_LONG;
+}
+
+int run_batch(FILE *input, FILE *out) {
+    Session session;
+    memset(&session, 0, sizeof(session));
+
+    load_users();
+    load_items();
+    load_requests();
+    load_wishlists();
+
+    char line[512];
+    int failed = 0;
+    int got;
+    while ((got = read_command_line(input, line, sizeof(line))) != 0) {
+        stats_poll();
+        if (got == LINE_TOO_LONG) {
+            fprintf(out, "error line too long\n");
+            failed++;
+            continue;
+        }
+        // Commands may arrive slowly (from a pipe), so catch up with other programs first
+        if (data_watch_changed()) {
+            refresh_data();
+        }
+        int result = run_command(line, out, &session);
+        if (result == BATCH_QUIT) {
+            break;
+        }
+        if (result == BATCH_ERROR) {
+            failed++;
+        }
+    }
+    fflush(out);
+    return failed;
+}
+
+int run_lookups(FILE *input, FILE *out) {
+    // None of the commands here touch the stores, so they are never loaded
+    static const char *allowed[] = { "lookup", "stats", "help", "quit" };
+    Session session;
+    memset(&session, 0, sizeof(session));
+
+    char line[512];
+    int failed = 0;
+    int got;
+    while ((got = read_command_line(input, line, sizeof(line))) != 0) {
+        stats_poll();
+        if (got == LINE_TOO_LONG) {
+            fprintf(out, "error line too long\n");
+            failed++;
+            continue;
+        }
+        // Blank lines and comments are fine too
+        size_t start = strspn(line, " \t\r\n");
+        if (line[start] != '\0' && line[start] != '#' &&
+            !command_is_one_of(line, allowed, sizeof(allowed) / sizeof(allowed[0]))) {
+            fprintf(out, "error only lookup, stats, help and quit work with --lookup\n");
+            failed++;
+            continue;
+        }
+        int result = run_command(line, out, &session);
+        if (result == BATCH_QUIT) {
+            break;
+        }
+        if (result == BATCH_ERROR) {
+            failed++;
+        }
+    }
+    fflush(out);
+    return failed;
+}
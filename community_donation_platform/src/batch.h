@@ -0,0 +1,52 @@
+// batch.h
+// Batch mode: instead of menus, the program reads one command per line (from a file or a
+// pipe) and prints a short result for each one. This is handy for bulk imports, scripts
+// and load tests. Run it with:  ./donation_platform --batch commands.txt
+// (or leave off the file name to read commands from standard input).
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Who is logged in while commands run (set by the "login" command)
+typedef struct {
+    char username[50];
+    char role[10];
+    int logged_in;
+    int require_login;  // if set, commands may only act as the logged-in user (server mode)
+} Session;
+
+// What run_command returns
+#define BATCH_OK 1      // the command worked (or the line was blank or a comment)
+#define BATCH_ERROR 0   // the command failed and an "error ..." line was printed
+#define BATCH_QUIT -1   // the command was "quit"
+
+// Runs a single command line (changing it in place) and writes the result to out
+int run_command(char *line, FILE *out, Session *session);
+
+// Returns 1 if the command on this line may change the in-memory data (signup, login,
+// add_item, request, approve, reject), 0 if it only reads. The line is not changed.
+int is_write_command(const char *line);
+
+// What read_command_line returns besides 1 (a whole line was read) and 0 (end of input)
+#define LINE_TOO_LONG -1  // the line didn't fit; the rest of it was read and thrown away
+
+// Reads one command line into line (at most size - 1 characters). A longer line is never
+// cut into pieces that would each run as a command of their own.
+int read_command_line(FILE *input, char *line, int size);
+
+// Runs every command from input until the end of the input (or "quit").
+// Returns how many commands failed.
+int run_batch(FILE *input, FILE *out);
+
+// Like run_batch, but only for lookup (plus stats, help and quit), and without loading the
+// users, items, requests or wishlists: every record comes from the ID indexes, so memory
+// use stays the same however big the data files grow. Run it with:
+//   ./donation_platform --lookup [file]
+// Returns how many commands failed (including any other command, which is refused).
+int run_lookups(FILE *input, FILE *out);
+
+#endif /* BATCH_H */
@@ -0,0 +1,752 @@
+// bench.c
+// Benchmark for the donation platform. It writes synthetic users.txt, items.txt,
+// requests.txt and wishlists.txt (with a few very popular categories and donors, like real
+// data), then times
+// the platform operations directly, without going through the menus, and prints the
+// results as JSON so runs can be compared between builds.
+//
+// Build (from the src directory):
+//   gcc -O2 -o bench bench.c user.c items.c requests.c status_log.c id_sequence.c binary_table.c arena.c
+//       file_lock.c text_index.c stats.c durable.c csv.c data_watch.c wishlist.c dictionary.c
+//       item_columns.c btree.c id_index.c -lm -lpthread
+// (add -mavx2 to compare the AVX2 filter kernel with the default SSE2 one)
+// Run:
+//   ./bench --items 1000000 --users 10000 --requests 200000 > results.json
+// To see what standing wishlists cost when items are added, compare --wishlists 0 with
+// --wishlists 300000.
+// With --stats the platform's own counters (see stats.h) are printed to stderr afterwards.
+//
+// The data is generated in <dir>/data and the benchmark runs from <dir>/run, so the
+// platform's "../data/..." paths point at the generated files, never at the real data.
+
+#include "user.h"
+#include "items.h"
+#include "requests.h"
+#include "wishlist.h"
+#include "item_columns.h"
+#include "id_index.h"
+#include "stats.h"
+#include "csv.h"
+#include <math.h>
+#include <time.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>     // For _chdir()
+#include <io.h>         // For _dup(), _dup2()
+#include <fcntl.h>
+#define chdir _chdir
+#define dup _dup
+#define dup2 _dup2
+#define NULL_DEVICE "NUL"
+#else
+#include <fcntl.h>      // For open()
+#include <unistd.h>     // For chdir(), dup(), dup2()
+#define NULL_DEVICE "/dev/null"
+#endif
+
+// Everything that can be set on the command line
+typedef struct {
+    int users;
+    int items;
+    int requests;
+    int wishlists;
+    int iterations;       // repetitions for point operations (login, request, inbox, ...)
+    int scan_iterations;  // repetitions for operations that walk a large part of the data
+    unsigned int seed;
+    const char *dir;
+} BenchConfig;
+
+// Timing results for one operation
+typedef struct {
+    const char *name;
+    int iterations;
+    double mean_us;
+    double p50_us;
+    double p99_us;
+    double max_us;
+    double total_ms;
+} BenchResult;
+
+#define MAX_RESULTS 32
+static BenchResult results[MAX_RESULTS];
+static int result_count = 0;
+static double csv_mb_per_s = 0;     // items.txt parse speed with the shared reader
+static double fscanf_mb_per_s = 0;  // the same with the old fscanf loop, for comparison
+static double matches_per_item = 0; // wishlists a new item fits, on average
+static int filter_mismatches = 0;   // filters where the columns and the row loop disagreed
+static int index_mismatches = 0;    // index lookups that disagreed with the in-memory store
+static double index_pages_per_lookup = 0;  // index pages read from the file per lookup
+
+// ---------- random numbers ----------
+
+static unsigned long long rng_state = 88172645463325252ULL;
+
+// xorshift64: small, fast, and the same on every platform for a given seed
+static unsigned long long next_random() {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// A random number in [0, n)
+static int random_below(int n) {
+    return (int)(next_random() % (unsigned long long)n);
+}
+
+// A random number in [0, 1)
+static double random_unit() {
+    return (double)(next_random() >> 11) / 9007199254740992.0;
+}
+
+// Zipf distribution over 0 .. n-1: low numbers are picked far more often than high ones
+typedef struct {
+    double *cdf;
+    int n;
+} Zipf;
+
+static int zipf_init(Zipf *z, int n, double exponent) {
+    z->n = n;
+    z->cdf = malloc(sizeof(double) * (size_t)n);
+    if (!z->cdf) {
+        return 0;
+    }
+    double total = 0;
+    for (int k = 0; k < n; k++) {
+        total += 1.0 / pow(k + 1, exponent);
+        z->cdf[k] = total;
+    }
+    for (int k = 0; k < n; k++) {
+        z->cdf[k] /= total;
+    }
+    return 1;
+}
+
+static int zipf_pick(const Zipf *z) {
+    double u = random_unit();
+    int lo = 0, hi = z->n - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (z->cdf[mid] < u) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// ---------- timing ----------
+
+// Current time in microseconds
+static double now_us() {
+    struct timespec ts;
+#ifdef _WIN32
+    timespec_get(&ts, TIME_UTC);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted samples: the smallest sample that at least p of the
+// samples don't exceed (p = 0.5 for the median)
+static double nearest_rank(const double *sorted, int count, double p) {
+    int rank = (int)ceil(p * count);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// Turns a list of per-call times into a BenchResult
+static void record_result(const char *name, double *samples, int count) {
+    if (result_count == MAX_RESULTS || count == 0) {
+        return;
+    }
+    qsort(samples, (size_t)count, sizeof(double), compare_doubles);
+    double total = 0;
+    for (int i = 0; i < count; i++) {
+        total += samples[i];
+    }
+    BenchResult *r = &results[result_count++];
+    r->name = name;
+    r->iterations = count;
+    r->mean_us = total / count;
+    r->p50_us = nearest_rank(samples, count, 0.5);
+    r->p99_us = nearest_rank(samples, count, 0.99);
+    r->max_us = samples[count - 1];
+    r->total_ms = total / 1000.0;
+}
+
+// ---------- synthetic data ----------
+
+static const char *category_names[] = {
+    "Clothes", "Books", "Furniture", "Electronics", "Toys", "Kitchen", "Shoes", "Sports",
+    "Tools", "Baby", "Garden", "Music", "Art", "Bedding", "Games", "Office",
+    "Pets", "Bikes", "Lighting", "Decor", "Crafts", "Camping", "Luggage", "Medical"
+};
+#define CATEGORY_COUNT ((int)(sizeof(category_names) / sizeof(category_names[0])))
+
+static const char *conditions[] = { "New", "Good", "Fair" };
+static const char *words[] = {
+    "winter", "coat", "jacket", "chair", "table", "lamp", "novel", "textbook", "laptop",
+    "phone", "blanket", "stroller", "puzzle", "bicycle", "kettle", "boots", "desk", "shelf"
+};
+#define WORD_COUNT ((int)(sizeof(words) / sizeof(words[0])))
+
+// Details people add to a wishlist ("winter coat, wool"). Item descriptions never contain
+// them, so only the wishlists without one can actually match a generated item.
+static const char *details[] = {
+    "wool", "leather", "oak", "red", "blue", "vintage", "waterproof", "foldable", "toddler",
+    "electric", "cast", "hardcover", "bluetooth", "ergonomic", "insulated", "kids", "queen",
+    "stainless", "mountain", "acoustic"
+};
+#define DETAIL_COUNT ((int)(sizeof(details) / sizeof(details[0])))
+
+// Donors are donor0..donorN-1 and recipients recip0..recipM-1 (half the users each)
+static int donor_count(const BenchConfig *cfg) {
+    return cfg->users / 2 > 0 ? cfg->users / 2 : 1;
+}
+
+static int recipient_count(const BenchConfig *cfg) {
+    return cfg->users - donor_count(cfg) > 0 ? cfg->users - donor_count(cfg) : 1;
+}
+
+// Creates a directory if it isn't there yet
+static void make_directory(const char *path) {
+#ifdef _WIN32
+    _mkdir(path);
+#else
+    mkdir(path, 0700);
+#endif
+}
+
+// Writes users.txt, items.txt, requests.txt and wishlists.txt into <dir>/data.
+// Returns 1 on success.
+static int generate_data(const BenchConfig *cfg) {
+    char path[512];
+    make_directory(cfg->dir);
+    snprintf(path, sizeof(path), "%s/data", cfg->dir);
+    make_directory(path);
+    snprintf(path, sizeof(path), "%s/run", cfg->dir);
+    make_directory(path);
+
+    // Start clean: leftovers from an earlier run would change the results
+    const char *extras[] = { "status_log.txt", "items.seq", "requests.seq", "items.bin", "requests.bin",
+                             "wishlists.seq", "notifications.txt", "notifications_seen.txt" };
+    for (int i = 0; i < (int)(sizeof(extras) / sizeof(extras[0])); i++) {
+        snprintf(path, sizeof(path), "%s/data/%s", cfg->dir, extras[i]);
+        remove(path);
+    }
+
+    // users.txt
+    snprintf(path, sizeof(path), "%s/data/users.txt", cfg->dir);
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        return 0;
+    }
+    fprintf(file, "username,password,role\n");
+    for (int i = 0; i < donor_count(cfg); i++) {
+        fprintf(file, "donor%d,pw%d,donor\n", i, i);
+    }
+    for (int i = 0; i < recipient_count(cfg); i++) {
+        fprintf(file, "recip%d,pw%d,recipient\n", i, i);
+    }
+    fclose(file);
+
+    // items.txt: popular categories and donors get most of the items
+    Zipf categories, donors;
+    if (!zipf_init(&categories, CATEGORY_COUNT, 1.1) || !zipf_init(&donors, donor_count(cfg), 1.0)) {
+        return 0;
+    }
+    snprintf(path, sizeof(path), "%s/data/items.txt", cfg->dir);
+    file = fopen(path, "w");
+    if (!file) {
+        return 0;
+    }
+    fprintf(file, "item_id,donor_username,category,description,condition,status\n");
+    for (int i = 1; i <= cfg->items; i++) {
+        fprintf(file, "%d,donor%d,%s,%s %s %d,%s,%s\n", i, zipf_pick(&donors),
+                category_names[zipf_pick(&categories)],
+                words[random_below(WORD_COUNT)], words[random_below(WORD_COUNT)], i,
+                conditions[random_below(3)], random_below(10) < 7 ? "available" : "donated");
+    }
+    fclose(file);
+    free(categories.cdf);
+    free(donors.cdf);
+
+    // requests.txt: mostly pending, some already decided
+    snprintf(path, sizeof(path), "%s/data/requests.txt", cfg->dir);
+    file = fopen(path, "w");
+    if (!file) {
+        return 0;
+    }
+    fprintf(file, "request_id,item_id,recipient_username,status\n");
+    for (int i = 1; i <= cfg->requests; i++) {
+        int roll = random_below(20);
+        const char *status = roll < 12 ? "pending" : (roll < 17 ? "approved" : "rejected");
+        fprintf(file, "%d,%d,recip%d,%s\n", i, 1 + random_below(cfg->items > 0 ? cfg->items : 1),
+                random_below(recipient_count(cfg)), status);
+    }
+    fclose(file);
+
+    // wishlists.txt: mostly a category, a word and a detail; a few broad ones without
+    // the detail; some for any category
+    if (!zipf_init(&categories, CATEGORY_COUNT, 1.1)) {
+        return 0;
+    }
+    snprintf(path, sizeof(path), "%s/data/wishlists.txt", cfg->dir);
+    file = fopen(path, "w");
+    if (!file) {
+        return 0;
+    }
+    fprintf(file, "wishlist_id,recipient_username,category,keywords,conditions,status\n");
+    for (int i = 1; i <= cfg->wishlists; i++) {
+        int roll = random_below(100);
+        fprintf(file, "%d,recip%d,%s,%s%s%s,%s,active\n", i, random_below(recipient_count(cfg)),
+                roll < 70 ? category_names[zipf_pick(&categories)] : "any",
+                words[random_below(WORD_COUNT)], roll % 50 ? " " : "",
+                roll % 50 ? details[random_below(DETAIL_COUNT)] : "",
+                random_below(2) ? "any" : "New/Good");
+    }
+    fclose(file);
+    free(categories.cdf);
+    return 1;
+}
+
+// ---------- the benchmarks ----------
+
+// Picks a random item that is still available (or 0 if there are none)
+static int random_available_item() {
+    int total = item_total();
+    if (total == 0 || count_available_items() == 0) {
+        return 0;
+    }
+    for (int tries = 0; tries < 1000; tries++) {
+        Item *item = item_at(random_below(total));
+        if (item->status == STATUS_AVAILABLE) {
+            return item->item_id;
+        }
+    }
+    return 0;
+}
+
+// Parses all of items.txt without storing anything, either with the shared CSV reader or
+// with the fscanf loop the loaders used before it. Returns the bytes parsed.
+static long long parse_items_file(int use_fscanf) {
+    FILE *file = fopen("../data/items.txt", "r");
+    if (!file) {
+        return 0;
+    }
+    Item item;
+    int rows = 0;
+    long long bytes;
+    if (use_fscanf) {
+        char header[200], category[21], condition[21], status[21];
+        if (fgets(header, sizeof(header), file)) {
+            while (fscanf(file, "%d,%20[^,],%20[^,],%99[^,],%20[^,],%20[^\n]\n",
+                          &item.item_id, item.donor_username, category, item.description,
+                          condition, status) == 6) {
+                rows++;
+            }
+        }
+        bytes = ftell(file);
+    } else {
+        CsvReader reader;
+        if (!csv_open(&reader, file, "items.txt")) {
+            fclose(file);
+            return 0;
+        }
+        while (csv_next(&reader)) {
+            rows += item_from_row(&reader, &item);
+        }
+        bytes = reader.offset;
+        csv_close(&reader);
+    }
+    fclose(file);
+    return rows > 0 ? bytes : 0;
+}
+
+// visit_wishlist_matches needs a visitor; counting is all we want
+static void count_match(const Wishlist *wishlist, void *context) {
+    (void)wishlist;
+    (void)context;
+}
+
+static void run_benchmarks(const BenchConfig *cfg) {
+    int n = cfg->iterations > cfg->scan_iterations ? cfg->iterations : cfg->scan_iterations;
+    double *samples = malloc(sizeof(double) * (size_t)(n > 0 ? n : 1));
+    char name[64], password[64], role[10];
+    Zipf donors, categories;
+    zipf_init(&donors, donor_count(cfg), 1.0);
+    zipf_init(&categories, CATEGORY_COUNT, 1.1);
+
+    // Loading the data files (what every process pays at startup)
+    double start = now_us();
+    load_users();
+    samples[0] = now_us() - start;
+    record_result("load_users", samples, 1);
+
+    start = now_us();
+    load_items();
+    samples[0] = now_us() - start;
+    record_result("load_items", samples, 1);
+
+    start = now_us();
+    load_requests();
+    samples[0] = now_us() - start;
+    record_result("load_requests", samples, 1);
+
+    start = now_us();
+    load_wishlists();
+    samples[0] = now_us() - start;
+    record_result("load_wishlists", samples, 1);
+
+    // Building the filter columns from the store (display_items would otherwise do it)
+    start = now_us();
+    use_item_columns();
+    samples[0] = now_us() - start;
+    record_result("use_item_columns", samples, 1);
+
+    // Raw parse speed of items.txt (the biggest file), in MB/s
+    const char *parse_names[] = { "csv_parse_items", "fscanf_parse_items" };
+    for (int use_fscanf = 0; use_fscanf <= 1; use_fscanf++) {
+        long long bytes = 0;
+        for (int i = 0; i < cfg->scan_iterations; i++) {
+            start = now_us();
+            bytes = parse_items_file(use_fscanf);
+            samples[i] = now_us() - start;
+        }
+        record_result(parse_names[use_fscanf], samples, cfg->scan_iterations);
+        double speed = bytes / results[result_count - 1].mean_us;  // bytes per us = MB/s
+        if (use_fscanf) {
+            fscanf_mb_per_s = speed;
+        } else {
+            csv_mb_per_s = speed;
+        }
+    }
+
+    // validate_credentials: a random existing donor each time
+    for (int i = 0; i < cfg->iterations; i++) {
+        int d = random_below(donor_count(cfg));
+        snprintf(name, sizeof(name), "donor%d", d);
+        snprintf(password, sizeof(password), "pw%d", d);
+        start = now_us();
+        validate_credentials(name, password, role);
+        samples[i] = now_us() - start;
+    }
+    record_result("validate_credentials", samples, cfg->iterations);
+
+    // display_items walks the whole catalog
+    for (int i = 0; i < cfg->scan_iterations; i++) {
+        start = now_us();
+        display_items();
+        samples[i] = now_us() - start;
+    }
+    record_result("display_items", samples, cfg->scan_iterations);
+
+    // search_items for a category picked the way users would (popular ones more often)
+    for (int i = 0; i < cfg->scan_iterations; i++) {
+        const char *category = category_names[zipf_pick(&categories)];
+        start = now_us();
+        show_category(category);
+        samples[i] = now_us() - start;
+    }
+    record_result("search_items", samples, cfg->scan_iterations);
+
+    // "available AND category X AND condition New or Good", first one record at a time,
+    // then over the columns with the SIMD kernel
+    unsigned long long *selection = malloc(sizeof(unsigned long long) * (item_columns_words() + 1));
+    int *row_matches = malloc(sizeof(int) * (size_t)(cfg->scan_iterations > 0 ? cfg->scan_iterations : 1));
+    ItemFilter *filters = malloc(sizeof(ItemFilter) * (size_t)(cfg->scan_iterations > 0 ? cfg->scan_iterations : 1));
+    for (int i = 0; i < cfg->scan_iterations; i++) {
+        item_filter_any(&filters[i]);
+        filters[i].status = STATUS_AVAILABLE;
+        item_filter_for(category_names[zipf_pick(&categories)], "New/Good", &filters[i]);
+    }
+    int total = item_total();
+    for (int i = 0; i < cfg->scan_iterations; i++) {
+        start = now_us();
+        int matched = 0;
+        for (int j = 0; j < total; j++) {
+            matched += item_matches_filter(&filters[i], item_at(j));
+        }
+        samples[i] = now_us() - start;
+        row_matches[i] = matched;
+    }
+    record_result("filter_rows", samples, cfg->scan_iterations);
+    for (int i = 0; i < cfg->scan_iterations; i++) {
+        start = now_us();
+        int matched = selection ? item_columns_filter(&filters[i], selection) : 0;
+        samples[i] = now_us() - start;
+        if (matched != row_matches[i]) {
+            filter_mismatches++;
+        }
+    }
+    record_result("filter_columns", samples, cfg->scan_iterations);
+    free(selection);
+    free(row_matches);
+    free(filters);
+
+    // Building items.idx and requests.idx, then point lookups through them (compared with
+    // the in-memory store, which must agree)
+    start = now_us();
+    build_item_index();
+    build_request_index();
+    samples[0] = now_us() - start;
+    record_result("build_index", samples, 1);
+
+    long long pages_before = index_pages_read();
+    for (int i = 0; i < cfg->iterations; i++) {
+        Item *expected = item_at(random_below(item_total()));
+        Item found;
+        start = now_us();
+        int ok = find_indexed_item(expected->item_id, &found);
+        samples[i] = now_us() - start;
+        if (ok != 1 || strcmp(found.description, expected->description) != 0 ||
+            found.status != expected->status) {
+            index_mismatches++;
+        }
+    }
+    record_result("index_find_item", samples, cfg->iterations);
+
+    for (int i = 0; i < cfg->iterations; i++) {
+        int request_id = random_below(cfg->requests > 0 ? cfg->requests : 1) + 1;
+        Request *expected = find_request(request_id);
+        Request found;
+        start = now_us();
+        int ok = find_indexed_request(request_id, &found);
+        samples[i] = now_us() - start;
+        if (ok != (expected != NULL) || (expected && (found.item_id != expected->item_id ||
+                                                      found.status != expected->status))) {
+            index_mismatches++;
+        }
+    }
+    record_result("index_find_request", samples, cfg->iterations);
+    if (cfg->iterations > 0) {
+        long long pages = index_pages_read() - pages_before;
+        index_pages_per_lookup = (double)pages / (2.0 * cfg->iterations);
+    }
+
+    // keyword_search: single words, two-word AND, OR and prefix queries in turn
+    char query[100];
+    for (int i = 0; i < cfg->iterations; i++) {
+        const char *first = words[random_below(WORD_COUNT)];
+        const char *second = words[random_below(WORD_COUNT)];
+        switch (i % 4) {
+            case 0: snprintf(query, sizeof(query), "%s", first); break;
+            case 1: snprintf(query, sizeof(query), "%s %s", first, second); break;
+            case 2: snprintf(query, sizeof(query), "%s OR %s", first, second); break;
+            default: snprintf(query, sizeof(query), "%.3s*", first); break;
+        }
+        start = now_us();
+        show_keyword_search(query);
+        samples[i] = now_us() - start;
+    }
+    record_result("keyword_search", samples, cfg->iterations);
+
+    // request_item: remember what we requested so we can approve it below
+    int *new_requests = malloc(sizeof(int) * (size_t)(cfg->iterations > 0 ? cfg->iterations : 1));
+    int made = 0;
+    for (int i = 0; i < cfg->iterations; i++) {
+        int item_id = random_available_item();
+        if (item_id == 0) {
+            break;
+        }
+        snprintf(name, sizeof(name), "recip%d", random_below(recipient_count(cfg)));
+        start = now_us();
+        int request_id = submit_request(name, item_id);
+        samples[made] = now_us() - start;
+        if (request_id > 0) {
+            new_requests[made++] = request_id;
+        }
+    }
+    record_result("request_item", samples, made);
+
+    // approve_request: approve half of them, reject the other half
+    for (int i = 0; i < made; i++) {
+        Request *req = find_request(new_requests[i]);
+        Item *item = req ? find_item(req->item_id) : NULL;
+        if (!item) {
+            samples[i] = 0;
+            continue;
+        }
+        start = now_us();
+        decide_request(item->donor_username, new_requests[i], i % 2 ? "reject" : "approve");
+        samples[i] = now_us() - start;
+    }
+    record_result("approve_request", samples, made);
+    free(new_requests);
+
+    // view_inbox and count_pending_requests for donors (busy donors more often)
+    for (int i = 0; i < cfg->iterations; i++) {
+        snprintf(name, sizeof(name), "donor%d", zipf_pick(&donors));
+        start = now_us();
+        view_inbox(name);
+        samples[i] = now_us() - start;
+    }
+    record_result("view_inbox", samples, cfg->iterations);
+
+    for (int i = 0; i < cfg->iterations; i++) {
+        snprintf(name, sizeof(name), "donor%d", zipf_pick(&donors));
+        start = now_us();
+        count_pending_requests(name);
+        samples[i] = now_us() - start;
+    }
+    record_result("count_pending_requests", samples, cfg->iterations);
+
+    // view_inventory for random recipients
+    for (int i = 0; i < cfg->scan_iterations; i++) {
+        snprintf(name, sizeof(name), "recip%d", random_below(recipient_count(cfg)));
+        start = now_us();
+        view_inventory(name);
+        samples[i] = now_us() - start;
+    }
+    record_result("view_inventory", samples, cfg->scan_iterations);
+
+    // wishlist_match: which wishlists a new item fits (in memory only), then add_item,
+    // which also writes the item and the notifications for it
+    long long matches = 0;
+    for (int i = 0; i < cfg->iterations; i++) {
+        Item item;
+        memset(&item, 0, sizeof(item));
+        item.item_id = cfg->items + 1 + i;
+        item.category = (unsigned short)dict_code(DICT_CATEGORY, category_names[zipf_pick(&categories)]);
+        snprintf(item.description, sizeof(item.description), "%s %s %d",
+                 words[random_below(WORD_COUNT)], words[random_below(WORD_COUNT)], item.item_id);
+        item.condition = (unsigned short)dict_code(DICT_CONDITION, conditions[random_below(3)]);
+        start = now_us();
+        matches += visit_wishlist_matches(&item, count_match, NULL);
+        samples[i] = now_us() - start;
+    }
+    record_result("wishlist_match", samples, cfg->iterations);
+    matches_per_item = (double)matches / cfg->iterations;
+
+    for (int i = 0; i < cfg->iterations; i++) {
+        char description[100];
+        snprintf(description, sizeof(description), "%s %s new%d", words[random_below(WORD_COUNT)],
+                 words[random_below(WORD_COUNT)], i);
+        snprintf(name, sizeof(name), "donor%d", zipf_pick(&donors));
+        start = now_us();
+        create_item(name, category_names[zipf_pick(&categories)], description,
+                    conditions[random_below(3)]);
+        samples[i] = now_us() - start;
+    }
+    record_result("add_item", samples, cfg->iterations);
+
+    free(donors.cdf);
+    free(categories.cdf);
+    free(samples);
+}
+
+// Prints every result as one JSON document
+static void print_json(FILE *out, const BenchConfig *cfg, double generate_seconds) {
+    fprintf(out, "{\n");
+    fprintf(out, "  \"benchmark\": \"community_donation_platform\",\n");
+    fprintf(out, "  \"scale\": {\"users\": %d, \"items\": %d, \"requests\": %d, \"wishlists\": %d, "
+                 "\"seed\": %u},\n",
+            cfg->users, cfg->items, cfg->requests, cfg->wishlists, cfg->seed);
+    fprintf(out, "  \"generate_seconds\": %.3f,\n", generate_seconds);
+    fprintf(out, "  \"parse_mb_per_s\": {\"csv_reader\": %.1f, \"fscanf\": %.1f},\n",
+            csv_mb_per_s, fscanf_mb_per_s);
+    fprintf(out, "  \"wishlist_matches_per_item\": %.2f,\n", matches_per_item);
+    fprintf(out, "  \"filter_kernel\": \"%s\", \"filter_mismatches\": %d,\n",
+            item_columns_kernel(), filter_mismatches);
+    fprintf(out, "  \"index_pages_per_lookup\": %.2f, \"index_mismatches\": %d,\n",
+            index_pages_per_lookup, index_mismatches);
+    fprintf(out, "  \"operations\": [\n");
+    for (int i = 0; i < result_count; i++) {
+        BenchResult *r = &results[i];
+        fprintf(out, "    {\"name\": \"%s\", \"iterations\": %d, \"mean_us\": %.2f, \"p50_us\": %.2f, "
+                     "\"p99_us\": %.2f, \"max_us\": %.2f, \"total_ms\": %.3f}%s\n",
+                r->name, r->iterations, r->mean_us, r->p50_us, r->p99_us, r->max_us, r->total_ms,
+                i + 1 < result_count ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+static void usage() {
+    fprintf(stderr,
+            "usage: bench [--users N] [--items N] [--requests N] [--wishlists N] [--iterations N]\n"
+            "             [--scan-iterations N] [--seed N] [--dir PATH] [--stats]\n");
+}
+
+int main(int argc, char *argv[]) {
+    BenchConfig cfg = { 1000, 1000, 1000, 1000, 200, 5, 42, "bench_data" };
+    int show_stats = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stats") == 0) {
+            show_stats = 1;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        if (strcmp(argv[i], "--users") == 0) {
+            cfg.users = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--items") == 0) {
+            cfg.items = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--requests") == 0) {
+            cfg.requests = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--wishlists") == 0) {
+            cfg.wishlists = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--iterations") == 0) {
+            cfg.iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--scan-iterations") == 0) {
+            cfg.scan_iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            cfg.seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--dir") == 0) {
+            cfg.dir = argv[++i];
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (cfg.users < 2 || cfg.items < 1 || cfg.requests < 0 || cfg.wishlists < 0 ||
+        cfg.iterations < 1 || cfg.scan_iterations < 1) {
+        fprintf(stderr, "bench: need at least 2 users, 1 item and 1 iteration\n");
+        return 1;
+    }
+    rng_state ^= cfg.seed * 2654435761ULL;
+
+    double start = now_us();
+    if (!generate_data(&cfg)) {
+        fprintf(stderr, "bench: unable to write data into %s\n", cfg.dir);
+        return 1;
+    }
+    double generate_seconds = (now_us() - start) / 1e6;
+
+    char run_dir[512];
+    snprintf(run_dir, sizeof(run_dir), "%s/run", cfg.dir);
+    if (chdir(run_dir) != 0) {
+        fprintf(stderr, "bench: unable to enter %s\n", run_dir);
+        return 1;
+    }
+
+    // The platform functions print their tables; send that to the null device while
+    // timing and keep the real stdout for the JSON
+    fflush(stdout);
+    int saved_stdout = dup(1);
+    int null_fd = open(NULL_DEVICE, O_WRONLY);
+    if (saved_stdout < 0 || null_fd < 0) {
+        fprintf(stderr, "bench: unable to redirect output\n");
+        return 1;
+    }
+    dup2(null_fd, 1);
+
+    run_benchmarks(&cfg);
+
+    fflush(stdout);
+    dup2(saved_stdout, 1);
+    print_json(stdout, &cfg, generate_seconds);
+    if (show_stats) {
+        stats_dump(stderr, 0);
+    }
+    return 0;
+}
@@ -0,0 +1,503 @@
+// binary_table.c
+// Reads and writes the binary copies of items.txt and requests.txt (items.bin, requests.bin).
+// On Linux/macOS the file is mapped with mmap so records are read straight from the page
+// cache. On Windows we simply read the whole file into memory, which works the same way
+// for the rest of the program.
+//
+// The binary file remembers how much of the CSV file it was made from (source_size), plus a
+// hash of the bytes just before that point. As long as the CSV file has only been appended
+// to since, the binary copy is still good and only the new rows need parsing.
+
+#include "binary_table.h"
+#include "file_lock.h"    // For locking and temp files
+#include "stats.h"        // For counting file activity
+#include "durable.h"      // For replacing files safely
+#include "csv.h"          // For reading the CSV files
+#include "data_watch.h"   // For file_tail_check
+#include <sys/stat.h>   // For file sizes
+#ifndef _WIN32
+#include <fcntl.h>      // For open()
+#include <sys/mman.h>   // For mmap()
+#include <unistd.h>     // For close()
+#endif
+
+// Reads the dictionaries stored after the records and works out what each of the file's
+// codes is called in this program. Returns 0 if the section is cut short or damaged.
+static int read_dictionaries(BinaryTable *table, int record_size) {
+    const char *p = (const char *)table->records + (size_t)table->header->record_count * (size_t)record_size;
+    const char *end = (const char *)table->data + table->length;
+    for (int d = 0; d < DICT_COUNT; d++) {
+        int count;
+        if ((size_t)(end - p) < sizeof(int)) {
+            return 0;
+        }
+        memcpy(&count, p, sizeof(int));
+        p += sizeof(int);
+        if (count < 0 || count > DICT_MAX_CODES ||
+            (size_t)(end - p) < (size_t)count * DICT_TEXT_SIZE) {
+            return 0;
+        }
+        table->codes[d] = malloc(sizeof(unsigned short) * (count ? count : 1));
+        if (!table->codes[d]) {
+            return 0;
+        }
+        table->code_counts[d] = count;
+        for (int c = 0; c < count; c++, p += DICT_TEXT_SIZE) {
+            // Every text must end inside its slot
+            if (!memchr(p, '\0', DICT_TEXT_SIZE)) {
+                return 0;
+            }
+            int code = dict_code(d, p);
+            if (code < 0) {
+                return 0;
+            }
+            table->codes[d][c] = (unsigned short)code;
+        }
+    }
+    return 1;
+}
+
+// Turns one of the file's codes into this program's code (unknown codes become "")
+static unsigned short local_code(const BinaryTable *table, int dict, unsigned short code) {
+    return code < table->code_counts[dict] ? table->codes[dict][code] : 0;
+}
+
+int open_binary_table(const char *path, const char *magic, int record_size, BinaryTable *table) {
+    memset(table, 0, sizeof(*table));
+
+#ifdef _WIN32
+    FILE *file = stats_fopen(path, "rb");
+    if (!file) {
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size < (long)sizeof(BinaryHeader)) {
+        fclose(file);
+        return 0;
+    }
+    void *data = malloc((size_t)size);
+    if (!data || fread(data, 1, (size_t)size, file) != (size_t)size) {
+        free(data);
+        fclose(file);
+        return 0;
+    }
+    fclose(file);
+    table->data = data;
+    table->length = (size_t)size;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    stats_opened();
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(BinaryHeader)) {
+        close(fd);
+        return 0;
+    }
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);  // the mapping stays valid after the descriptor is closed
+    if (data == MAP_FAILED) {
+        return 0;
+    }
+    table->data = data;
+    table->length = (size_t)st.st_size;
+#endif
+
+    table->header = (const BinaryHeader *)table->data;
+    table->records = (const char *)table->data + sizeof(BinaryHeader);
+
+    // Make sure this is the file we think it is, and that it isn't cut short
+    const BinaryHeader *h = table->header;
+    if (memcmp(h->magic, magic, 4) != 0 || h->version != BINARY_FORMAT_VERSION ||
+        h->record_size != record_size || h->record_count < 0 ||
+        table->length < sizeof(BinaryHeader) + (size_t)h->record_count * (size_t)record_size ||
+        !read_dictionaries(table, record_size)) {
+        close_binary_table(table);
+        return 0;
+    }
+    return 1;
+}
+
+void close_binary_table(BinaryTable *table) {
+    for (int d = 0; d < DICT_COUNT; d++) {
+        free(table->codes[d]);
+    }
+    if (!table->data) {
+        memset(table, 0, sizeof(*table));
+        return;
+    }
+#ifdef _WIN32
+    free(table->data);
+#else
+    munmap(table->data, table->length);
+#endif
+    memset(table, 0, sizeof(*table));
+}
+
+int binary_matches_csv(const BinaryTable *table, const char *csv_path) {
+    struct stat st;
+    if (stat(csv_path, &st) != 0) {
+        return table->header->source_size == 0;
+    }
+    if ((long long)st.st_size < table->header->source_size) {
+        return 0;  // the CSV file was rewritten or truncated
+    }
+    return file_tail_check(csv_path, table->header->source_size) == table->header->source_check;
+}
+
+int binary_item_at(const BinaryTable *table, int index, Item *item) {
+    if (index < 0 || index >= table->header->record_count) {
+        return 0;
+    }
+    *item = ((const Item *)table->records)[index];
+    item->category = local_code(table, DICT_CATEGORY, item->category);
+    item->condition = local_code(table, DICT_CONDITION, item->condition);
+    item->status = local_code(table, DICT_STATUS, item->status);
+    return 1;
+}
+
+int binary_request_at(const BinaryTable *table, int index, Request *req) {
+    if (index < 0 || index >= table->header->record_count) {
+        return 0;
+    }
+    *req = ((const Request *)table->records)[index];
+    req->status = local_code(table, DICT_STATUS, req->status);
+    return 1;
+}
+
+int binary_find_item(const BinaryTable *table, int item_id, Item *item) {
+    const Item *items = table->records;
+    int count = table->header->record_count;
+    if (!table->header->sorted) {
+        for (int i = 0; i < count; i++) {
+            if (items[i].item_id == item_id) {
+                return binary_item_at(table, i, item);
+            }
+        }
+        return 0;
+    }
+    int lo = 0, hi = count - 1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (items[mid].item_id == item_id) {
+            return binary_item_at(table, mid, item);
+        } else if (items[mid].item_id < item_id) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return 0;
+}
+
+int binary_find_request(const BinaryTable *table, int request_id, Request *req) {
+    const Request *requests = table->records;
+    int count = table->header->record_count;
+    if (!table->header->sorted) {
+        for (int i = 0; i < count; i++) {
+            if (requests[i].request_id == request_id) {
+                return binary_request_at(table, i, req);
+            }
+        }
+        return 0;
+    }
+    int lo = 0, hi = count - 1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (requests[mid].request_id == request_id) {
+            return binary_request_at(table, mid, req);
+        } else if (requests[mid].request_id < request_id) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return 0;
+}
+
+// Writes this program's dictionaries after the records (see binary_table.h).
+// Returns the bytes written, or -1 on failure.
+static long long write_dictionaries(FILE *file) {
+    long long written = 0;
+    for (int d = 0; d < DICT_COUNT; d++) {
+        int count = dict_size(d);
+        if (fwrite(&count, sizeof(count), 1, file) != 1) {
+            return -1;
+        }
+        for (int c = 0; c < count; c++) {
+            char text[DICT_TEXT_SIZE];
+            memset(text, 0, sizeof(text));
+            strncpy(text, dict_text(d, c), sizeof(text) - 1);
+            if (fwrite(text, sizeof(text), 1, file) != 1) {
+                return -1;
+            }
+        }
+        written += (long long)sizeof(count) + (long long)count * DICT_TEXT_SIZE;
+    }
+    return written;
+}
+
+// Writes a header plus records to path (through a temp file so readers never see half a file)
+static int write_binary_file(const char *path, const char *magic, int record_size,
+                             const void *records, int count, int sorted,
+                             const char *csv_path, long long source_size) {
+    char temp_path[300];
+    FILE *file = create_temp_file(path, temp_path, sizeof(temp_path));
+    if (!file) {
+        printf("Error: Unable to create a temporary file for %s.\n", path);
+        return 0;
+    }
+
+    BinaryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magic, 4);
+    header.version = BINARY_FORMAT_VERSION;
+    header.record_size = record_size;
+    header.record_count = count;
+    header.source_size = source_size;
+    header.source_check = file_tail_check(csv_path, source_size);
+    header.sorted = sorted;
+
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             (count == 0 || fwrite(records, (size_t)record_size, (size_t)count, file) == (size_t)count);
+    long long dictionary_bytes = ok ? write_dictionaries(file) : -1;
+    if (dictionary_bytes < 0) {
+        ok = 0;
+    }
+    if (!close_temp_file(file)) {
+        ok = 0;
+    }
+    if (ok) {
+        stats_written((long long)sizeof(header) + (long long)record_size * count + dictionary_bytes);
+    }
+    if (!ok) {
+        printf("Error: Unable to write %s.\n", temp_path);
+        remove(temp_path);
+        return 0;
+    }
+
+    if (!replace_file(temp_path, path)) {
+        printf("Error: Unable to update %s.\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+static int write_items_to_binary() {
+    FILE *file = stats_fopen(ITEM_FILE_PATH, "r");
+    if (!file) {
+        return write_binary_file(ITEM_BIN_PATH, "CDPI", sizeof(Item), NULL, 0, 1, ITEM_FILE_PATH, 0);
+    }
+
+    CsvReader reader;
+    if (!csv_open(&reader, file, "items.txt")) {
+        printf("Error: Not enough memory to convert items.\n");
+        fclose(file);
+        return 0;
+    }
+    Item *items = NULL;
+    int count = 0, capacity = 0, sorted = 1;
+    int header = 1;
+    while (csv_next(&reader)) {
+        if (header) {
+            header = 0;
+            continue;
+        }
+        Item temp;
+        if (!item_from_row(&reader, &temp)) {
+            csv_skip(&reader);
+            continue;
+        }
+        if (count == capacity) {
+            int new_capacity = capacity ? capacity * 2 : 256;
+            Item *bigger = realloc(items, sizeof(Item) * new_capacity);
+            if (!bigger) {
+                printf("Error: Not enough memory to convert items.\n");
+                free(items);
+                csv_close(&reader);
+                fclose(file);
+                return 0;
+            }
+            items = bigger;
+            capacity = new_capacity;
+        }
+        if (count > 0 && temp.item_id <= items[count - 1].item_id) {
+            sorted = 0;
+        }
+        items[count++] = temp;
+    }
+    long long source_size = reader.offset;
+    csv_close(&reader);
+    fclose(file);
+    stats_read(source_size, count);
+
+    int ok = write_binary_file(ITEM_BIN_PATH, "CDPI", sizeof(Item), items, count, sorted,
+                               ITEM_FILE_PATH, source_size);
+    free(items);
+    return ok;
+}
+
+int convert_items_to_binary() {
+    // Nobody may append to or rewrite the CSV file while we copy it
+    lock_data(LOCK_ITEMS, 1);
+    int ok = write_items_to_binary();
+    unlock_data(LOCK_ITEMS);
+    return ok;
+}
+
+static int write_requests_to_binary() {
+    FILE *file = stats_fopen(REQUEST_FILE_PATH, "r");
+    if (!file) {
+        return write_binary_file(REQUEST_BIN_PATH, "CDPR", sizeof(Request), NULL, 0, 1,
+                                 REQUEST_FILE_PATH, 0);
+    }
+
+    CsvReader reader;
+    if (!csv_open(&reader, file, "requests.txt")) {
+        printf("Error: Not enough memory to convert requests.\n");
+        fclose(file);
+        return 0;
+    }
+    Request *requests = NULL;
+    int count = 0, capacity = 0, sorted = 1;
+    int header = 1;
+    while (csv_next(&reader)) {
+        if (header) {
+            header = 0;
+            continue;
+        }
+        Request temp;
+        if (!request_from_row(&reader, &temp)) {
+            csv_skip(&reader);
+            continue;
+        }
+        if (count == capacity) {
+            int new_capacity = capacity ? capacity * 2 : 256;
+            Request *bigger = realloc(requests, sizeof(Request) * new_capacity);
+            if (!bigger) {
+                printf("Error: Not enough memory to convert requests.\n");
+                free(requests);
+                csv_close(&reader);
+                fclose(file);
+                return 0;
+            }
+            requests = bigger;
+            capacity = new_capacity;
+        }
+        if (count > 0 && temp.request_id <= requests[count - 1].request_id) {
+            sorted = 0;
+        }
+        requests[count++] = temp;
+    }
+    long long source_size = reader.offset;
+    csv_close(&reader);
+    fclose(file);
+    stats_read(source_size, count);
+
+    int ok = write_binary_file(REQUEST_BIN_PATH, "CDPR", sizeof(Request), requests, count, sorted,
+                               REQUEST_FILE_PATH, source_size);
+    free(requests);
+    return ok;
+}
+
+int convert_requests_to_binary() {
+    // Nobody may append to or rewrite the CSV file while we copy it
+    lock_data(LOCK_REQUESTS, 1);
+    int ok = write_requests_to_binary();
+    unlock_data(LOCK_REQUESTS);
+    return ok;
+}
+
+// Replaces a CSV file with a freshly written temp file
+static int replace_csv(FILE *tempFile, const char *temp_path, const char *csv_path) {
+    if (!close_temp_file(tempFile)) {
+        printf("Error: Unable to write %s.\n", temp_path);
+        remove(temp_path);
+        return 0;
+    }
+    if (!replace_file(temp_path, csv_path)) {
+        printf("Error: Unable to update %s.\n", csv_path);
+        return 0;
+    }
+    return 1;
+}
+
+static int write_items_to_csv() {
+    BinaryTable table;
+    if (!open_binary_table(ITEM_BIN_PATH, "CDPI", sizeof(Item), &table)) {
+        printf("Error: %s is missing or not a valid item file.\n", ITEM_BIN_PATH);
+        return 0;
+    }
+    char temp_path[300];
+    FILE *tempFile = create_temp_file(ITEM_FILE_PATH, temp_path, sizeof(temp_path));
+    if (!tempFile) {
+        printf("Error: Unable to create temporary file.\n");
+        close_binary_table(&table);
+        return 0;
+    }
+    fprintf(tempFile, "item_id,donor_username,category,description,condition,status\n");
+    for (int i = 0; i < table.header->record_count; i++) {
+        Item item;
+        binary_item_at(&table, i, &item);
+        write_item_row(tempFile, &item);
+    }
+    close_binary_table(&table);
+    if (!replace_csv(tempFile, temp_path, ITEM_FILE_PATH)) {
+        return 0;
+    }
+    // The CSV file changed, so re-stamp the binary copy to match it
+    return convert_items_to_binary();
+}
+
+int convert_items_to_csv() {
+    // Rewriting the CSV file moves its rows, so hold off everyone else and make the other
+    // programs reload afterwards
+    lock_data(LOCK_STATUS_LOG, 1);
+    lock_data(LOCK_ITEMS, 1);
+    int ok = write_items_to_csv();
+    bump_data_generation();
+    unlock_data(LOCK_ITEMS);
+    unlock_data(LOCK_STATUS_LOG);
+    return ok;
+}
+
+static int write_requests_to_csv() {
+    BinaryTable table;
+    if (!open_binary_table(REQUEST_BIN_PATH, "CDPR", sizeof(Request), &table)) {
+        printf("Error: %s is missing or not a valid request file.\n", REQUEST_BIN_PATH);
+        return 0;
+    }
+    char temp_path[300];
+    FILE *tempFile = create_temp_file(REQUEST_FILE_PATH, temp_path, sizeof(temp_path));
+    if (!tempFile) {
+        printf("Error: Unable to create temporary file.\n");
+        close_binary_table(&table);
+        return 0;
+    }
+    fprintf(tempFile, "request_id,item_id,recipient_username,status\n");
+    for (int i = 0; i < table.header->record_count; i++) {
+        Request req;
+        binary_request_at(&table, i, &req);
+        write_request_row(tempFile, &req);
+    }
+    close_binary_table(&table);
+    if (!replace_csv(tempFile, temp_path, REQUEST_FILE_PATH)) {
+        return 0;
+    }
+    return convert_requests_to_binary();
+}
+
+int convert_requests_to_csv() {
+    // Rewriting the CSV file moves its rows, so hold off everyone else and make the other
+    // programs reload afterwards
+    lock_data(LOCK_STATUS_LOG, 1);
+    lock_data(LOCK_REQUESTS, 1);
+    int ok = write_requests_to_csv();
+    bump_data_generation();
+    unlock_data(LOCK_REQUESTS);
+    unlock_data(LOCK_STATUS_LOG);
+    return ok;
+}
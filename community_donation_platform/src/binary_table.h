@@ -0,0 +1,76 @@
+// binary_table.h
+// An optional binary copy of items.txt and requests.txt. Our Item and Request structs are
+// already fixed-size, so the binary file is just a small header followed by the structs
+// written back to back. Opening it maps the file into memory (mmap), which lets us read
+// and look up records without parsing any text.
+//
+// The records hold dictionary codes (see dictionary.h), and codes are only meaningful to
+// the program that handed them out. So after the records comes a copy of the dictionaries
+// the file was written with: for each dictionary, an int count followed by count texts of
+// DICT_TEXT_SIZE bytes each. Reading a record turns its codes into this program's codes.
+
+#ifndef BINARY_TABLE_H
+#define BINARY_TABLE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "items.h"
+#include "requests.h"
+
+// Where the binary copies live
+#define ITEM_BIN_PATH "../data/items.bin"
+#define REQUEST_BIN_PATH "../data/requests.bin"
+
+// Bump this whenever the layout of the header or the records changes
+#define BINARY_FORMAT_VERSION 2
+
+// The header at the start of every binary file (32 bytes)
+typedef struct {
+    char magic[4];            // "CDPI" for items, "CDPR" for requests
+    int version;              // BINARY_FORMAT_VERSION when the file was written
+    int record_size;          // sizeof(Item) or sizeof(Request) when the file was written
+    int record_count;         // how many records follow the header
+    long long source_size;    // how many bytes of the CSV file the records were made from
+    unsigned int source_check; // hash of the CSV bytes just before source_size
+    int sorted;               // 1 if records are in increasing ID order
+} BinaryHeader;
+
+// An opened (mapped) binary file
+typedef struct {
+    void *data;               // the whole file
+    size_t length;
+    const BinaryHeader *header;
+    const void *records;      // first record, right after the header
+    unsigned short *codes[DICT_COUNT];  // the file's code -> this program's code
+    int code_counts[DICT_COUNT];        // how many codes each dictionary in the file has
+} BinaryTable;
+
+// Opens and maps a binary file. magic and record_size must match what we expect.
+// Returns 1 on success, 0 if the file is missing, from another version, or damaged.
+int open_binary_table(const char *path, const char *magic, int record_size, BinaryTable *table);
+
+// Unmaps a binary file opened with open_binary_table
+void close_binary_table(BinaryTable *table);
+
+// Checks whether the CSV file still starts with the bytes the binary file was made from.
+// If so, only rows after header->source_size are missing from the binary copy.
+int binary_matches_csv(const BinaryTable *table, const char *csv_path);
+
+// Copies a record out of the file with its codes translated (index is 0 .. record_count - 1).
+// Return 1 on success, 0 if index is out of range.
+int binary_item_at(const BinaryTable *table, int index, Item *item);
+int binary_request_at(const BinaryTable *table, int index, Request *req);
+
+// Finds a record by ID and copies it like the functions above (binary search when the
+// file is sorted). Return 1 if found.
+int binary_find_item(const BinaryTable *table, int item_id, Item *item);
+int binary_find_request(const BinaryTable *table, int request_id, Request *req);
+
+// Converters between the CSV files and the binary files. Return 1 on success.
+int convert_items_to_binary();
+int convert_requests_to_binary();
+int convert_items_to_csv();
+int convert_requests_to_csv();
+
+#endif /* BINARY_TABLE_H */
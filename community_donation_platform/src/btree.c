@@ -0,0 +1,513 @@
+// btree.c
+// The page layout and the page cache behind btree.h.
+//
+// Every node page starts with a 16-byte NodeHeader, followed by its keys. A leaf has room
+// for leaf_capacity keys and then the same number of records; an internal node has room
+// for inner_capacity keys and then one more child page number than that. Child i of an
+// internal node holds the keys from keys[i - 1] up to (not including) keys[i].
+//
+// The cache is a fixed set of frames. A page being worked on is "pinned" so it can't be
+// reused underneath us; when a new page is needed, the unpinned frame used longest ago is
+// written back (if it changed) and reused.
+
+#include "btree.h"
+#include "stats.h"    // For counting file activity
+#include "durable.h"  // For sync_file
+
+#define NODE_HEADER 16
+
+typedef struct {
+    int leaf;    // 1 for a leaf, 0 for an internal node
+    int count;   // keys in use
+    int next;    // leaves only: the next leaf to the right, or 0 for none
+    int unused;
+} NodeHeader;
+
+// What inserting into a subtree did to its top page: if it split, the new page to its
+// right and the first key that belongs there
+typedef struct {
+    int split;
+    int key;
+    int page;
+} Split;
+
+static int leaf_capacity(const BTree *tree) {
+    return (BTREE_PAGE_SIZE - NODE_HEADER) / ((int)sizeof(int) + tree->header.value_size);
+}
+
+static int inner_capacity() {
+    return (BTREE_PAGE_SIZE - NODE_HEADER - (int)sizeof(int)) / (2 * (int)sizeof(int));
+}
+
+static NodeHeader *node_of(char *page) {
+    return (NodeHeader *)page;
+}
+
+static int *keys_of(char *page) {
+    return (int *)(page + NODE_HEADER);
+}
+
+static char *values_of(const BTree *tree, char *page) {
+    return page + NODE_HEADER + sizeof(int) * (size_t)leaf_capacity(tree);
+}
+
+static int *children_of(char *page) {
+    return (int *)(page + NODE_HEADER + sizeof(int) * (size_t)inner_capacity());
+}
+
+// Position of the first key >= key
+static int lower_bound(const int *keys, int count, int key) {
+    int lo = 0, hi = count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (keys[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Which child of an internal node can hold key: the number of keys <= key
+static int child_index(char *page, int key) {
+    const int *keys = keys_of(page);
+    int lo = 0, hi = node_of(page)->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (keys[mid] <= key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static int read_page(BTree *tree, int page, char *data) {
+    if (fseek(tree->file, (long)page * BTREE_PAGE_SIZE, SEEK_SET) != 0 ||
+        fread(data, BTREE_PAGE_SIZE, 1, tree->file) != 1) {
+        return 0;
+    }
+    tree->pages_read++;
+    stats_read(BTREE_PAGE_SIZE, 0);
+    return 1;
+}
+
+static int write_page(BTree *tree, int page, const char *data) {
+    if (fseek(tree->file, (long)page * BTREE_PAGE_SIZE, SEEK_SET) != 0 ||
+        fwrite(data, BTREE_PAGE_SIZE, 1, tree->file) != 1) {
+        return 0;
+    }
+    tree->pages_written++;
+    stats_written(BTREE_PAGE_SIZE);
+    return 1;
+}
+
+static int write_header(BTree *tree) {
+    char data[BTREE_PAGE_SIZE];
+    memset(data, 0, sizeof(data));
+    memcpy(data, &tree->header, sizeof(BTreeHeader));
+    return write_page(tree, 0, data);
+}
+
+// Reads the header page and checks that it belongs to a tree like ours
+static int read_header(BTree *tree, const char *magic, int value_size, BTreeHeader *header) {
+    char data[BTREE_PAGE_SIZE];
+    if (!read_page(tree, 0, data)) {
+        return 0;
+    }
+    memcpy(header, data, sizeof(BTreeHeader));
+    return memcmp(header->magic, magic, 4) == 0 && header->version == BTREE_FORMAT_VERSION &&
+           header->value_size == value_size && header->page_count >= 2 &&
+           header->root >= 1 && header->root < header->page_count && header->height >= 1;
+}
+
+// Finds a page in the cache, reading it in if needed (or zeroing it, if fresh is set for a
+// page that's new). The frame stays pinned until unpin. Returns NULL on error.
+static BTreeFrame *get_frame(BTree *tree, int page, int fresh) {
+    if (page < 1 || (!fresh && page >= tree->header.page_count)) {
+        return NULL;  // a damaged node pointing somewhere it shouldn't
+    }
+    BTreeFrame *victim = NULL;
+    for (int i = 0; i < tree->frame_count; i++) {
+        BTreeFrame *frame = &tree->frames[i];
+        if (frame->page == page) {
+            frame->pins++;
+            frame->used = ++tree->clock;
+            return frame;
+        }
+        if (frame->pins == 0 && (!victim || frame->used < victim->used)) {
+            victim = frame;  // free frames have used = 0, so they go first
+        }
+    }
+    if (!victim) {
+        return NULL;  // every frame is pinned: the cache is too small
+    }
+    if (victim->page != -1 && victim->dirty && !write_page(tree, victim->page, victim->data)) {
+        return NULL;
+    }
+    victim->page = -1;
+    victim->dirty = 0;
+    victim->used = 0;
+    if (fresh) {
+        memset(victim->data, 0, BTREE_PAGE_SIZE);
+    } else if (!read_page(tree, page, victim->data)) {
+        return NULL;
+    }
+    victim->page = page;
+    victim->pins = 1;
+    victim->used = ++tree->clock;
+    return victim;
+}
+
+static void unpin(BTreeFrame *frame) {
+    frame->pins--;
+}
+
+// Forgets every cached page (they may be out of date)
+static void drop_cache(BTree *tree) {
+    for (int i = 0; i < tree->frame_count; i++) {
+        tree->frames[i].page = -1;
+        tree->frames[i].dirty = 0;
+        tree->frames[i].used = 0;
+    }
+}
+
+// Marks the tree dirty on disk before its first changed page can be written
+static int start_changing(BTree *tree) {
+    if (tree->on_disk_dirty) {
+        return 1;
+    }
+    tree->header.dirty = 1;
+    if (!write_header(tree) || !sync_file(tree->file)) {
+        return 0;
+    }
+    tree->on_disk_dirty = 1;
+    return 1;
+}
+
+int btree_open(BTree *tree, const char *path, const char *magic, int value_size,
+               int cache_pages, int create) {
+    memset(tree, 0, sizeof(*tree));
+    if (value_size <= 0 || value_size > BTREE_MAX_VALUE_SIZE) {
+        return 0;
+    }
+    if (cache_pages < BTREE_MIN_CACHE_PAGES) {
+        cache_pages = BTREE_MIN_CACHE_PAGES;
+    }
+    tree->file = stats_fopen(path, create ? "w+b" : "r+b");
+    if (!tree->file) {
+        return 0;
+    }
+    tree->frames = calloc((size_t)cache_pages, sizeof(BTreeFrame));
+    if (!tree->frames) {
+        btree_close(tree);
+        return 0;
+    }
+    tree->frame_count = cache_pages;
+    for (int i = 0; i < cache_pages; i++) {
+        tree->frames[i].page = -1;
+        tree->frames[i].data = malloc(BTREE_PAGE_SIZE);
+        if (!tree->frames[i].data) {
+            btree_close(tree);
+            return 0;
+        }
+    }
+
+    if (!create) {
+        if (!read_header(tree, magic, value_size, &tree->header)) {
+            btree_close(tree);
+            return 0;
+        }
+        tree->on_disk_dirty = tree->header.dirty;
+        return 1;
+    }
+
+    // A new tree is a header and one empty leaf
+    memcpy(tree->header.magic, magic, 4);
+    tree->header.version = BTREE_FORMAT_VERSION;
+    tree->header.value_size = value_size;
+    tree->header.root = 1;
+    tree->header.page_count = 2;
+    tree->header.height = 1;
+    char leaf[BTREE_PAGE_SIZE];
+    memset(leaf, 0, sizeof(leaf));
+    node_of(leaf)->leaf = 1;
+    if (!write_header(tree) || !write_page(tree, 1, leaf)) {
+        btree_close(tree);
+        return 0;
+    }
+    return 1;
+}
+
+void btree_close(BTree *tree) {
+    if (tree->frames) {
+        for (int i = 0; i < tree->frame_count; i++) {
+            free(tree->frames[i].data);
+        }
+        free(tree->frames);
+    }
+    if (tree->file) {
+        fclose(tree->file);
+    }
+    memset(tree, 0, sizeof(*tree));
+}
+
+int btree_refresh(BTree *tree) {
+    BTreeHeader header;
+    if (!read_header(tree, tree->header.magic, tree->header.value_size, &header) || header.dirty) {
+        return 0;
+    }
+    if (header.changes != tree->header.changes) {
+        drop_cache(tree);
+    }
+    tree->header = header;
+    tree->on_disk_dirty = 0;
+    return 1;
+}
+
+// Walks down from the root to the leaf that can hold key, and returns it pinned
+static BTreeFrame *find_leaf(BTree *tree, int key) {
+    BTreeFrame *frame = get_frame(tree, tree->header.root, 0);
+    for (int level = tree->header.height; frame && level > 1; level--) {
+        int child = children_of(frame->data)[child_index(frame->data, key)];
+        unpin(frame);
+        frame = get_frame(tree, child, 0);
+    }
+    return frame;
+}
+
+int btree_find(BTree *tree, int key, void *value) {
+    BTreeFrame *frame = find_leaf(tree, key);
+    if (!frame) {
+        return -1;
+    }
+    NodeHeader *leaf = node_of(frame->data);
+    int *keys = keys_of(frame->data);
+    int pos = lower_bound(keys, leaf->count, key);
+    int found = pos < leaf->count && keys[pos] == key;
+    if (found) {
+        int size = tree->header.value_size;
+        memcpy(value, values_of(tree, frame->data) + (size_t)pos * size, (size_t)size);
+    }
+    unpin(frame);
+    return found;
+}
+
+int btree_update(BTree *tree, int key, const void *value) {
+    if (!start_changing(tree)) {
+        return -1;
+    }
+    BTreeFrame *frame = find_leaf(tree, key);
+    if (!frame) {
+        return -1;
+    }
+    NodeHeader *leaf = node_of(frame->data);
+    int *keys = keys_of(frame->data);
+    int pos = lower_bound(keys, leaf->count, key);
+    int found = pos < leaf->count && keys[pos] == key;
+    if (found) {
+        int size = tree->header.value_size;
+        memcpy(values_of(tree, frame->data) + (size_t)pos * size, value, (size_t)size);
+        frame->dirty = 1;
+    }
+    unpin(frame);
+    return found;
+}
+
+// Puts a record into a leaf at pos, splitting the leaf if it's full
+static int insert_into_leaf(BTree *tree, BTreeFrame *frame, int pos, int key, const void *value,
+                            Split *out) {
+    NodeHeader *leaf = node_of(frame->data);
+    int *keys = keys_of(frame->data);
+    char *values = values_of(tree, frame->data);
+    size_t size = (size_t)tree->header.value_size;
+    int capacity = leaf_capacity(tree);
+    frame->dirty = 1;
+    tree->header.record_count++;
+
+    if (leaf->count < capacity) {
+        memmove(keys + pos + 1, keys + pos, sizeof(int) * (size_t)(leaf->count - pos));
+        memmove(values + (pos + 1) * size, values + pos * size, size * (size_t)(leaf->count - pos));
+        keys[pos] = key;
+        memcpy(values + pos * size, value, size);
+        leaf->count++;
+        return 1;
+    }
+
+    // Full: line up all capacity + 1 records, then share them with a new leaf to the right.
+    // When the new key goes at the very end (new IDs always do), this leaf stays full.
+    int all_keys[BTREE_PAGE_SIZE / sizeof(int) + 1];
+    char all_values[BTREE_PAGE_SIZE + BTREE_MAX_VALUE_SIZE];
+    memcpy(all_keys, keys, sizeof(int) * (size_t)pos);
+    memcpy(all_values, values, size * (size_t)pos);
+    all_keys[pos] = key;
+    memcpy(all_values + pos * size, value, size);
+    memcpy(all_keys + pos + 1, keys + pos, sizeof(int) * (size_t)(capacity - pos));
+    memcpy(all_values + (pos + 1) * size, values + pos * size, size * (size_t)(capacity - pos));
+    int total = capacity + 1;
+    int stay = pos == capacity ? capacity : total / 2;
+
+    int new_page = tree->header.page_count;
+    BTreeFrame *right = get_frame(tree, new_page, 1);
+    if (!right) {
+        return 0;
+    }
+    tree->header.page_count++;
+    NodeHeader *right_leaf = node_of(right->data);
+    right_leaf->leaf = 1;
+    right_leaf->count = total - stay;
+    right_leaf->next = leaf->next;
+    memcpy(keys_of(right->data), all_keys + stay, sizeof(int) * (size_t)(total - stay));
+    memcpy(values_of(tree, right->data), all_values + stay * size, size * (size_t)(total - stay));
+    right->dirty = 1;
+    unpin(right);
+
+    leaf->count = stay;
+    leaf->next = new_page;
+    memcpy(keys, all_keys, sizeof(int) * (size_t)stay);
+    memcpy(values, all_values, size * (size_t)stay);
+    out->split = 1;
+    out->key = all_keys[stay];
+    out->page = new_page;
+    return 1;
+}
+
+// Adds (key, child) to an internal node right after child i, splitting the node if it's full
+static int insert_into_inner(BTree *tree, BTreeFrame *frame, int i, int key, int child,
+                             Split *out) {
+    NodeHeader *inner = node_of(frame->data);
+    int *keys = keys_of(frame->data);
+    int *children = children_of(frame->data);
+    int capacity = inner_capacity();
+    frame->dirty = 1;
+
+    if (inner->count < capacity) {
+        memmove(keys + i + 1, keys + i, sizeof(int) * (size_t)(inner->count - i));
+        memmove(children + i + 2, children + i + 1, sizeof(int) * (size_t)(inner->count - i));
+        keys[i] = key;
+        children[i + 1] = child;
+        inner->count++;
+        return 1;
+    }
+
+    // Full: the middle key moves up to the parent, the keys after it go to a new node.
+    // Again, adding at the very end keeps this node (almost) full.
+    int all_keys[BTREE_PAGE_SIZE / sizeof(int) + 1];
+    int all_children[BTREE_PAGE_SIZE / sizeof(int) + 2];
+    memcpy(all_keys, keys, sizeof(int) * (size_t)i);
+    all_keys[i] = key;
+    memcpy(all_keys + i + 1, keys + i, sizeof(int) * (size_t)(capacity - i));
+    memcpy(all_children, children, sizeof(int) * (size_t)(i + 1));
+    all_children[i + 1] = child;
+    memcpy(all_children + i + 2, children + i + 1, sizeof(int) * (size_t)(capacity - i));
+    int total = capacity + 1;
+    int stay = i == capacity ? capacity - 1 : total / 2;
+
+    int new_page = tree->header.page_count;
+    BTreeFrame *right = get_frame(tree, new_page, 1);
+    if (!right) {
+        return 0;
+    }
+    tree->header.page_count++;
+    NodeHeader *right_inner = node_of(right->data);
+    right_inner->leaf = 0;
+    right_inner->count = total - stay - 1;
+    memcpy(keys_of(right->data), all_keys + stay + 1, sizeof(int) * (size_t)right_inner->count);
+    memcpy(children_of(right->data), all_children + stay + 1,
+           sizeof(int) * (size_t)(right_inner->count + 1));
+    right->dirty = 1;
+    unpin(right);
+
+    inner->count = stay;
+    memcpy(keys, all_keys, sizeof(int) * (size_t)stay);
+    memcpy(children, all_children, sizeof(int) * (size_t)(stay + 1));
+    out->split = 1;
+    out->key = all_keys[stay];
+    out->page = new_page;
+    return 1;
+}
+
+// Adds a record to the subtree whose top is page (level 1 = a leaf)
+static int insert_into(BTree *tree, int page, int level, int key, const void *value, Split *out) {
+    out->split = 0;
+    BTreeFrame *frame = get_frame(tree, page, 0);
+    if (!frame) {
+        return 0;
+    }
+    int ok;
+    if (level == 1) {
+        int *keys = keys_of(frame->data);
+        int count = node_of(frame->data)->count;
+        int pos = lower_bound(keys, count, key);
+        if (pos < count && keys[pos] == key) {
+            size_t size = (size_t)tree->header.value_size;
+            memcpy(values_of(tree, frame->data) + pos * size, value, size);
+            frame->dirty = 1;
+            ok = 1;
+        } else {
+            ok = insert_into_leaf(tree, frame, pos, key, value, out);
+        }
+    } else {
+        int i = child_index(frame->data, key);
+        Split below;
+        ok = insert_into(tree, children_of(frame->data)[i], level - 1, key, value, &below);
+        if (ok && below.split) {
+            ok = insert_into_inner(tree, frame, i, below.key, below.page, out);
+        }
+    }
+    unpin(frame);
+    return ok;
+}
+
+int btree_put(BTree *tree, int key, const void *value) {
+    if (!start_changing(tree)) {
+        return 0;
+    }
+    Split split;
+    if (!insert_into(tree, tree->header.root, tree->header.height, key, value, &split)) {
+        return 0;
+    }
+    if (split.split) {
+        // The root split, so the tree grows a new root above the two halves
+        int new_root = tree->header.page_count;
+        BTreeFrame *frame = get_frame(tree, new_root, 1);
+        if (!frame) {
+            return 0;
+        }
+        tree->header.page_count++;
+        node_of(frame->data)->leaf = 0;
+        node_of(frame->data)->count = 1;
+        keys_of(frame->data)[0] = split.key;
+        children_of(frame->data)[0] = tree->header.root;
+        children_of(frame->data)[1] = split.page;
+        frame->dirty = 1;
+        unpin(frame);
+        tree->header.root = new_root;
+        tree->header.height++;
+    }
+    return 1;
+}
+
+int btree_commit(BTree *tree, const BTreeStamp *stamp) {
+    int ok = 1;
+    for (int i = 0; i < tree->frame_count; i++) {
+        BTreeFrame *frame = &tree->frames[i];
+        if (frame->page != -1 && frame->dirty) {
+            ok = write_page(tree, frame->page, frame->data) && ok;
+            frame->dirty = 0;
+        }
+    }
+    if (stamp) {
+        tree->header.stamp = *stamp;
+    }
+    tree->header.dirty = 0;
+    tree->header.changes++;
+    // The pages must be on disk before the header that calls them clean
+    ok = ok && sync_file(tree->file) && write_header(tree) && sync_file(tree->file);
+    if (ok) {
+        tree->on_disk_dirty = 0;
+    }
+    return ok;
+}
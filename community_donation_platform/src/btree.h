@@ -0,0 +1,104 @@
+// btree.h
+// A B+tree kept in a file, for finding a record by its ID without reading a whole data
+// file into memory. The file is a row of fixed-size pages: page 0 is a header, and every
+// other page is a node of the tree. Leaves hold IDs with their records in increasing ID
+// order; the pages above them (internal nodes) hold just enough IDs to pick the right
+// child. With 4 KB pages even a few million records are only three or four pages deep,
+// so a lookup reads a handful of pages.
+//
+// Each open tree keeps a small cache of pages in memory (BTREE_CACHE_PAGES by default),
+// and that is all the memory it uses however big the file gets. Changing a record writes
+// its page back in place.
+//
+// Before the first change the header is marked dirty on disk, and it is only marked clean
+// again once every changed page is written (btree_commit). A tree left dirty by a crash
+// can't be trusted, so btree_refresh refuses it and it has to be built again.
+
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BTREE_PAGE_SIZE 4096
+#define BTREE_CACHE_PAGES 64       // 256 KB per open tree
+#define BTREE_MIN_CACHE_PAGES 16   // enough for the deepest path plus splits
+#define BTREE_MAX_VALUE_SIZE 512   // so a leaf always holds several records
+
+// Bump this whenever the layout of the header or the pages changes
+#define BTREE_FORMAT_VERSION 1
+
+// What the tree's owner notes about where its contents came from (see id_index.c)
+typedef struct {
+    long long source_size;     // bytes of the CSV file the tree holds the rows of
+    unsigned int source_check; // file_tail_check of those bytes
+    int generation;            // data_generation() the notes are for
+    long long log_offset;      // bytes of the status log already applied
+} BTreeStamp;
+
+// Page 0 of the file
+typedef struct {
+    char magic[4];
+    int version;               // BTREE_FORMAT_VERSION
+    int value_size;            // bytes per record
+    int root;                  // page number of the root (a leaf while the tree is small)
+    int page_count;            // pages in the file, the header included
+    int height;                // 1 while the root is a leaf
+    int record_count;
+    int dirty;                 // 1 from the first change until btree_commit
+    int changes;               // goes up with every commit, so other programs drop old pages
+    BTreeStamp stamp;
+} BTreeHeader;
+
+// One cached page
+typedef struct {
+    int page;                  // page number, or -1 if the frame is free
+    int dirty;                 // changed since it was read
+    int pins;                  // in use right now, so it can't be reused
+    long long used;            // when it was last used (we reuse the oldest)
+    char *data;
+} BTreeFrame;
+
+// An open tree
+typedef struct {
+    FILE *file;
+    BTreeHeader header;
+    int on_disk_dirty;         // the header on disk says dirty
+    BTreeFrame *frames;
+    int frame_count;
+    long long clock;
+    long long pages_read;      // for stats and the benchmark
+    long long pages_written;
+} BTree;
+
+// Opens a tree file for reading and changing. With create = 1 a new empty tree replaces
+// whatever was at path. cache_pages is how many pages to keep in memory (at least
+// BTREE_MIN_CACHE_PAGES). Returns 1 on success, 0 if the file is missing, isn't a tree
+// with this magic and value_size, or we ran out of memory.
+int btree_open(BTree *tree, const char *path, const char *magic, int value_size,
+               int cache_pages, int create);
+
+// Closes a tree. Changes that weren't committed are lost (and the tree stays dirty).
+void btree_close(BTree *tree);
+
+// Reads the header again, and forgets the cached pages if another program committed
+// changes since. Returns 0 if the tree is dirty (a crash or a change in progress).
+int btree_refresh(BTree *tree);
+
+// Copies the record with this key into value. Returns 1 if found, 0 if not, -1 on error.
+int btree_find(BTree *tree, int key, void *value);
+
+// Replaces the record with this key in place. Returns 1 if done, 0 if there is no such
+// key, -1 on error.
+int btree_update(BTree *tree, int key, const void *value);
+
+// Adds a record, or replaces it if the key is already there. Returns 1 on success.
+// Keys that only go up (like new IDs) fill each leaf completely before starting the next.
+int btree_put(BTree *tree, int key, const void *value);
+
+// Writes every changed page and the header (with stamp), flushes the file to disk and
+// marks the tree clean. Returns 1 on success.
+int btree_commit(BTree *tree, const BTreeStamp *stamp);
+
+#endif /* BTREE_H */
@@ -0,0 +1,274 @@
+// csv.c
+// The reader keeps one block of the file in memory. A line is handed out as a pointer
+// into the block, so it is only copied once: into the field buffer, where the commas
+// become '\0's. Lines without a double quote take a fast path that is just memchr and
+// memcpy; only lines with quotes are read character by character.
+
+#include "csv.h"
+
+#define CSV_BLOCK_SIZE 65536  // bytes read from the file at a time
+
+int csv_open(CsvReader *reader, FILE *file, const char *name) {
+    memset(reader, 0, sizeof(*reader));
+    reader->file = file;
+    reader->name = name;
+    long position = ftell(file);
+    reader->offset = position > 0 ? position : 0;
+    reader->line_number = reader->offset == 0 ? 0 : -1;
+    reader->block_size = CSV_BLOCK_SIZE;
+    reader->block = malloc(reader->block_size);
+    reader->copy_size = 256;
+    reader->copy = malloc(reader->copy_size);
+    if (!reader->block || !reader->copy) {
+        csv_close(reader);
+        return 0;
+    }
+    return 1;
+}
+
+void csv_close(CsvReader *reader) {
+    free(reader->block);
+    free(reader->copy);
+    reader->block = NULL;
+    reader->copy = NULL;
+}
+
+// Sets the current line, dropping a '\r' before the line end (files edited on Windows)
+static void set_line(CsvReader *reader, char *begin, size_t length, size_t consumed) {
+    if (length > 0 && begin[length - 1] == '\r') {
+        length--;
+    }
+    reader->line = begin;
+    reader->line_length = length;
+    reader->line_start = reader->offset;
+    reader->offset += (long long)consumed;
+    reader->start += consumed;
+}
+
+// Finds the next line in the block, reading more of the file when needed.
+// Returns 1 if there is one, 0 at the end of the file.
+static int next_line(CsvReader *reader) {
+    for (;;) {
+        char *begin = reader->block + reader->start;
+        size_t available = reader->end - reader->start;
+        char *newline = available > 0 ? memchr(begin, '\n', available) : NULL;
+        if (newline) {
+            size_t length = (size_t)(newline - begin);
+            set_line(reader, begin, length, length + 1);
+            return 1;
+        }
+        if (reader->at_end) {
+            if (available == 0) {
+                return 0;
+            }
+            set_line(reader, begin, available, available);  // last line, no line end
+            return 1;
+        }
+
+        // Keep the start of the unfinished line and read more after it. If the line
+        // fills the whole block, make the block bigger.
+        if (reader->start > 0) {
+            memmove(reader->block, begin, available);
+            reader->start = 0;
+            reader->end = available;
+        }
+        if (reader->end == reader->block_size) {
+            char *bigger = realloc(reader->block, reader->block_size * 2);
+            if (!bigger) {
+                printf("Error: Not enough memory to read %s.\n", reader->name);
+                return 0;
+            }
+            reader->block = bigger;
+            reader->block_size *= 2;
+        }
+        size_t got = fread(reader->block + reader->end, 1, reader->block_size - reader->end,
+                           reader->file);
+        reader->end += got;
+        if (got == 0) {
+            reader->at_end = 1;
+        }
+    }
+}
+
+// Splits the current line into fields. Returns 0 if the line is malformed.
+static int split_fields(CsvReader *reader) {
+    // The fields never take more room than the line itself plus one '\0'
+    if (reader->copy_size < reader->line_length + 1) {
+        char *bigger = realloc(reader->copy, reader->line_length + 1);
+        if (!bigger) {
+            return 0;
+        }
+        reader->copy = bigger;
+        reader->copy_size = reader->line_length + 1;
+    }
+    const char *p = reader->line;
+    const char *end = reader->line + reader->line_length;
+    char *out = reader->copy;
+    reader->field_count = 0;
+
+    // Fast path: no quotes, so every comma ends a field
+    if (!memchr(p, '"', reader->line_length)) {
+        memcpy(out, p, reader->line_length);
+        char *stop = out + reader->line_length;
+        *stop = '\0';
+        for (;;) {
+            if (reader->field_count == CSV_MAX_FIELDS) {
+                return 0;
+            }
+            reader->fields[reader->field_count] = out;
+            char *comma = memchr(out, ',', (size_t)(stop - out));
+            if (!comma) {
+                reader->lengths[reader->field_count++] = (size_t)(stop - out);
+                return 1;
+            }
+            *comma = '\0';
+            reader->lengths[reader->field_count++] = (size_t)(comma - out);
+            out = comma + 1;
+        }
+    }
+
+    for (;;) {
+        if (reader->field_count == CSV_MAX_FIELDS) {
+            return 0;
+        }
+        char *field = out;
+        reader->fields[reader->field_count] = field;
+        if (p < end && *p == '"') {
+            // Quoted field: runs to the next lone quote, "" stands for one quote
+            p++;
+            for (;;) {
+                if (p == end) {
+                    return 0;  // the quote is never closed
+                }
+                if (*p == '"') {
+                    if (p + 1 < end && p[1] == '"') {
+                        *out++ = '"';
+                        p += 2;
+                        continue;
+                    }
+                    p++;
+                    break;
+                }
+                *out++ = *p++;
+            }
+            if (p < end && *p != ',') {
+                return 0;  // something after the closing quote
+            }
+        } else {
+            // A quote inside an unquoted field is just a character (older files have these)
+            const char *comma = memchr(p, ',', (size_t)(end - p));
+            const char *stop = comma ? comma : end;
+            memcpy(out, p, (size_t)(stop - p));
+            out += stop - p;
+            p = stop;
+        }
+        reader->lengths[reader->field_count++] = (size_t)(out - field);
+        *out++ = '\0';
+        if (p == end) {
+            return 1;
+        }
+        p++;  // past the comma
+    }
+}
+
+int csv_next(CsvReader *reader) {
+    while (next_line(reader)) {
+        if (reader->line_number >= 0) {
+            reader->line_number++;
+        }
+        if (reader->line_length == 0) {
+            continue;  // blank line
+        }
+        if (split_fields(reader)) {
+            return 1;
+        }
+        if (reader->keep_malformed) {
+            reader->field_count = 0;
+            return 1;
+        }
+        csv_skip(reader);
+    }
+    return 0;
+}
+
+void csv_skip(CsvReader *reader) {
+    reader->skipped++;
+    if (reader->line_number >= 0) {
+        printf("Error: Skipped malformed line %lld of %s.\n", reader->line_number, reader->name);
+    } else {
+        printf("Error: Skipped a malformed line of %s (at byte %lld).\n",
+               reader->name, reader->line_start);
+    }
+}
+
+int csv_int(const CsvReader *reader, int i, int *value) {
+    // Done by hand: strtol is several times slower and this runs once per ID
+    const char *c = reader->fields[i];
+    int negative = *c == '-';
+    if (negative) {
+        c++;
+    }
+    if (*c == '\0') {
+        return 0;
+    }
+    long long number = 0;
+    for (; *c; c++) {
+        if (*c < '0' || *c > '9' || number > 2147483648LL) {
+            return 0;
+        }
+        number = number * 10 + (*c - '0');
+    }
+    if (negative) {
+        number = -number;
+    }
+    if (number < -2147483647LL - 1 || number > 2147483647LL) {
+        return 0;
+    }
+    *value = (int)number;
+    return 1;
+}
+
+int csv_copy(const CsvReader *reader, int i, char *dest, size_t dest_size) {
+    size_t length = reader->lengths[i];
+    if (length >= dest_size) {
+        return 0;
+    }
+    memcpy(dest, reader->fields[i], length + 1);
+    return 1;
+}
+
+int csv_write_row(FILE *file, const char *const *fields, int count) {
+    int written = 0;
+    for (int i = 0; i < count; i++) {
+        const char *text = fields[i];
+        if (i > 0) {
+            putc(',', file);
+            written++;
+        }
+        if (!strpbrk(text, ",\"\r\n")) {
+            fputs(text, file);  // nothing to quote or replace
+            written += (int)strlen(text);
+            continue;
+        }
+        int quoted = strpbrk(text, ",\"") != NULL;
+        if (quoted) {
+            putc('"', file);
+            written++;
+        }
+        for (const char *c = text; *c; c++) {
+            if (*c == '"') {
+                putc('"', file);
+                written++;
+            }
+            putc(*c == '\r' || *c == '\n' ? ' ' : *c, file);
+            written++;
+        }
+        if (quoted) {
+            putc('"', file);
+            written++;
+        }
+    }
+    putc('\n', file);
+    written++;
+    return ferror(file) ? -1 : written;
+}
@@ -0,0 +1,67 @@
+// csv.h
+// One shared reader and writer for the comma-separated data files (users.txt, items.txt,
+// requests.txt and the status log).
+//
+// The reader pulls the file in large blocks and finds line ends and commas with memchr,
+// which the C library scans many bytes at a time, instead of going through the file one
+// character at a time. A field that contains a comma or a double quote is written in
+// double quotes, with any quote inside doubled:  12,alice,Books,"Dune, 1st ed.",Good,available
+// Every record is exactly one line. A line that can't be split properly (an unclosed
+// quote, too many fields) is reported and skipped, so it can never shift the fields of
+// the lines after it.
+
+#ifndef CSV_H
+#define CSV_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CSV_MAX_FIELDS 8  // the widest file (items.txt) has 6
+
+typedef struct {
+    FILE *file;
+    const char *name;      // file name for error messages
+    char *block;           // bytes read from the file but not handed out yet
+    size_t block_size;
+    size_t start, end;     // the unread part of block
+    int at_end;            // the file has no more bytes
+    long long offset;      // file position just after the current record
+    long long line_start;  // file position of the current record
+    long long line_number; // line number of the current record (-1 if we started mid-file)
+    char *line;            // the current record as it appears in the file (no line end)
+    size_t line_length;
+    char *copy;            // holds the fields, each ending in '\0'
+    size_t copy_size;
+    int field_count;
+    char *fields[CSV_MAX_FIELDS];
+    size_t lengths[CSV_MAX_FIELDS];
+    long long skipped;     // malformed lines reported so far
+    int keep_malformed;    // set to get malformed lines back with field_count 0
+} CsvReader;
+
+// Starts reading at the file's current position. name is only used in messages.
+// Returns 1 on success, 0 if out of memory.
+int csv_open(CsvReader *reader, FILE *file, const char *name);
+
+// Moves to the next record, skipping blank lines and reporting malformed ones (or, with
+// keep_malformed set, returning them silently with field_count 0, for code that copies
+// lines through unchanged). Returns 1 if there is a record (in reader->fields), 0 at the
+// end of the file.
+int csv_next(CsvReader *reader);
+
+// Reports the current record as malformed (for callers that find a field they can't use)
+void csv_skip(CsvReader *reader);
+
+// Frees the reader's buffers. The file stays open.
+void csv_close(CsvReader *reader);
+
+// Field helpers for the current record. Both return 1 if field number i is usable.
+int csv_int(const CsvReader *reader, int i, int *value);              // it's a whole number
+int csv_copy(const CsvReader *reader, int i, char *dest, size_t dest_size);  // it fits in dest
+
+// Writes one record, quoting the fields that need it. \r and \n can't be stored (a record
+// is one line), so they are written as spaces. Returns the number of bytes written, or -1.
+int csv_write_row(FILE *file, const char *const *fields, int count);
+
+#endif /* CSV_H */
@@ -0,0 +1,239 @@
+// data_watch.c
+// On Linux an inotify descriptor watches the data folder and is read without blocking,
+// so data_watch_changed only has to drain whatever events have queued up. Events for
+// other files in the folder (data.lock, the .bin copies, temp files) are ignored. If the
+// folder can't be watched (no inotify, or the folder doesn't exist yet) we fall back to
+// comparing a stat() snapshot of each data file, which is what Windows and macOS always do.
+
+#include "data_watch.h"
+#include "user.h"      // For refresh_users
+#include "requests.h"  // For refresh_requests
+#include "wishlist.h"  // For refresh_wishlists
+#include "stats.h"     // For counting file activity
+#include <sys/stat.h>  // For file sizes and modification times
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+// The files whose changes we care about, inside DATA_FOLDER_PATH
+static const char *watched_names[] = { "users.txt", "items.txt", "requests.txt", "status_log.txt",
+                                       "wishlists.txt", "notifications.txt",
+                                       "notifications_seen.txt" };
+#define WATCHED_COUNT 7
+
+// What stat() said about one file
+typedef struct {
+    int exists;
+    long long size;
+    long long identity;
+    long long modified;
+} FileState;
+
+static void read_file_state(const char *path, FileState *state) {
+    struct stat st;
+    memset(state, 0, sizeof(*state));
+    if (stat(path, &st) != 0) {
+        return;
+    }
+    state->exists = 1;
+    state->size = (long long)st.st_size;
+    state->identity = (long long)st.st_ino;  // always 0 on Windows, which is fine
+#if defined(__APPLE__)
+    state->modified = (long long)st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+    state->modified = (long long)st.st_mtime * 1000000000LL;
+#else
+    state->modified = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+}
+
+static int same_state(const FileState *a, const FileState *b) {
+    return a->exists == b->exists && a->size == b->size && a->identity == b->identity &&
+           a->modified == b->modified;
+}
+
+// The fallback: every file as we last saw it
+static FileState snapshot[WATCHED_COUNT];
+static int watch_started = 0;
+
+// Takes a new snapshot. Returns 1 if any file differs from the last one.
+static int snapshot_changed() {
+    int changed = 0;
+    for (int i = 0; i < WATCHED_COUNT; i++) {
+        char path[300];
+        snprintf(path, sizeof(path), "%s/%s", DATA_FOLDER_PATH, watched_names[i]);
+        FileState now;
+        read_file_state(path, &now);
+        if (!same_state(&now, &snapshot[i])) {
+            snapshot[i] = now;
+            changed = 1;
+        }
+    }
+    return changed;
+}
+
+#ifdef __linux__
+
+static int watch_fd = -1;  // the inotify descriptor, -1 if inotify isn't available
+static int watch_id = -1;  // our watch on the folder, -1 while the folder isn't watched
+
+// Starts watching the folder if we aren't yet. Returns 1 if it is watched now.
+static int start_watch() {
+    if (watch_fd < 0) {
+        return 0;
+    }
+    if (watch_id < 0) {
+        // No IN_CLOSE_WRITE: every write is already an IN_MODIFY, and a server closes the
+        // files it appended to only after the shared flush (see durable.c), which would
+        // report its own writes again once it has already taken them in
+        watch_id = inotify_add_watch(watch_fd, DATA_FOLDER_PATH,
+                                     IN_MODIFY | IN_MOVED_TO | IN_MOVED_FROM |
+                                     IN_CREATE | IN_DELETE | IN_ATTRIB | IN_DELETE_SELF |
+                                     IN_MOVE_SELF);
+    }
+    return watch_id >= 0;
+}
+
+// Reads every queued event. Returns 1 if one was about a data file (or if events were lost).
+static int drain_events() {
+    // Big enough for several events with the longest names, and aligned as the kernel wants
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int changed = 0;
+    for (;;) {
+        ssize_t got = read(watch_fd, buffer, sizeof(buffer));
+        if (got <= 0) {
+            break;  // nothing left (EAGAIN), or an error we can't do anything about
+        }
+        for (char *p = buffer; p < buffer + got;) {
+            struct inotify_event *event = (struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                changed = 1;  // the kernel dropped events, so assume the worst
+            }
+            if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+                // The folder itself went away; watch it again once it's back
+                if (watch_id >= 0) {
+                    inotify_rm_watch(watch_fd, watch_id);
+                }
+                watch_id = -1;
+                changed = 1;
+                continue;
+            }
+            if (event->len == 0) {
+                continue;
+            }
+            for (int i = 0; i < WATCHED_COUNT; i++) {
+                if (strcmp(event->name, watched_names[i]) == 0) {
+                    changed = 1;
+                }
+            }
+        }
+    }
+    return changed;
+}
+
+#endif
+
+#ifndef _WIN32
+static pthread_mutex_t watch_mutex = PTHREAD_MUTEX_INITIALIZER;  // server threads share the watch
+#endif
+
+int data_watch_changed() {
+#ifndef _WIN32
+    pthread_mutex_lock(&watch_mutex);
+#endif
+    int changed;
+    if (!watch_started) {
+        watch_started = 1;
+#ifdef __linux__
+        watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        start_watch();
+#endif
+        snapshot_changed();
+        changed = 1;
+    } else {
+#ifdef __linux__
+        if (watch_id >= 0) {
+            changed = drain_events();
+        } else if (start_watch()) {
+            changed = 1;  // we can't know what happened before the watch started
+        } else {
+            changed = snapshot_changed();
+        }
+#else
+        changed = snapshot_changed();
+#endif
+    }
+#ifndef _WIN32
+    pthread_mutex_unlock(&watch_mutex);
+#endif
+    return changed;
+}
+
+void refresh_data() {
+    refresh_users();
+    refresh_requests();  // refreshes the items first
+    refresh_wishlists();
+}
+
+void mark_file(const char *path, long long offset, FileMark *mark) {
+    FileState state;
+    read_file_state(path, &state);
+    mark->offset = offset;
+    mark->exists = state.exists;
+    mark->identity = state.identity;
+    mark->modified = state.modified;
+    mark->tail_check = state.exists ? file_tail_check(path, offset) : 0;
+}
+
+int file_rewritten(const char *path, const FileMark *mark) {
+    FileState state;
+    read_file_state(path, &state);
+    if (!mark->exists) {
+        // There was nothing to read, so whatever is there now is all new
+        return 0;
+    }
+    if (!state.exists || state.identity != mark->identity || state.size < mark->offset) {
+        return 1;  // deleted, replaced by another file, or cut short
+    }
+    if (state.modified == mark->modified) {
+        return 0;  // untouched
+    }
+    if (state.size == mark->offset) {
+        return 1;  // written to without growing, so something in it changed
+    }
+    // It grew. If the bytes we had read still end the same way, it was only appended to.
+    return file_tail_check(path, mark->offset) != mark->tail_check;
+}
+
+// How many bytes (just before the offset) go into file_tail_check
+#define TAIL_CHECK_BYTES 256
+
+unsigned int file_tail_check(const char *path, long long offset) {
+    FILE *file = stats_fopen(path, "rb");
+    if (!file) {
+        return 0;
+    }
+    long long start = offset > TAIL_CHECK_BYTES ? offset - TAIL_CHECK_BYTES : 0;
+    unsigned char bytes[TAIL_CHECK_BYTES];
+    size_t wanted = (size_t)(offset - start);
+    size_t got = 0;
+    if (fseek(file, (long)start, SEEK_SET) == 0) {
+        got = fread(bytes, 1, wanted, file);
+    }
+    fclose(file);
+    if (got != wanted) {
+        return 0;
+    }
+
+    // FNV-1a
+    unsigned int h = 2166136261u;
+    for (size_t i = 0; i < got; i++) {
+        h = (h ^ bytes[i]) * 16777619u;
+    }
+    return h;
+}
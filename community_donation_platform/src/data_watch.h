@@ -0,0 +1,55 @@
+// data_watch.h
+// Keeps a long-running program (the menus, a batch run reading from a pipe, a server) up
+// to date when another program or an admin changes the data folder.
+//
+// data_watch_changed says cheaply whether anything may have changed. On Linux it asks
+// the kernel to report changes in the folder (inotify), so the check costs no file access
+// at all when nothing happened. Elsewhere, or if inotify isn't available, it compares the
+// size and modification time of each data file with what it saw last time.
+//
+// When something did change, the refresh_* functions catch up. A FileMark remembers how
+// much of a file is already loaded, so they can tell a file that only grew (parse just
+// the new rows) from one that was rewritten (load it again from the start).
+
+#ifndef DATA_WATCH_H
+#define DATA_WATCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DATA_FOLDER_PATH "../data"
+
+// Returns 1 if users.txt, items.txt, requests.txt, status_log.txt or the wishlist files
+// may have changed since the last call (always 1 the first time), 0 if they certainly haven't.
+// Several threads may call it at once; each change is reported to at least one of them.
+int data_watch_changed();
+
+// Catches up with everything other programs have written: new users, items, requests,
+// wishlists and notifications are read from where we left off, and a file that was rewritten is loaded again.
+void refresh_data();
+
+// What a loaded file looked like, up to the point we've read
+typedef struct {
+    long long offset;         // bytes read and loaded
+    int exists;               // 0 if there was no file yet
+    long long identity;       // which file it was (inode number)
+    long long modified;       // modification time, in nanoseconds
+    unsigned int tail_check;  // file_tail_check of the bytes before offset
+} FileMark;
+
+// Remembers what path looks like now, with its first offset bytes loaded.
+// Call it while holding the file's lock, right after reading it.
+void mark_file(const char *path, long long offset, FileMark *mark);
+
+// Returns 1 if path was replaced or rewritten since it was marked (so it has to be loaded
+// again from the start), 0 if it is the same file with at most new rows at the end.
+// A rewrite that keeps the size and the last few hundred bytes before the mark, and
+// happens within the same clock tick, can't be told apart from no change at all.
+int file_rewritten(const char *path, const FileMark *mark);
+
+// Hashes the (up to 256) bytes just before offset in a file. Returns 0 if they can't be
+// read. Equal checks mean the file very likely still ends its first offset bytes the same way.
+unsigned int file_tail_check(const char *path, long long offset);
+
+#endif /* DATA_WATCH_H */
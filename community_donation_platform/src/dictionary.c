@@ -0,0 +1,145 @@
+// dictionary.c
+// Each dictionary keeps its texts in an arena (so dict_text's pointers never move) and an
+// open-addressing hash table from text to code.
+
+#include "dictionary.h"
+#include "arena.h"
+
+typedef struct {
+    RecordArena texts;   // DICT_TEXT_SIZE bytes per code, in code order
+    int *slots;          // hash table from text to code; -1 means the slot is empty
+    int slot_count;      // always a power of two
+} Dictionary;
+
+static Dictionary dictionaries[DICT_COUNT];
+static int started = 0;
+
+// Picks the starting hash slot for a text (FNV-1a)
+static int text_hash(const char *text, int slots) {
+    unsigned int h = 2166136261u;
+    for (int i = 0; text[i]; i++) {
+        h = (h ^ (unsigned char)text[i]) * 16777619u;
+    }
+    return (int)(h & (unsigned int)(slots - 1));
+}
+
+// Doubles a dictionary's hash table and re-inserts every code
+static int grow_slots(Dictionary *d) {
+    int new_count = d->slot_count ? d->slot_count * 2 : 64;
+    int *new_slots = malloc(sizeof(int) * new_count);
+    if (!new_slots) {
+        return 0;
+    }
+    free(d->slots);
+    d->slots = new_slots;
+    d->slot_count = new_count;
+    for (int i = 0; i < new_count; i++) {
+        d->slots[i] = -1;
+    }
+    for (int code = 0; code < d->texts.count; code++) {
+        int slot = text_hash(arena_at(&d->texts, code), new_count);
+        while (d->slots[slot] != -1) {
+            slot = (slot + 1) & (new_count - 1);
+        }
+        d->slots[slot] = code;
+    }
+    return 1;
+}
+
+// Finds a text's code, or -1. *free_slot gets the slot where it would go.
+static int find_text(const Dictionary *d, const char *text, int *free_slot) {
+    if (d->slot_count == 0) {
+        return -1;
+    }
+    int slot = text_hash(text, d->slot_count);
+    while (d->slots[slot] != -1) {
+        if (strcmp(arena_at(&d->texts, d->slots[slot]), text) == 0) {
+            return d->slots[slot];
+        }
+        slot = (slot + 1) & (d->slot_count - 1);
+    }
+    if (free_slot) {
+        *free_slot = slot;
+    }
+    return -1;
+}
+
+// Returns a text's code, adding it first if it's new (-1 if it can't be added)
+static int add_text(Dictionary *d, const char *text) {
+    int slot;
+    int code = find_text(d, text, &slot);
+    if (code >= 0) {
+        return code;
+    }
+    if (strlen(text) >= DICT_TEXT_SIZE || d->texts.count >= DICT_MAX_CODES) {
+        return -1;
+    }
+    if ((d->texts.count + 1) * 10 > d->slot_count * 7) {
+        if (!grow_slots(d)) {
+            return -1;
+        }
+        find_text(d, text, &slot);
+    }
+    char *stored = arena_add(&d->texts);
+    if (!stored) {
+        return -1;
+    }
+    strcpy(stored, text);
+    d->slots[slot] = d->texts.count - 1;
+    return d->texts.count - 1;
+}
+
+// Sets up the dictionaries with the texts whose codes are fixed (see dictionary.h)
+static void start_dictionaries() {
+    if (started) {
+        return;
+    }
+    started = 1;
+    for (int i = 0; i < DICT_COUNT; i++) {
+        arena_init(&dictionaries[i].texts, DICT_TEXT_SIZE);
+        add_text(&dictionaries[i], "");
+    }
+    const char *statuses[] = { "available", "donated", "pending", "approved", "rejected" };
+    for (int i = 0; i < 5; i++) {
+        add_text(&dictionaries[DICT_STATUS], statuses[i]);
+    }
+    const char *conditions[] = { "New", "Good", "Fair" };
+    for (int i = 0; i < 3; i++) {
+        add_text(&dictionaries[DICT_CONDITION], conditions[i]);
+    }
+}
+
+int dict_code(int dict, const char *text) {
+    start_dictionaries();
+    return add_text(&dictionaries[dict], text);
+}
+
+int dict_lookup(int dict, const char *text) {
+    start_dictionaries();
+    return find_text(&dictionaries[dict], text, NULL);
+}
+
+const char *dict_text(int dict, int code) {
+    start_dictionaries();
+    if (code < 0 || code >= dictionaries[dict].texts.count) {
+        return "";
+    }
+    return arena_at(&dictionaries[dict].texts, code);
+}
+
+int dict_size(int dict) {
+    start_dictionaries();
+    return dictionaries[dict].texts.count;
+}
+
+int dict_field(int dict, const CsvReader *reader, int i, unsigned short *code) {
+    if (i >= reader->field_count || reader->lengths[i] >= DICT_TEXT_SIZE) {
+        return 0;
+    }
+    int found = dict_code(dict, reader->fields[i]);
+    if (found < 0) {
+        return 0;
+    }
+    *code = (unsigned short)found;
+    return 1;
+}
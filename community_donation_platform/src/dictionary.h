@@ -0,0 +1,58 @@
+// dictionary.h
+// Item categories, item conditions and item/request statuses only take a handful of
+// different values, so records don't keep them as text. Each distinct text is stored once
+// in a dictionary and records keep its small number (its "code") instead. Checking a
+// status is then comparing two numbers, and an Item is 56 bytes smaller.
+//
+// Codes are only meaningful inside one running program: the text files (items.txt,
+// requests.txt, the status log) keep the text, and the binary files carry a copy of the
+// dictionaries they were written with (see binary_table.h).
+
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "csv.h"  // For dict_field
+
+// The dictionaries, one per kind of field
+#define DICT_CATEGORY 0    // Item.category (spelled as typed; "Books" and "books" differ)
+#define DICT_CONDITION 1   // Item.condition
+#define DICT_STATUS 2      // Item.status and Request.status
+#define DICT_COUNT 3
+
+#define DICT_TEXT_SIZE 21  // longest text is 20 characters, like the fields it replaced
+#define DICT_MAX_CODES 65536  // codes fit in an unsigned short
+
+// Code 0 is the empty text in every dictionary, so a zeroed record has empty fields.
+// These values always get the same codes, so code can compare against them directly.
+#define STATUS_AVAILABLE 1
+#define STATUS_DONATED 2
+#define STATUS_PENDING 3
+#define STATUS_APPROVED 4
+#define STATUS_REJECTED 5
+#define CONDITION_NEW 1
+#define CONDITION_GOOD 2
+#define CONDITION_FAIR 3
+
+// Returns the code for a text, adding it to the dictionary if it's new. Returns -1 if
+// the text is too long, the dictionary is full, or we ran out of memory.
+// Adding can move things around, so in server mode only call it while holding the data
+// lock for writing.
+int dict_code(int dict, const char *text);
+
+// Returns the code for a text that is already in the dictionary, or -1 (never adds)
+int dict_lookup(int dict, const char *text);
+
+// The text for a code ("" for codes that were never handed out). The text stays put for
+// as long as the program runs.
+const char *dict_text(int dict, int code);
+
+// How many codes a dictionary has handed out (including 0)
+int dict_size(int dict);
+
+// dict_code for field i of the current CSV record. Returns 1 and sets *code if it fits.
+int dict_field(int dict, const CsvReader *reader, int i, unsigned short *code);
+
+#endif /* DICTIONARY_H */
@@ -0,0 +1,226 @@
+// durable.c
+// On Linux/macOS appends are flushed with fdatasync (F_FULLFSYNC on macOS, where plain
+// fsync can stop at the drive's cache), and replacing a file is rename() followed by a
+// flush of the folder, since the rename itself is only on disk once the folder is.
+// Windows has no group commit (there is no server mode there): every append is flushed
+// with _commit, and MoveFileEx replaces files.
+//
+// For group commit each append gets a number (its "LSN") when it is noted. The shared
+// flush remembers the highest number it covered, so a worker is done as soon as that
+// number reaches its own. Noted files are kept open (as a duplicate of the descriptor)
+// until they are flushed, so a flush never has to look a file up by name again.
+
+#include "durable.h"
+#include "stats.h"  // For counting file activity
+
+#ifdef _WIN32
+#include <io.h>         // For _commit(), _fileno()
+#include <windows.h>    // For MoveFileExA()
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+// Flushes one open file's data to disk. Returns 1 on success.
+static int sync_fd(int fd) {
+#if defined(_WIN32)
+    return _commit(fd) == 0;
+#elif defined(__APPLE__)
+    return fcntl(fd, F_FULLFSYNC) == 0 || fsync(fd) == 0;
+#else
+    return fdatasync(fd) == 0;
+#endif
+}
+
+#ifdef _WIN32
+
+int close_durably(FILE *file) {
+    int ok = fflush(file) == 0 && sync_fd(_fileno(file));
+    return fclose(file) == 0 && ok;
+}
+
+void defer_durability(int on) {
+    (void)on;
+}
+
+int wait_durable() {
+    return 1;
+}
+
+int close_temp_file(FILE *file) {
+    return close_durably(file);
+}
+
+int sync_file(FILE *file) {
+    return fflush(file) == 0 && sync_fd(_fileno(file));
+}
+
+int replace_file(const char *temp_path, const char *path) {
+    // WRITE_THROUGH makes the call return only once the move is on disk
+    if (!MoveFileExA(temp_path, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        remove(temp_path);
+        return 0;
+    }
+    return 1;
+}
+
+#else
+
+// Different files an append can go to (users, items, requests, status log), with room
+// for a few old copies still open after compaction replaced them
+#define MAX_PENDING 16
+
+typedef struct {
+    int fd;     // our own duplicate of the descriptor, closed once flushed
+    dev_t dev;  // which file it is, so two appends to one file share a flush
+    ino_t ino;
+} PendingFile;
+
+static pthread_mutex_t durable_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t flush_done = PTHREAD_COND_INITIALIZER;
+static PendingFile pending[MAX_PENDING];  // appended to, but not flushed yet
+static int pending_count = 0;
+static long long noted_lsn = 0;    // number of the newest noted append
+static long long durable_lsn = 0;  // every append up to this number is on disk
+static long long failed_from = 0;  // appends failed_from..failed_to were in a failed flush
+static long long failed_to = -1;
+static int flushing = 0;           // a worker is flushing right now
+static int deferred = 0;
+static _Thread_local long long thread_lsn = 0;  // this thread's newest noted append
+
+// Notes an append to fd for the next shared flush. Returns 0 if it couldn't be noted
+// (the caller then flushes it right away instead).
+static int note_append(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return 0;
+    }
+    pthread_mutex_lock(&durable_mutex);
+    int found = 0;
+    for (int i = 0; i < pending_count && !found; i++) {
+        found = pending[i].dev == st.st_dev && pending[i].ino == st.st_ino;
+    }
+    if (!found) {
+        int copy = pending_count < MAX_PENDING ? dup(fd) : -1;
+        if (copy < 0) {
+            pthread_mutex_unlock(&durable_mutex);
+            return 0;
+        }
+        pending[pending_count].fd = copy;
+        pending[pending_count].dev = st.st_dev;
+        pending[pending_count].ino = st.st_ino;
+        pending_count++;
+    }
+    thread_lsn = ++noted_lsn;
+    pthread_mutex_unlock(&durable_mutex);
+    return 1;
+}
+
+int close_durably(FILE *file) {
+    int ok = fflush(file) == 0;
+    if (ok && !(deferred && note_append(fileno(file)))) {
+        ok = sync_fd(fileno(file));
+    }
+    return fclose(file) == 0 && ok;
+}
+
+void defer_durability(int on) {
+    deferred = on;
+}
+
+int wait_durable() {
+    long long mine = thread_lsn;
+    if (mine == 0) {
+        return 1;
+    }
+    thread_lsn = 0;
+
+    pthread_mutex_lock(&durable_mutex);
+    while (durable_lsn < mine) {
+        if (flushing) {
+            // Someone else's flush is running; it may cover us, or we go next
+            pthread_cond_wait(&flush_done, &durable_mutex);
+            continue;
+        }
+
+        // Lead a flush of everything noted so far. New appends can be noted while we
+        // flush; they go into the next group.
+        flushing = 1;
+        long long covers = noted_lsn;
+        PendingFile group[MAX_PENDING];
+        int count = pending_count;
+        memcpy(group, pending, sizeof(PendingFile) * (size_t)count);
+        pending_count = 0;
+        pthread_mutex_unlock(&durable_mutex);
+
+        int ok = 1;
+        for (int i = 0; i < count; i++) {
+            if (!sync_fd(group[i].fd)) {
+                ok = 0;
+            }
+            close(group[i].fd);
+        }
+
+        pthread_mutex_lock(&durable_mutex);
+        if (!ok) {
+            failed_from = durable_lsn + 1;
+            failed_to = covers;
+        }
+        durable_lsn = covers;
+        flushing = 0;
+        pthread_cond_broadcast(&flush_done);
+    }
+    // Only the most recent failure is remembered, which is enough for the worker that
+    // was waiting on it
+    int ok = mine < failed_from || mine > failed_to;
+    pthread_mutex_unlock(&durable_mutex);
+    return ok;
+}
+
+int close_temp_file(FILE *file) {
+    int ok = fflush(file) == 0 && sync_fd(fileno(file));
+    return fclose(file) == 0 && ok;
+}
+
+int sync_file(FILE *file) {
+    return fflush(file) == 0 && sync_fd(fileno(file));
+}
+
+// Flushes the folder a file is in, so a rename or new file in it is on disk
+static int sync_folder_of(const char *path) {
+    char folder[300];
+    const char *slash = strrchr(path, '/');
+    if (!slash) {
+        strcpy(folder, ".");
+    } else {
+        size_t length = slash == path ? 1 : (size_t)(slash - path);
+        if (length >= sizeof(folder)) {
+            return 0;
+        }
+        memcpy(folder, path, length);
+        folder[length] = '\0';
+    }
+    int fd = open(folder, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    stats_opened();
+    // Some file systems can't flush a folder (EINVAL); they write renames through anyway
+    int ok = fsync(fd) == 0 || errno == EINVAL;
+    close(fd);
+    return ok;
+}
+
+int replace_file(const char *temp_path, const char *path) {
+    // rename replaces path in one step: anyone opening it sees the old or the new file
+    if (rename(temp_path, path) != 0) {
+        remove(temp_path);
+        return 0;
+    }
+    return sync_folder_of(path);
+}
+
+#endif
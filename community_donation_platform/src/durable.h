@@ -0,0 +1,50 @@
+// durable.h
+// Makes sure what we write survives a crash or power cut, not just a normal exit.
+//
+// Appending a record (a new user, item, request or group of status changes) ends with
+// close_durably, which asks the operating system to put the bytes on the disk (fsync)
+// before we report success. A disk flush is slow, often milliseconds, so in server mode
+// workers share them: each worker only notes which file it appended to, lets go of the
+// data lock, and then waits in wait_durable. The first worker to wait flushes every file
+// noted so far, and every worker whose writes that flush covered goes on without flushing
+// again ("group commit"). Workers that arrive while a flush is running wait for it and
+// then share the next one.
+//
+// Rewriting a whole file (compaction, converting to/from binary) writes a temp file,
+// flushes it with close_temp_file, and swaps it in with replace_file. The swap is a single
+// rename, so at every moment the data file is either the complete old copy or the
+// complete new one, never missing or half-written.
+
+#ifndef DURABLE_H
+#define DURABLE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Closes a file we appended to, once its new bytes are safely on disk (or, after
+// defer_durability(1), once they are noted for the next shared flush).
+// Returns 1 on success, 0 if anything failed.
+int close_durably(FILE *file);
+
+// With on = 1, close_durably stops flushing right away and each thread has to call
+// wait_durable before telling anyone its writes succeeded. Server mode turns this on.
+void defer_durability(int on);
+
+// Waits until everything this thread appended is on disk, joining or leading a shared
+// flush. Returns 1 on success (or if there was nothing to wait for), 0 if a flush failed.
+int wait_durable();
+
+// Flushes and closes a temp file from create_temp_file. Returns 1 on success, 0 on error.
+int close_temp_file(FILE *file);
+
+// Flushes a file that stays open (like an index we change in place) to disk.
+// Returns 1 on success, 0 on error.
+int sync_file(FILE *file);
+
+// Puts a finished temp file in place of path in one step, and makes the swap itself
+// survive a crash. Returns 1 on success, 0 on error: either path is left as it was, or
+// (very rarely) the swap happened but couldn't be flushed to disk.
+int replace_file(const char *temp_path, const char *path);
+
+#endif /* DURABLE_H */
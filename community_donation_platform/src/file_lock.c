@@ -0,0 +1,165 @@
+// file_lock.c
+// Part N of the data folder is locked by locking byte N of data.lock. The compaction
+// generation is kept as a number at GENERATION_OFFSET in the same file.
+//
+// fcntl locks belong to the whole process, not to one call, so we count how many times
+// each part has been locked and only release it on the last unlock. They are also dropped
+// when *any* descriptor of data.lock is closed, so we open it once and keep it open.
+//
+// Windows has no fcntl; there the locks do nothing and only one copy of the program
+// should use a data folder at a time.
+
+#include "file_lock.h"
+#include "stats.h"  // For counting file activity
+
+#ifdef _WIN32
+
+static int generation = 0;
+
+void lock_data(int part, int exclusive) {
+    (void)part;
+    (void)exclusive;
+}
+
+void unlock_data(int part) {
+    (void)part;
+}
+
+int data_generation() {
+    return generation;
+}
+
+void bump_data_generation() {
+    generation++;
+}
+
+FILE *create_temp_file(const char *path, char *temp_path, size_t temp_size) {
+    snprintf(temp_path, temp_size, "%s.tmp", path);
+    return stats_fopen(temp_path, "wb");
+}
+
+FILE *open_locked(const char *path) {
+    FILE *file = stats_fopen(path, "r+");
+    return file ? file : stats_fopen(path, "w+");
+}
+
+#else
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#define GENERATION_OFFSET 64
+
+static int lock_fd = -1;
+static int depth[LOCK_PARTS];
+
+// Opens data.lock the first time we need it
+static int lock_file() {
+    if (lock_fd < 0) {
+        lock_fd = open(LOCK_FILE_PATH, O_RDWR | O_CREAT, 0644);
+        if (lock_fd < 0) {
+            printf("Error: Unable to open %s; running without file locks.\n", LOCK_FILE_PATH);
+        }
+    }
+    return lock_fd;
+}
+
+// Sets a lock of the given type (F_RDLCK, F_WRLCK or F_UNLCK) on len bytes at start
+static int set_lock(int fd, int type, off_t start, off_t len) {
+    struct flock region;
+    memset(&region, 0, sizeof(region));
+    region.l_type = (short)type;
+    region.l_whence = SEEK_SET;
+    region.l_start = start;
+    region.l_len = len;
+    while (fcntl(fd, F_SETLKW, &region) != 0) {
+        if (errno != EINTR) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void lock_data(int part, int exclusive) {
+    if (part < 0 || part >= LOCK_PARTS) {
+        return;
+    }
+    if (depth[part]++ > 0) {
+        return;  // already held by this process
+    }
+    int fd = lock_file();
+    if (fd >= 0 && !set_lock(fd, exclusive ? F_WRLCK : F_RDLCK, part, 1)) {
+        printf("Error: Unable to lock %s.\n", LOCK_FILE_PATH);
+    }
+}
+
+void unlock_data(int part) {
+    if (part < 0 || part >= LOCK_PARTS || depth[part] == 0) {
+        return;
+    }
+    if (--depth[part] > 0) {
+        return;
+    }
+    if (lock_fd >= 0) {
+        set_lock(lock_fd, F_UNLCK, part, 1);
+    }
+}
+
+int data_generation() {
+    int fd = lock_file();
+    int generation = 0;
+    if (fd < 0 || pread(fd, &generation, sizeof(generation), GENERATION_OFFSET) != sizeof(generation)) {
+        return 0;  // a new lock file hasn't had a compaction yet
+    }
+    return generation;
+}
+
+void bump_data_generation() {
+    int fd = lock_file();
+    if (fd < 0) {
+        return;
+    }
+    int generation = data_generation() + 1;
+    if (pwrite(fd, &generation, sizeof(generation), GENERATION_OFFSET) != sizeof(generation)) {
+        printf("Error: Unable to update %s.\n", LOCK_FILE_PATH);
+    }
+}
+
+FILE *create_temp_file(const char *path, char *temp_path, size_t temp_size) {
+    snprintf(temp_path, temp_size, "%s.XXXXXX", path);
+    int fd = mkstemp(temp_path);
+    if (fd < 0) {
+        return NULL;
+    }
+    fchmod(fd, 0644);  // mkstemp makes the file private; data files are normally readable
+    FILE *file = fdopen(fd, "wb");
+    if (!file) {
+        close(fd);
+        remove(temp_path);
+        return NULL;
+    }
+    stats_opened();
+    return file;
+}
+
+FILE *open_locked(const char *path) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    FILE *file = fdopen(fd, "r+");
+    if (!file) {
+        close(fd);
+        return NULL;
+    }
+    if (!set_lock(fd, F_WRLCK, 0, 0)) {
+        fclose(file);
+        return NULL;
+    }
+    stats_opened();
+    return file;
+}
+
+#endif
@@ -0,0 +1,49 @@
+// file_lock.h
+// Lets several copies of the program share one data folder safely. Each part of the data
+// (the status log, items, requests, users, wishlists) has its own lock, so for example
+// adding an item never waits for someone signing up. The locks are advisory byte-range locks (fcntl) on a
+// small file, data.lock, which the operating system releases by itself if a process dies.
+//
+// Reading a part takes its lock shared (any number of readers at once); changing it takes
+// the lock exclusive. When a function needs more than one lock it must take them in the
+// order of the LOCK_* numbers below, so two processes can never wait on each other.
+
+#ifndef FILE_LOCK_H
+#define FILE_LOCK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOCK_FILE_PATH "../data/data.lock"
+
+// The parts of the data folder that can be locked, in the order they must be taken
+#define LOCK_STATUS_LOG 0   // status_log.txt, and compaction (which rewrites everything)
+#define LOCK_ITEMS 1        // items.txt, items.bin and items.idx
+#define LOCK_REQUESTS 2     // requests.txt, requests.bin and requests.idx
+#define LOCK_USERS 3        // users.txt
+#define LOCK_WISHLISTS 4    // wishlists.txt and the notification files
+#define LOCK_PARTS 5
+
+// Waits for and takes a lock on one part (exclusive = 1 to change it, 0 to read it).
+// Taking a lock this process already holds just counts up; each call needs a matching
+// unlock_data. A nested call can't turn a shared lock into an exclusive one.
+void lock_data(int part, int exclusive);
+void unlock_data(int part);
+
+// A number that goes up every time compaction rewrites items.txt and requests.txt.
+// If it changed since a table was loaded, the rows we've seen may have moved, so the
+// table has to be read again from the start.
+int data_generation();
+void bump_data_generation();  // call while holding LOCK_STATUS_LOG exclusive
+
+// Creates a new, uniquely named temp file next to path (e.g. "../data/items.txt.X1b2C3")
+// and writes its name into temp_path. The file is opened for writing in binary mode.
+// Returns NULL if it couldn't be created.
+FILE *create_temp_file(const char *path, char *temp_path, size_t temp_size);
+
+// Opens (creating if needed) a small file for reading and writing and waits for an
+// exclusive lock on it. fclose releases the lock. Returns NULL on error.
+FILE *open_locked(const char *path);
+
+#endif /* FILE_LOCK_H */
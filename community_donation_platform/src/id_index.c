@@ -0,0 +1,355 @@
+// id_index.c
+// Keeps items.idx and requests.idx (see id_index.h). Both work the same way, so each is
+// described by an IndexPart: which files it follows, how a CSV row becomes a record, and
+// where in the record the status is. Each program keeps an index open between lookups,
+// with its small page cache, and notices when another program built a new one.
+
+#include "id_index.h"
+#include "btree.h"
+#include "status_log.h" // For replaying status changes into the index
+#include "file_lock.h"  // For sharing the data folder with other programs
+#include "stats.h"      // For counting calls and file activity
+#include "durable.h"    // For swapping in a rebuilt index safely
+#include "csv.h"        // For reading items.txt and requests.txt
+#include "data_watch.h" // For file_tail_check
+#include <stddef.h>     // For offsetof()
+#include <sys/stat.h>   // For checking file sizes
+
+// An item record in items.idx (the item_id is the key)
+typedef struct {
+    char donor_username[21];
+    char category[DICT_TEXT_SIZE];
+    char description[MAX_DESC];
+    char condition[DICT_TEXT_SIZE];
+    char status[DICT_TEXT_SIZE];
+} ItemEntry;
+
+// A request record in requests.idx (the request_id is the key)
+typedef struct {
+    int item_id;
+    char recipient_username[21];
+    char status[DICT_TEXT_SIZE];
+} RequestEntry;
+
+typedef struct {
+    const char *path;          // the index file
+    const char *csv_path;      // the data file it follows
+    const char *csv_name;      // for messages
+    const char *magic;
+    char table;                // 'I' or 'R' in the status log
+    int lock;                  // LOCK_ITEMS or LOCK_REQUESTS
+    int value_size;
+    size_t status_offset;      // where the status text is in a record
+    int (*from_row)(const CsvReader *reader, int *id, void *value);
+    BTree tree;
+    int open;                  // tree is open
+    long long identity;        // which file tree is (inode number), to notice a rebuild
+    int current;               // caught up for the compaction under way
+} IndexPart;
+
+// Turns an items.txt row into a key and record. Returns 0 for rows load_items would skip.
+static int item_entry_from_row(const CsvReader *reader, int *id, void *value) {
+    ItemEntry *entry = value;
+    return reader->field_count == 6 &&
+           csv_int(reader, 0, id) &&
+           csv_copy(reader, 1, entry->donor_username, sizeof(entry->donor_username)) &&
+           csv_copy(reader, 2, entry->category, sizeof(entry->category)) &&
+           csv_copy(reader, 3, entry->description, sizeof(entry->description)) &&
+           csv_copy(reader, 4, entry->condition, sizeof(entry->condition)) &&
+           csv_copy(reader, 5, entry->status, sizeof(entry->status));
+}
+
+// The same for a requests.txt row
+static int request_entry_from_row(const CsvReader *reader, int *id, void *value) {
+    RequestEntry *entry = value;
+    return reader->field_count == 4 &&
+           csv_int(reader, 0, id) &&
+           csv_int(reader, 1, &entry->item_id) &&
+           csv_copy(reader, 2, entry->recipient_username, sizeof(entry->recipient_username)) &&
+           csv_copy(reader, 3, entry->status, sizeof(entry->status));
+}
+
+static IndexPart item_index = {
+    ITEM_INDEX_PATH, ITEM_FILE_PATH, "items.txt", "CDXI", 'I', LOCK_ITEMS,
+    sizeof(ItemEntry), offsetof(ItemEntry, status), item_entry_from_row, { 0 }, 0, 0, 0
+};
+static IndexPart request_index = {
+    REQUEST_INDEX_PATH, REQUEST_FILE_PATH, "requests.txt", "CDXR", 'R', LOCK_REQUESTS,
+    sizeof(RequestEntry), offsetof(RequestEntry, status), request_entry_from_row, { 0 }, 0, 0, 0
+};
+
+// Pages read and written by trees we have closed since
+static long long closed_pages_read = 0;
+static long long closed_pages_written = 0;
+
+// Size of a file in bytes, or -1 if it doesn't exist
+static long long file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (long long)st.st_size : -1;
+}
+
+// Which file is at path (its inode number; always 0 on Windows), or -1 if none
+static long long file_identity(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (long long)st.st_ino : -1;
+}
+
+static void close_part(IndexPart *part) {
+    if (part->open) {
+        closed_pages_read += part->tree.pages_read;
+        closed_pages_written += part->tree.pages_written;
+        btree_close(&part->tree);
+        part->open = 0;
+    }
+}
+
+// Makes sure part->tree is the index file that is at part->path now
+static int open_part(IndexPart *part) {
+    long long identity = file_identity(part->path);
+    if (part->open && identity != part->identity) {
+        close_part(part);  // built again (or removed) by another program
+    }
+    if (!part->open) {
+        if (identity < 0 || !btree_open(&part->tree, part->path, part->magic, part->value_size,
+                                        BTREE_CACHE_PAGES, 0)) {
+            return 0;
+        }
+        part->open = 1;
+        part->identity = identity;
+    }
+    return 1;
+}
+
+// Inserts the rows of the CSV file from byte *size on, and moves *size to the end of the
+// file. A row whose ID is already there is skipped, like load_items and load_requests do.
+static int add_rows(IndexPart *part, long long *size) {
+    FILE *file = stats_fopen(part->csv_path, "r");
+    if (!file) {
+        return *size == 0;  // no rows yet
+    }
+    if (*size > 0) {
+        fseek(file, (long)*size, SEEK_SET);
+    }
+    CsvReader reader;
+    if (!csv_open(&reader, file, part->csv_name)) {
+        printf("Error: Not enough memory to index %s.\n", part->csv_name);
+        fclose(file);
+        return 0;
+    }
+    long long start = reader.offset;
+    long long records = 0;
+    int header = *size == 0;
+    int ok = 1;
+    char value[BTREE_MAX_VALUE_SIZE], existing[BTREE_MAX_VALUE_SIZE];
+    while (ok && csv_next(&reader)) {
+        if (header) {
+            header = 0;
+            continue;
+        }
+        int id;
+        // Zero the record first so unused bytes in the strings are always the same
+        memset(value, 0, (size_t)part->value_size);
+        if (!part->from_row(&reader, &id, value)) {
+            csv_skip(&reader);
+            continue;
+        }
+        records++;
+        int found = btree_find(&part->tree, id, existing);
+        ok = found == 0 ? btree_put(&part->tree, id, value) : found == 1;
+    }
+    *size = reader.offset;
+    stats_read(reader.offset - start, records);
+    csv_close(&reader);
+    fclose(file);
+    return ok;
+}
+
+// The index replay_status_log is applying changes to (it takes no context pointer)
+static IndexPart *applying = NULL;
+static int apply_failed = 0;
+
+// Writes a logged status change into its record in place
+static void apply_logged_status(int id, const char *status) {
+    char value[BTREE_MAX_VALUE_SIZE];
+    int found = btree_find(&applying->tree, id, value);
+    if (found == 1) {
+        char *field = value + applying->status_offset;
+        memset(field, 0, DICT_TEXT_SIZE);
+        strncat(field, status, DICT_TEXT_SIZE - 1);
+        found = btree_update(&applying->tree, id, value);
+    }
+    if (found < 0) {
+        apply_failed = 1;
+    }
+}
+
+// Adds whatever the CSV file and the status log have beyond what stamp covers, and commits
+// with the new stamp if anything was added (or always, for a new tree). The caller holds
+// LOCK_STATUS_LOG and the part's lock exclusive, so neither file can grow meanwhile.
+static int catch_up_from(IndexPart *part, BTreeStamp *stamp, int always_commit) {
+    int changed = always_commit;
+    if (file_size(part->csv_path) > stamp->source_size) {
+        if (!add_rows(part, &stamp->source_size)) {
+            return 0;
+        }
+        stamp->source_check = file_tail_check(part->csv_path, stamp->source_size);
+        changed = 1;
+    }
+    long offset = (long)stamp->log_offset;
+    applying = part;
+    apply_failed = 0;
+    replay_status_log(part->table, apply_logged_status, &offset);
+    applying = NULL;
+    if (apply_failed) {
+        return 0;
+    }
+    if (offset != stamp->log_offset) {
+        stamp->log_offset = offset;
+        changed = 1;
+    }
+    return !changed || btree_commit(&part->tree, stamp);
+}
+
+// Opens the index and brings it up to date. Returns 0 if there is no index, or it doesn't
+// match the data files any more and has to be built again.
+static int catch_up(IndexPart *part) {
+    if (!open_part(part) || !btree_refresh(&part->tree)) {
+        return 0;
+    }
+    BTreeStamp stamp = part->tree.header.stamp;
+    long long csv_size = file_size(part->csv_path);
+    long long log_size = file_size(STATUS_LOG_PATH);
+    if (stamp.generation != data_generation() ||
+        csv_size < stamp.source_size ||
+        (stamp.source_size > 0 &&
+         file_tail_check(part->csv_path, stamp.source_size) != stamp.source_check) ||
+        (log_size < 0 ? stamp.log_offset > 0 : log_size < stamp.log_offset)) {
+        return 0;  // the files were rewritten since the index last saw them
+    }
+    return catch_up_from(part, &stamp, 0);
+}
+
+static int build_index(IndexPart *part) {
+    // Nobody may change the CSV file or the log while we read them
+    lock_data(LOCK_STATUS_LOG, 0);
+    lock_data(part->lock, 1);
+    close_part(part);
+
+    // Build the new tree beside the old one, then swap it in
+    char temp_path[300];
+    FILE *tempFile = create_temp_file(part->path, temp_path, sizeof(temp_path));
+    int ok = 0;
+    if (tempFile) {
+        fclose(tempFile);
+        if (btree_open(&part->tree, temp_path, part->magic, part->value_size,
+                       BTREE_CACHE_PAGES, 1)) {
+            part->open = 1;
+            BTreeStamp stamp = { 0, 0, data_generation(), 0 };
+            ok = catch_up_from(part, &stamp, 1);
+            close_part(part);
+        }
+        if (ok) {
+            ok = replace_file(temp_path, part->path);
+        } else {
+            remove(temp_path);
+        }
+    }
+    if (!ok) {
+        printf("Error: Unable to build %s.\n", part->path);
+    }
+    unlock_data(part->lock);
+    unlock_data(LOCK_STATUS_LOG);
+    return ok;
+}
+
+int build_item_index() {
+    return build_index(&item_index);
+}
+
+int build_request_index() {
+    return build_index(&request_index);
+}
+
+// Catches up an index and copies out one record. Returns 1, 0 or -1 like find_indexed_item.
+static int find_entry(IndexPart *part, int id, void *value) {
+    lock_data(LOCK_STATUS_LOG, 0);
+    lock_data(part->lock, 1);
+    int found = catch_up(part) ? btree_find(&part->tree, id, value) : -1;
+    unlock_data(part->lock);
+    unlock_data(LOCK_STATUS_LOG);
+    return found;
+}
+
+// The dictionary code for a text from an index, or -1 if the dictionary is full
+static int entry_code(int dict, const char *text, unsigned short *code) {
+    int value = dict_code(dict, text);
+    if (value < 0) {
+        return 0;
+    }
+    *code = (unsigned short)value;
+    return 1;
+}
+
+int find_indexed_item(int item_id, Item *item) {
+    STATS_TIME(STAT_FIND_INDEXED_ITEM);
+    ItemEntry entry;
+    int found = find_entry(&item_index, item_id, &entry);
+    if (found != 1) {
+        return found;
+    }
+    memset(item, 0, sizeof(*item));
+    item->item_id = item_id;
+    memcpy(item->donor_username, entry.donor_username, sizeof(item->donor_username));
+    memcpy(item->description, entry.description, sizeof(item->description));
+    return entry_code(DICT_CATEGORY, entry.category, &item->category) &&
+           entry_code(DICT_CONDITION, entry.condition, &item->condition) &&
+           entry_code(DICT_STATUS, entry.status, &item->status) ? 1 : -1;
+}
+
+int find_indexed_request(int request_id, Request *req) {
+    STATS_TIME(STAT_FIND_INDEXED_REQUEST);
+    RequestEntry entry;
+    int found = find_entry(&request_index, request_id, &entry);
+    if (found != 1) {
+        return found;
+    }
+    memset(req, 0, sizeof(*req));
+    req->request_id = request_id;
+    req->item_id = entry.item_id;
+    memcpy(req->recipient_username, entry.recipient_username, sizeof(req->recipient_username));
+    return entry_code(DICT_STATUS, entry.status, &req->status) ? 1 : -1;
+}
+
+void catch_up_indexes() {
+    // Once the log is folded in, an index that missed part of it couldn't catch up any more
+    item_index.current = catch_up(&item_index);
+    request_index.current = catch_up(&request_index);
+}
+
+// Notes the rewritten CSV file and the emptied log in an index that was caught up
+static void restamp(IndexPart *part) {
+    if (!part->current) {
+        return;
+    }
+    part->current = 0;
+    BTreeStamp stamp = part->tree.header.stamp;
+    long long size = file_size(part->csv_path);
+    stamp.source_size = size > 0 ? size : 0;
+    stamp.source_check = size > 0 ? file_tail_check(part->csv_path, size) : 0;
+    stamp.generation = data_generation();
+    stamp.log_offset = 0;
+    btree_commit(&part->tree, &stamp);
+}
+
+void restamp_indexes() {
+    restamp(&item_index);
+    restamp(&request_index);
+}
+
+long long index_pages_read() {
+    return closed_pages_read + item_index.tree.pages_read + request_index.tree.pages_read;
+}
+
+long long index_pages_written() {
+    return closed_pages_written + item_index.tree.pages_written + request_index.tree.pages_written;
+}
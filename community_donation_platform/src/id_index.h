@@ -0,0 +1,47 @@
+// id_index.h
+// Optional on-disk indexes of items.txt and requests.txt by ID (items.idx, requests.idx),
+// for looking up one record without loading a whole data file into memory. Each index is
+// a B+tree (see btree.h) whose records are the rows as text, so an index means the same
+// to every program whatever codes its dictionaries handed out.
+//
+// The CSV files and the status log stay the real data. An index notes how much of the
+// CSV file and of the log it holds (its "stamp"), and every lookup first catches it up:
+// rows added to the CSV file since are inserted, and status changes logged since are
+// written into their records in place. Compaction keeps the indexes in step too. An index
+// that no longer matches (the CSV file was rewritten another way, or a crash left it
+// half-changed) is ignored until it is built again with --to-index.
+
+#ifndef ID_INDEX_H
+#define ID_INDEX_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "items.h"
+#include "requests.h"
+
+// Where the indexes live
+#define ITEM_INDEX_PATH "../data/items.idx"
+#define REQUEST_INDEX_PATH "../data/requests.idx"
+
+// Builds an index from scratch from the CSV file and the status log, replacing any old
+// one. Returns 1 on success.
+int build_item_index();
+int build_request_index();
+
+// Looks up a record by ID through its index. Returns 1 if found (and fills in the record),
+// 0 if there is no such ID, -1 if there is no usable index (build one with --to-index).
+// Catching up can write to the index, so in server mode these count as writes.
+int find_indexed_item(int item_id, Item *item);
+int find_indexed_request(int request_id, Request *req);
+
+// For compact_status_log, which holds every data lock: catch the indexes up before the
+// log is folded into the CSV files, then note the rewritten files once it is.
+void catch_up_indexes();
+void restamp_indexes();
+
+// How many index pages were read and written so far (for the benchmark)
+long long index_pages_read();
+long long index_pages_written();
+
+#endif /* ID_INDEX_H */
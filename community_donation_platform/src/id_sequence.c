@@ -0,0 +1,134 @@
+// id_sequence.c
+// Keeps one number per table in a sidecar file: the last ID that was handed out.
+// The sequence file is always written BEFORE the new record is appended to the table,
+// so after a crash the file is either up to date or a little ahead (which just skips an ID).
+// If the file is lost or half-written, the caller's known_max (the largest ID actually in
+// the table) keeps us from ever handing out an ID twice.
+// The file is locked while we read and update it, so two programs sharing the data folder
+// can never reserve the same IDs.
+
+#include "id_sequence.h"
+#include "file_lock.h"  // For locking the sequence file
+
+// Reads the last used ID from an open sequence file (0 if it's empty or unreadable)
+static int read_sequence(FILE *file) {
+    rewind(file);
+    int last_id = 0;
+    if (fscanf(file, "%d", &last_id) != 1 || last_id < 0) {
+        last_id = 0;
+    }
+    return last_id;
+}
+
+// Overwrites the number in an open sequence file. It is always written at the same width,
+// so the new number fully covers the old one and the file never has to be truncated.
+static int write_sequence(FILE *file, int last_id) {
+    rewind(file);
+    fprintf(file, "%11d\n", last_id);
+    return fflush(file) == 0;
+}
+
+// IDs are reserved from the sequence file a block at a time, so most calls to next_id just
+// count up in memory. The file always holds the end of the newest block anyone reserved;
+// after a crash the unused rest of a block is skipped, which is allowed (IDs only have to
+// be unique).
+#define ID_BLOCK_SIZE 64
+#define MAX_SEQUENCES 4
+
+typedef struct {
+    const char *seq_path;  // which sequence file this lease belongs to
+    int last_given;        // last ID handed out from the block
+    int block_end;         // last ID the sequence file has reserved for us
+} IdLease;
+
+static IdLease leases[MAX_SEQUENCES];
+static int lease_count = 0;
+
+// On a normal exit, hands the unused part of each block back by writing the last ID we
+// actually gave out, so IDs stay consecutive from one run to the next. If another program
+// has reserved a block after ours in the meantime, ours isn't the end any more and we leave
+// the file alone.
+static void return_unused_ids(void) {
+    for (int i = 0; i < lease_count; i++) {
+        if (leases[i].last_given == 0 || leases[i].last_given >= leases[i].block_end) {
+            continue;
+        }
+        FILE *file = open_locked(leases[i].seq_path);
+        if (file) {
+            if (read_sequence(file) == leases[i].block_end) {
+                write_sequence(file, leases[i].last_given);
+            }
+            fclose(file);
+        }
+    }
+}
+
+// Finds the lease for a sequence file, starting an empty one the first time
+static IdLease *find_lease(const char *seq_path) {
+    for (int i = 0; i < lease_count; i++) {
+        if (strcmp(leases[i].seq_path, seq_path) == 0) {
+            return &leases[i];
+        }
+    }
+    if (lease_count == MAX_SEQUENCES) {
+        return NULL;
+    }
+    if (lease_count == 0) {
+        atexit(return_unused_ids);
+    }
+    IdLease *lease = &leases[lease_count++];
+    lease->seq_path = seq_path;
+    lease->last_given = 0;
+    lease->block_end = 0;
+    return lease;
+}
+
+int next_id(const char *seq_path, int known_max) {
+    IdLease *lease = find_lease(seq_path);
+    if (lease && lease->last_given < lease->block_end) {
+        // An ID past our block came from a block the file gave to another program after
+        // ours, so it can't collide with what's left of ours. Only IDs inside our block
+        // (say the file was lost and someone reused them) mean we must skip ahead.
+        if (known_max > lease->last_given && known_max <= lease->block_end) {
+            lease->last_given = known_max;
+        }
+        if (lease->last_given < lease->block_end) {
+            return ++lease->last_given;
+        }
+    }
+
+    // Out of reserved IDs: reserve the next block in the file before using any of it
+    FILE *file = open_locked(seq_path);
+    if (!file) {
+        printf("Error: Unable to update %s.\n", seq_path);
+        // Still unique for this run, the table itself has the max
+        int new_id = known_max + 1;
+        if (lease && lease->last_given >= new_id) {
+            new_id = lease->last_given + 1;
+        }
+        if (lease) {
+            lease->last_given = new_id;
+        }
+        return new_id;
+    }
+    int last_id = read_sequence(file);
+    if (known_max > last_id) {  // the file was lost or damaged: never go below the table
+        last_id = known_max;
+    }
+    if (lease && lease->last_given > last_id) {
+        last_id = lease->last_given;
+    }
+    int new_id = last_id + 1;
+    int block_end = lease ? last_id + ID_BLOCK_SIZE : new_id;
+
+    int ok = write_sequence(file, block_end);
+    if (fclose(file) != 0 || !ok) {
+        printf("Error: Unable to update %s.\n", seq_path);
+        block_end = new_id;  // nothing was reserved, so don't hand out more from memory
+    }
+    if (lease) {
+        lease->last_given = new_id;
+        lease->block_end = block_end;
+    }
+    return new_id;
+}
@@ -0,0 +1,23 @@
+// id_sequence.h
+// Hands out new item and request IDs. The last ID given out for each table is kept in a
+// small sidecar file (items.seq, requests.seq), so getting the next ID never means
+// re-reading the table itself, and IDs keep counting up across restarts.
+
+#ifndef ID_SEQUENCE_H
+#define ID_SEQUENCE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Where the last used ID for each table is stored
+#define ITEM_SEQ_PATH "../data/items.seq"
+#define REQUEST_SEQ_PATH "../data/requests.seq"
+
+// Returns the next ID for a table. The sequence file is only rewritten once every
+// ID_BLOCK_SIZE IDs, when a new block of IDs is reserved.
+// known_max is the highest ID already present in the table; the new ID is always
+// bigger than it, even if the sequence file is missing or was damaged in a crash.
+int next_id(const char *seq_path, int known_max);
+
+#endif /* ID_SEQUENCE_H */
@@ -0,0 +1,439 @@
+// item_columns.c
+// The item columns and the filter kernels that run over them. Every column has room for a
+// multiple of 64 items, so a kernel always works on whole blocks of 64 (one word of the
+// selection bitmap) and the bits past the last item are simply cleared at the end.
+//
+// The SIMD kernels compare LANES items per step: each comparison gives a lane of all ones
+// or all zeros, and "movemask" squeezes those lanes down to one bit per item.
+// Which kernel we get is decided when compiling: -mavx2 (or -march=native on a machine
+// that has it) picks AVX2, and every 64-bit x86 compiler has SSE2. Anything else
+// (like ARM) gets the plain C loop.
+
+#include "item_columns.h"
+#include <ctype.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define KERNEL_NAME "avx2"
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define KERNEL_NAME "sse2"
+#else
+#define KERNEL_NAME "scalar"
+#endif
+
+#define COLUMN_BLOCK 64   // items per selection word
+
+static int started = 0;
+static int item_count = 0;
+static int item_capacity = 0;          // always a multiple of COLUMN_BLOCK
+static int *ids = NULL;
+static unsigned short *statuses = NULL;
+static unsigned short *categories = NULL;
+static unsigned short *conditions = NULL;
+static int *donors = NULL;
+
+// Donor usernames get numbers in the order we first see them
+static char (*donor_names)[21] = NULL;
+static int donor_count = 0;
+static int donor_capacity = 0;
+static int *donor_slots = NULL;        // hash table from username to donor number; -1 = empty
+static int donor_slot_count = 0;
+
+void item_filter_any(ItemFilter *filter) {
+    memset(filter, 0, sizeof(*filter));
+    filter->status = -1;
+    filter->donor = -1;
+}
+
+void item_columns_keep(int keep) {
+    started = keep;
+    item_count = 0;
+}
+
+int item_columns_kept() {
+    return started;
+}
+
+void item_columns_clear() {
+    item_count = 0;
+}
+
+int item_columns_count() {
+    return item_count;
+}
+
+int item_columns_words() {
+    return (item_count + COLUMN_BLOCK - 1) / COLUMN_BLOCK;
+}
+
+const char *item_columns_kernel() {
+    return KERNEL_NAME;
+}
+
+// Grows one column to new_capacity entries, zeroing the new ones
+static int grow_column(void **column, size_t entry_size, int new_capacity) {
+    char *bigger = realloc(*column, entry_size * new_capacity);
+    if (!bigger) {
+        return 0;
+    }
+    memset(bigger + entry_size * item_capacity, 0, entry_size * (new_capacity - item_capacity));
+    *column = bigger;
+    return 1;
+}
+
+// Doubles the room in every column
+static int grow_columns() {
+    int new_capacity = item_capacity ? item_capacity * 2 : 1024;
+    if (!grow_column((void **)&ids, sizeof(int), new_capacity) ||
+        !grow_column((void **)&statuses, sizeof(unsigned short), new_capacity) ||
+        !grow_column((void **)&categories, sizeof(unsigned short), new_capacity) ||
+        !grow_column((void **)&conditions, sizeof(unsigned short), new_capacity) ||
+        !grow_column((void **)&donors, sizeof(int), new_capacity)) {
+        return 0;  // the columns that did grow are just roomier than they need to be
+    }
+    item_capacity = new_capacity;
+    return 1;
+}
+
+// Picks the starting hash slot for a username (FNV-1a)
+static int donor_hash(const char *name) {
+    unsigned int h = 2166136261u;
+    for (int i = 0; name[i]; i++) {
+        h = (h ^ (unsigned char)name[i]) * 16777619u;
+    }
+    return (int)(h & (unsigned int)(donor_slot_count - 1));
+}
+
+// Finds a donor's number, or -1. *free_slot gets the slot where it would go.
+static int find_donor(const char *name, int *free_slot) {
+    if (donor_slot_count == 0) {
+        return -1;
+    }
+    int slot = donor_hash(name);
+    while (donor_slots[slot] != -1) {
+        if (strcmp(donor_names[donor_slots[slot]], name) == 0) {
+            return donor_slots[slot];
+        }
+        slot = (slot + 1) & (donor_slot_count - 1);
+    }
+    if (free_slot) {
+        *free_slot = slot;
+    }
+    return -1;
+}
+
+// Doubles the donor hash table and re-inserts every donor
+static int grow_donor_slots() {
+    int new_count = donor_slot_count ? donor_slot_count * 2 : 256;
+    int *new_slots = malloc(sizeof(int) * new_count);
+    if (!new_slots) {
+        return 0;
+    }
+    free(donor_slots);
+    donor_slots = new_slots;
+    donor_slot_count = new_count;
+    for (int i = 0; i < new_count; i++) {
+        donor_slots[i] = -1;
+    }
+    for (int d = 0; d < donor_count; d++) {
+        int slot = donor_hash(donor_names[d]);
+        while (donor_slots[slot] != -1) {
+            slot = (slot + 1) & (new_count - 1);
+        }
+        donor_slots[slot] = d;
+    }
+    return 1;
+}
+
+// Returns a donor's number, giving them the next one if they're new (-1 if out of memory)
+static int donor_number(const char *name) {
+    int slot;
+    int donor = find_donor(name, &slot);
+    if (donor >= 0) {
+        return donor;
+    }
+    if ((donor_count + 1) * 10 > donor_slot_count * 7) {
+        if (!grow_donor_slots()) {
+            return -1;
+        }
+        find_donor(name, &slot);
+    }
+    if (donor_count == donor_capacity) {
+        int new_capacity = donor_capacity ? donor_capacity * 2 : 256;
+        char (*bigger)[21] = realloc(donor_names, sizeof(*donor_names) * new_capacity);
+        if (!bigger) {
+            return -1;
+        }
+        donor_names = bigger;
+        donor_capacity = new_capacity;
+    }
+    size_t length = strlen(name);
+    if (length >= sizeof(donor_names[0])) {
+        length = sizeof(donor_names[0]) - 1;
+    }
+    memcpy(donor_names[donor_count], name, length);
+    donor_names[donor_count][length] = '\0';
+    donor_slots[slot] = donor_count;
+    return donor_count++;
+}
+
+int item_columns_donor(const char *username) {
+    return find_donor(username, NULL);
+}
+
+int item_columns_add(int position, const Item *item) {
+    while (position >= item_capacity) {
+        if (!grow_columns()) {
+            return 0;
+        }
+    }
+    int donor = donor_number(item->donor_username);
+    if (donor < 0) {
+        return 0;
+    }
+    ids[position] = item->item_id;
+    statuses[position] = item->status;
+    categories[position] = item->category;
+    conditions[position] = item->condition;
+    donors[position] = donor;
+    if (position >= item_count) {
+        item_count = position + 1;
+    }
+    return 1;
+}
+
+// Compares two texts, ignoring upper/lower case
+static int same_text(const char *a, const char *b) {
+    while (*a && tolower((unsigned char)*a) == tolower((unsigned char)*b)) {
+        a++;
+        b++;
+    }
+    return tolower((unsigned char)*a) == tolower((unsigned char)*b);
+}
+
+// Adds the codes of every spelling of name in a dictionary to codes (at most
+// FILTER_MAX_CODES in all). Returns how many it added.
+static int add_codes(int dict, const char *name, unsigned short *codes, int *count) {
+    int added = 0;
+    for (int code = 1; code < dict_size(dict) && *count < FILTER_MAX_CODES; code++) {
+        if (same_text(dict_text(dict, code), name)) {
+            codes[(*count)++] = (unsigned short)code;
+            added++;
+        }
+    }
+    return added;
+}
+
+int item_filter_for(const char *category_text, const char *condition_text, ItemFilter *filter) {
+    filter->category_count = 0;
+    filter->condition_count = 0;
+    if (!same_text(category_text, "any") &&
+        add_codes(DICT_CATEGORY, category_text, filter->categories, &filter->category_count) == 0) {
+        return 0;
+    }
+    if (same_text(condition_text, "any")) {
+        return 1;
+    }
+    // Conditions are separated by slashes: "New/Good"
+    const char *p = condition_text;
+    while (*p) {
+        char name[DICT_TEXT_SIZE];
+        size_t length = strcspn(p, "/");
+        if (length > 0 && length < sizeof(name)) {
+            memcpy(name, p, length);
+            name[length] = '\0';
+            add_codes(DICT_CONDITION, name, filter->conditions, &filter->condition_count);
+        }
+        p += length;
+        if (*p == '/') {
+            p++;
+        }
+    }
+    return filter->condition_count > 0;
+}
+
+// Is code one of codes[0 .. n - 1]?
+static int has_code(const unsigned short *codes, int n, unsigned short code) {
+    for (int i = 0; i < n; i++) {
+        if (codes[i] == code) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int item_matches_filter(const ItemFilter *filter, const Item *item) {
+    return (filter->status < 0 || item->status == filter->status) &&
+           (filter->category_count == 0 ||
+            has_code(filter->categories, filter->category_count, item->category)) &&
+           (filter->condition_count == 0 ||
+            has_code(filter->conditions, filter->condition_count, item->condition)) &&
+           (filter->donor < 0 || item_columns_donor(item->donor_username) == filter->donor) &&
+           item->item_id >= filter->min_id;
+}
+
+void item_columns_set_status(int position, int status) {
+    if (position >= 0 && position < item_count) {
+        statuses[position] = (unsigned short)status;
+    }
+}
+
+#if defined(__AVX2__) || defined(__SSE2__)
+
+#if defined(__AVX2__)
+typedef __m256i Vector;
+#define LANES 16   // 16-bit codes per vector
+
+static Vector splat16(int value) {
+    return _mm256_set1_epi16((short)value);
+}
+
+static Vector splat32(int value) {
+    return _mm256_set1_epi32(value);
+}
+
+// One bit per item: is its code one of codes[0 .. n - 1]?
+static unsigned int code_bits(const unsigned short *column, int start, const Vector *codes, int n) {
+    __m256i values = _mm256_loadu_si256((const __m256i *)(column + start));
+    __m256i hits = _mm256_cmpeq_epi16(values, codes[0]);
+    for (int i = 1; i < n; i++) {
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi16(values, codes[i]));
+    }
+    // Packing works on each 128-bit half separately, so items 8-15 land in bits 16-23
+    unsigned int mask = (unsigned int)_mm256_movemask_epi8(
+        _mm256_packs_epi16(hits, _mm256_setzero_si256()));
+    return (mask & 0xFF) | ((mask >> 8) & 0xFF00);
+}
+
+// One bit per item: is its number equal to value (or above it, if above is set)?
+static unsigned int int_bits(const int *column, int start, Vector value, int above) {
+    unsigned int bits = 0;
+    for (int half = 0; half < 2; half++) {
+        __m256i values = _mm256_loadu_si256((const __m256i *)(column + start + half * 8));
+        __m256i hits = above ? _mm256_cmpgt_epi32(values, value) : _mm256_cmpeq_epi32(values, value);
+        bits |= (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(hits)) << (half * 8);
+    }
+    return bits;
+}
+#else
+typedef __m128i Vector;
+#define LANES 8    // 16-bit codes per vector
+
+static Vector splat16(int value) {
+    return _mm_set1_epi16((short)value);
+}
+
+static Vector splat32(int value) {
+    return _mm_set1_epi32(value);
+}
+
+// One bit per item: is its code one of codes[0 .. n - 1]?
+static unsigned int code_bits(const unsigned short *column, int start, const Vector *codes, int n) {
+    __m128i values = _mm_loadu_si128((const __m128i *)(column + start));
+    __m128i hits = _mm_cmpeq_epi16(values, codes[0]);
+    for (int i = 1; i < n; i++) {
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi16(values, codes[i]));
+    }
+    return (unsigned int)_mm_movemask_epi8(_mm_packs_epi16(hits, _mm_setzero_si128()));
+}
+
+// One bit per item: is its number equal to value (or above it, if above is set)?
+static unsigned int int_bits(const int *column, int start, Vector value, int above) {
+    unsigned int bits = 0;
+    for (int half = 0; half < 2; half++) {
+        __m128i values = _mm_loadu_si128((const __m128i *)(column + start + half * 4));
+        __m128i hits = above ? _mm_cmpgt_epi32(values, value) : _mm_cmpeq_epi32(values, value);
+        bits |= (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(hits)) << (half * 4);
+    }
+    return bits;
+}
+#endif
+
+// A filter with its values already spread across vector lanes
+typedef struct {
+    Vector status;
+    Vector categories[FILTER_MAX_CODES];
+    Vector conditions[FILTER_MAX_CODES];
+    Vector donor;
+    Vector below_id;   // min_id - 1, for "greater than"
+} VectorFilter;
+
+// Finds the matching items among the 64 starting at start
+static unsigned long long filter_block(const ItemFilter *filter, const VectorFilter *v, int start) {
+    unsigned long long block = 0;
+    for (int i = 0; i < COLUMN_BLOCK; i += LANES) {
+        unsigned int bits = (1u << LANES) - 1;
+        int p = start + i;
+        if (filter->status >= 0) {
+            bits &= code_bits(statuses, p, &v->status, 1);
+        }
+        if (bits && filter->category_count > 0) {
+            bits &= code_bits(categories, p, v->categories, filter->category_count);
+        }
+        if (bits && filter->condition_count > 0) {
+            bits &= code_bits(conditions, p, v->conditions, filter->condition_count);
+        }
+        if (bits && filter->donor >= 0) {
+            bits &= int_bits(donors, p, v->donor, 0);
+        }
+        if (bits && filter->min_id > 0) {
+            bits &= int_bits(ids, p, v->below_id, 1);
+        }
+        block |= (unsigned long long)bits << i;
+    }
+    return block;
+}
+
+int item_columns_filter(const ItemFilter *filter, unsigned long long *selection) {
+    VectorFilter v;
+    v.status = splat16(filter->status);
+    for (int i = 0; i < filter->category_count; i++) {
+        v.categories[i] = splat16(filter->categories[i]);
+    }
+    for (int i = 0; i < filter->condition_count; i++) {
+        v.conditions[i] = splat16(filter->conditions[i]);
+    }
+    v.donor = splat32(filter->donor);
+    v.below_id = splat32(filter->min_id - 1);
+
+    int words = item_columns_words();
+    int matched = 0;
+    for (int w = 0; w < words; w++) {
+        unsigned long long block = filter_block(filter, &v, w * COLUMN_BLOCK);
+        if (w == words - 1 && item_count % COLUMN_BLOCK != 0) {
+            block &= (1ULL << (item_count % COLUMN_BLOCK)) - 1;
+        }
+        selection[w] = block;
+        matched += __builtin_popcountll(block);
+    }
+    return matched;
+}
+
+#else
+
+int item_columns_filter(const ItemFilter *filter, unsigned long long *selection) {
+    int words = item_columns_words();
+    int matched = 0;
+    for (int w = 0; w < words; w++) {
+        unsigned long long block = 0;
+        int end = w * COLUMN_BLOCK + COLUMN_BLOCK < item_count ? w * COLUMN_BLOCK + COLUMN_BLOCK
+                                                               : item_count;
+        for (int p = w * COLUMN_BLOCK; p < end; p++) {
+            if ((filter->status < 0 || statuses[p] == filter->status) &&
+                (filter->category_count == 0 ||
+                 has_code(filter->categories, filter->category_count, categories[p])) &&
+                (filter->condition_count == 0 ||
+                 has_code(filter->conditions, filter->condition_count, conditions[p])) &&
+                (filter->donor < 0 || donors[p] == filter->donor) &&
+                ids[p] >= filter->min_id) {
+                block |= 1ULL << (p % COLUMN_BLOCK);
+                matched++;
+            }
+        }
+        selection[w] = block;
+    }
+    return matched;
+}
+
+#endif
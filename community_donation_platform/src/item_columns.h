@@ -0,0 +1,78 @@
+// item_columns.h
+// A second layout of the item store for filtering. The store keeps whole Item records one
+// after another (rows), so checking one field of every item still reads every record.
+// Here each field the filters look at gets its own array (a column): all the IDs next to
+// each other, all the status codes, all the category codes, and so on. A filter such as
+// "available AND category Books AND condition New or Good" then reads only the small
+// columns it needs, and compares 8 or 16 items at once with SIMD instructions (SSE2 or
+// AVX2, whichever the compiler was allowed to use; plain C otherwise).
+//
+// The answer is a selection bitmap: bit i is set if the item at store position i matches.
+//
+// Keeping the columns is optional: items.c only starts them the first time a filter runs
+// (see visit_filtered_items in items.h) and then keeps them in step with the store, so a
+// program that never filters doesn't pay for them.
+
+#ifndef ITEM_COLUMNS_H
+#define ITEM_COLUMNS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "items.h"
+
+// How many different codes a filter can accept for one field
+#define FILTER_MAX_CODES 16
+
+// What to look for. Leave a field at "any" to not filter on it.
+typedef struct ItemFilter {
+    int status;              // a STATUS_* code, or -1 for any
+    int category_count;      // how many codes are in categories (0 for any category)
+    unsigned short categories[FILTER_MAX_CODES];
+    int condition_count;     // how many codes are in conditions (0 for any condition)
+    unsigned short conditions[FILTER_MAX_CODES];
+    int donor;               // a donor number from item_columns_donor, or -1 for any
+    int min_id;              // only items with this item_id or higher (0 for any)
+} ItemFilter;
+
+// Sets a filter to match every item
+void item_filter_any(ItemFilter *filter);
+
+// Starts (keep = 1) or stops (keep = 0) keeping columns, and tells whether they are kept.
+// They start out empty; the caller adds what's already in the store.
+void item_columns_keep(int keep);
+int item_columns_kept();
+
+// Keep the columns in step with the store (position is the item's place in the store).
+// item_columns_add returns 0 if we ran out of memory.
+int item_columns_add(int position, const Item *item);
+void item_columns_set_status(int position, int status);
+
+// Forgets every item (the donor numbers are kept for reuse)
+void item_columns_clear();
+
+// The number the donor column uses for a username, or -1 if no item has that donor
+int item_columns_donor(const char *username);
+
+// Fills in a filter from the words people type: a category or "any", and conditions like
+// "New/Good" or "any" (upper/lower case doesn't matter for either). Keeps the status and
+// donor as they are. Returns 0 if a category or condition named is one no item has, so
+// nothing can match.
+int item_filter_for(const char *category_text, const char *condition_text, ItemFilter *filter);
+
+// How many items the columns hold, and how many 64-bit words a selection bitmap for
+// them needs
+int item_columns_count();
+int item_columns_words();
+
+// Runs a filter over every item. selection must hold item_columns_words() words; bit i of
+// word i / 64 is set if the item at position i matches. Returns how many matched.
+int item_columns_filter(const ItemFilter *filter, unsigned long long *selection);
+
+// The same test for one Item record, for when there are no columns to run over
+int item_matches_filter(const ItemFilter *filter, const Item *item);
+
+// Which kernel item_columns_filter uses: "avx2", "sse2" or "scalar"
+const char *item_columns_kernel();
+
+#endif /* ITEM_COLUMNS_H */
@@ -1,12 +1,68 @@
 // This program is a simple donation management system using a file called "items.txt".
 // We can add items to the file, show what's available, search them by category, and update their status.
 // There are also helper functions to handle input and convert strings to lowercase.
+// The file is read once into an in-memory item store (see load_items), and every function
+// below works from that store. New items are appended to the file, and status changes are
+// appended to the status log (status_log.c) instead of rewriting the whole file.
 
 #include "items.h"
+#include "status_log.h"
+#include "id_sequence.h"
+#include "binary_table.h"
+#include "arena.h"
+#include "file_lock.h"
+#include "text_index.h"
+#include "stats.h"
+#include "durable.h"
+#include "csv.h"
+#include "data_watch.h"
+#include "wishlist.h"
+#include "item_columns.h"
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+
+// In-memory copy of items.txt. item_store holds the records in file order (in arena chunks,
+// so they never move) and id_slots is a hash table (open addressing) from item_id to a
+// position in item_store.
+static RecordArena item_store = { sizeof(Item), 0, NULL, 0, 0 };
+static int *id_slots = NULL;     // -1 means the slot is empty
+static int slot_count = 0;       // always a power of two
+static int max_item_id = 0;      // highest item_id we have seen
+static int items_loaded = 0;
+
+// How far we've read, so we can pick up rows and status changes that other programs
+// sharing the data folder have added since (see refresh_items)
+static long long items_offset = 0;  // bytes of items.txt already in the store
+static long item_log_offset = 0;    // bytes of the status log already applied
+static int item_generation = 0;     // data_generation() when the store was loaded
+static FileMark items_mark;         // items.txt as it was when we last read it
+static FileMark item_log_mark;      // the status log as it was when we last replayed it
+
+// Shorthand for the item at a store position
+static Item *stored_item(int index) {
+    return arena_at(&item_store, index);
+}
+
+// Category dictionary. Each distinct category (ignoring upper/lower case) is stored once,
+// with a posting list of the store positions of its *available* items, kept in store order.
+typedef struct {
+    char key[21];        // lowercased name, used for matching
+    char name[21];       // the spelling we show (the first one we saw)
+    int *postings;       // positions in item_store of available items in this category
+    int posting_count;
+    int posting_capacity;
+} Category;
+
+static Category *categories = NULL;
+static int category_count = 0;
+static int category_capacity = 0;
+static int *category_slots = NULL;   // hash table from key to a position in categories
+static int category_slot_count = 0;
+static int available_count = 0;      // total of every posting_count
+static int columns_failed = 0;       // the filter columns ran out of memory (see item_columns.h)
 
 // This function just clears any leftover characters in stdin
 static void clear_input_buffer() {
@@ -21,18 +77,493 @@ void to_lowercase(char *str) {
     }
 }
 
-// Lets you add a new item to the items file by asking for info from the user
-void add_item() {
-    FILE *file = fopen(ITEM_FILE_PATH, "a+");  // Changed to a+
+// Picks the starting hash slot for an item_id
+static int id_hash(int item_id) {
+    return (int)(((unsigned int)item_id * 2654435761u) & (unsigned int)(slot_count - 1));
+}
+
+// Puts a store position into the hash table (the table must have a free slot)
+static void index_item(int index) {
+    int slot = id_hash(stored_item(index)->item_id);
+    while (id_slots[slot] != -1) {
+        slot = (slot + 1) & (slot_count - 1);
+    }
+    id_slots[slot] = index;
+}
+
+// Doubles the hash table and re-inserts every item
+static int grow_id_slots() {
+    int new_count = slot_count ? slot_count * 2 : 64;
+    int *new_slots = malloc(sizeof(int) * new_count);
+    if (!new_slots) {
+        return 0;
+    }
+    free(id_slots);
+    id_slots = new_slots;
+    slot_count = new_count;
+    for (int i = 0; i < slot_count; i++) {
+        id_slots[i] = -1;
+    }
+    for (int i = 0; i < item_store.count; i++) {
+        index_item(i);
+    }
+    return 1;
+}
+
+// Picks the starting hash slot for a lowercased category name (FNV-1a)
+static int category_hash(const char *key) {
+    unsigned int h = 2166136261u;
+    for (int i = 0; key[i]; i++) {
+        h = (h ^ (unsigned char)key[i]) * 16777619u;
+    }
+    return (int)(h & (unsigned int)(category_slot_count - 1));
+}
+
+// Doubles the category hash table and re-inserts every category
+static int grow_category_slots() {
+    int new_count = category_slot_count ? category_slot_count * 2 : 32;
+    int *new_slots = malloc(sizeof(int) * new_count);
+    if (!new_slots) {
+        return 0;
+    }
+    free(category_slots);
+    category_slots = new_slots;
+    category_slot_count = new_count;
+    for (int i = 0; i < category_slot_count; i++) {
+        category_slots[i] = -1;
+    }
+    for (int i = 0; i < category_count; i++) {
+        int slot = category_hash(categories[i].key);
+        while (category_slots[slot] != -1) {
+            slot = (slot + 1) & (category_slot_count - 1);
+        }
+        category_slots[slot] = i;
+    }
+    return 1;
+}
+
+// Finds a category by name (any case). If create is set, a new empty category is added
+// when it doesn't exist yet. Returns its position in categories, or -1.
+static int find_category(const char *name, int create) {
+    char key[21];
+    strncpy(key, name, sizeof(key) - 1);
+    key[sizeof(key) - 1] = '\0';
+    to_lowercase(key);
+
+    if (category_slot_count > 0) {
+        int slot = category_hash(key);
+        while (category_slots[slot] != -1) {
+            if (strcmp(categories[category_slots[slot]].key, key) == 0) {
+                return category_slots[slot];
+            }
+            slot = (slot + 1) & (category_slot_count - 1);
+        }
+    }
+    if (!create) {
+        return -1;
+    }
+
+    if (category_count == category_capacity) {
+        int new_capacity = category_capacity ? category_capacity * 2 : 16;
+        Category *bigger = realloc(categories, sizeof(Category) * new_capacity);
+        if (!bigger) {
+            return -1;
+        }
+        categories = bigger;
+        category_capacity = new_capacity;
+    }
+    if ((category_count + 1) * 10 > category_slot_count * 7 && !grow_category_slots()) {
+        return -1;
+    }
+
+    Category *cat = &categories[category_count];
+    strcpy(cat->key, key);
+    strncpy(cat->name, name, sizeof(cat->name) - 1);
+    cat->name[sizeof(cat->name) - 1] = '\0';
+    cat->postings = NULL;
+    cat->posting_count = 0;
+    cat->posting_capacity = 0;
+
+    int slot = category_hash(key);
+    while (category_slots[slot] != -1) {
+        slot = (slot + 1) & (category_slot_count - 1);
+    }
+    category_slots[slot] = category_count;
+    return category_count++;
+}
+
+// Finds where a store position is (or would go) in a category's sorted posting list
+static int posting_search(const Category *cat, int index) {
+    int lo = 0, hi = cat->posting_count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (cat->postings[mid] < index) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Lists an available item under its category
+static void category_add(int index) {
+    int c = find_category(item_category(stored_item(index)), 1);
+    if (c < 0) {
+        return;
+    }
+    Category *cat = &categories[c];
+    if (cat->posting_count == cat->posting_capacity) {
+        int new_capacity = cat->posting_capacity ? cat->posting_capacity * 2 : 8;
+        int *bigger = realloc(cat->postings, sizeof(int) * new_capacity);
+        if (!bigger) {
+            return;
+        }
+        cat->postings = bigger;
+        cat->posting_capacity = new_capacity;
+    }
+    // New items have the largest position, so this is almost always an append
+    int at = posting_search(cat, index);
+    memmove(&cat->postings[at + 1], &cat->postings[at], sizeof(int) * (cat->posting_count - at));
+    cat->postings[at] = index;
+    cat->posting_count++;
+    available_count++;
+}
+
+// Takes an item off its category's list (when it stops being available)
+static void category_remove(int index) {
+    int c = find_category(item_category(stored_item(index)), 0);
+    if (c < 0) {
+        return;
+    }
+    Category *cat = &categories[c];
+    int at = posting_search(cat, index);
+    if (at < cat->posting_count && cat->postings[at] == index) {
+        memmove(&cat->postings[at], &cat->postings[at + 1],
+                sizeof(int) * (cat->posting_count - at - 1));
+        cat->posting_count--;
+        available_count--;
+    }
+}
+
+// Changes an item's status in the store and keeps the category lists and keyword index in step
+static void set_item_status(int index, int status) {
+    Item *item = stored_item(index);
+    int was_available = item->status == STATUS_AVAILABLE;
+    int now_available = status == STATUS_AVAILABLE;
+    if (was_available && !now_available) {
+        category_remove(index);
+        text_index_remove(index, item);
+    }
+    item->status = (unsigned short)status;
+    item_columns_set_status(index, status);
+    if (!was_available && now_available) {
+        category_add(index);
+        text_index_add(index, item);
+    }
+}
+
+// Adds one record to the store, the ID index and (if available) its category list and
+// the keyword index.
+// Returns 0 if we ran out of memory.
+static int store_item(const Item *item) {
+    // Keep the hash table at most 70% full so lookups stay short
+    if ((item_store.count + 1) * 10 > slot_count * 7 && !grow_id_slots()) {
+        return 0;
+    }
+    Item *stored = arena_add(&item_store);
+    if (!stored) {
+        return 0;
+    }
+    *stored = *item;
+    int index = item_store.count - 1;
+    index_item(index);
+    if (item_columns_kept() && !item_columns_add(index, stored)) {
+        // Out of memory: drop the columns and filter row by row from now on
+        item_columns_keep(0);
+        columns_failed = 1;
+    }
+    if (item->status == STATUS_AVAILABLE) {
+        category_add(index);
+        text_index_add(index, stored);
+    }
+    if (item->item_id > max_item_id) {
+        max_item_id = item->item_id;
+    }
+    return 1;
+}
+
+// Finds an item's position in the store by ID, or -1 if there is no such item
+static int item_index(int item_id) {
+    load_items();
+    if (slot_count == 0) {
+        return -1;
+    }
+    int slot = id_hash(item_id);
+    while (id_slots[slot] != -1) {
+        if (stored_item(id_slots[slot])->item_id == item_id) {
+            return id_slots[slot];
+        }
+        slot = (slot + 1) & (slot_count - 1);
+    }
+    return -1;
+}
+
+// Applies one status change from the status log to the store
+static void apply_logged_status(int item_id, const char *status) {
+    int index = item_index(item_id);
+    int code = dict_code(DICT_STATUS, status);
+    if (index >= 0 && code >= 0) {
+        set_item_status(index, code);
+    }
+}
+
+const char *item_category(const Item *item) {
+    return dict_text(DICT_CATEGORY, item->category);
+}
+
+const char *item_condition(const Item *item) {
+    return dict_text(DICT_CONDITION, item->condition);
+}
+
+const char *item_status(const Item *item) {
+    return dict_text(DICT_STATUS, item->status);
+}
+
+int item_from_row(const CsvReader *reader, Item *item) {
+    // Zero the whole struct first so unused bytes in the strings are always the same
+    memset(item, 0, sizeof(*item));
+    return reader->field_count == 6 &&
+           csv_int(reader, 0, &item->item_id) &&
+           csv_copy(reader, 1, item->donor_username, sizeof(item->donor_username)) &&
+           dict_field(DICT_CATEGORY, reader, 2, &item->category) &&
+           csv_copy(reader, 3, item->description, sizeof(item->description)) &&
+           dict_field(DICT_CONDITION, reader, 4, &item->condition) &&
+           dict_field(DICT_STATUS, reader, 5, &item->status);
+}
+
+int write_item_row(FILE *file, const Item *item) {
+    char id[12];
+    snprintf(id, sizeof(id), "%d", item->item_id);
+    const char *row[] = { id, item->donor_username, item_category(item), item->description,
+                          item_condition(item), item_status(item) };
+    return csv_write_row(file, row, 6);
+}
+
+// Stores every row from the current position of items.txt to the end, skipping IDs that
+// are already in the store (like the ones we appended ourselves), and remembers how far
+// we got in items_offset. On the first read the header line is skipped.
+static void read_item_rows(FILE *file) {
+    CsvReader reader;
+    if (!csv_open(&reader, file, "items.txt")) {
+        printf("Error: Not enough memory to load items.\n");
+        return;
+    }
+    long long start = reader.offset;
+    long long records = 0;
+    int header = items_offset == 0;
+    while (csv_next(&reader)) {
+        if (header) {
+            header = 0;
+            continue;
+        }
+        Item temp;
+        if (!item_from_row(&reader, &temp)) {
+            csv_skip(&reader);
+            continue;
+        }
+        records++;
+        if (item_index(temp.item_id) >= 0) {
+            continue;
+        }
+        if (!store_item(&temp)) {
+            printf("Error: Not enough memory to load items.\n");
+            break;
+        }
+    }
+    items_offset = reader.offset;
+    stats_read(items_offset - start, records);
+    csv_close(&reader);
+}
+
+// Opens items.txt at items_offset. Returns NULL if there's no file.
+static FILE *open_item_rows() {
+    FILE *file = stats_fopen(ITEM_FILE_PATH, "r");
+    if (file && items_offset > 0) {
+        fseek(file, (long)items_offset, SEEK_SET);
+    }
+    return file;
+}
+
+// Reads items.txt into the item store. Only the first call does any work.
+void load_items() {
+    if (items_loaded) {
+        return;
+    }
+    STATS_TIME(STAT_LOAD_ITEMS);
+    items_loaded = 1;
+
+    // Keep compaction from rewriting the files while we read them
+    lock_data(LOCK_STATUS_LOG, 0);
+    lock_data(LOCK_ITEMS, 0);
+    item_generation = data_generation();
+    text_index_begin_bulk();
+
+    // If there's an up-to-date binary copy (items.bin), take its records as they are
+    // and only parse the rows that were added to items.txt after it was made
+    items_offset = 0;
+    BinaryTable table;
+    if (open_binary_table(ITEM_BIN_PATH, "CDPI", sizeof(Item), &table)) {
+        if (binary_matches_csv(&table, ITEM_FILE_PATH)) {
+            for (int i = 0; i < table.header->record_count; i++) {
+                Item item;
+                binary_item_at(&table, i, &item);
+                store_item(&item);
+            }
+            stats_read((long long)table.header->record_count * (long long)sizeof(Item),
+                       table.header->record_count);
+            items_offset = table.header->source_size;
+        }
+        close_binary_table(&table);
+    }
+
+    FILE *file = open_item_rows();
+    if (file) {
+        read_item_rows(file);
+        fclose(file);
+    }
+    mark_file(ITEM_FILE_PATH, items_offset, &items_mark);
+    unlock_data(LOCK_ITEMS);
+
+    // Bring the store up to date with status changes that haven't been compacted yet
+    item_log_offset = 0;
+    replay_status_log('I', apply_logged_status, &item_log_offset);
+    mark_file(STATUS_LOG_PATH, item_log_offset, &item_log_mark);
+    text_index_end_bulk();
+    unlock_data(LOCK_STATUS_LOG);
+}
+
+// Size of a file in bytes, or -1 if it doesn't exist
+static long long file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (long long)st.st_size : -1;
+}
+
+// Empties the store so it can be loaded again from scratch
+static void reset_items() {
+    arena_clear(&item_store);
+    for (int i = 0; i < slot_count; i++) {
+        id_slots[i] = -1;
+    }
+    for (int i = 0; i < category_count; i++) {
+        categories[i].posting_count = 0;
+    }
+    text_index_clear();
+    item_columns_clear();
+    available_count = 0;
+    items_loaded = 0;
+}
+
+int refresh_items() {
+    if (!items_loaded) {
+        load_items();
+        return 1;
+    }
+    STATS_TIME(STAT_REFRESH_ITEMS);
+    lock_data(LOCK_STATUS_LOG, 0);
+    // Compaction (or someone editing the files by hand) may have rewritten them since we
+    // loaded them. Then the rows we've seen may have moved, so start over.
+    int rewritten = data_generation() != item_generation ||
+                    file_rewritten(ITEM_FILE_PATH, &items_mark) ||
+                    file_rewritten(STATUS_LOG_PATH, &item_log_mark);
+    if (rewritten) {
+        reset_items();
+        load_items();
+    } else {
+        // Otherwise rows can only have been added, so just read the new ones
+        if (file_size(ITEM_FILE_PATH) > items_offset) {
+            lock_data(LOCK_ITEMS, 0);
+            FILE *file = open_item_rows();
+            if (file) {
+                read_item_rows(file);
+                fclose(file);
+            }
+            mark_file(ITEM_FILE_PATH, items_offset, &items_mark);
+            unlock_data(LOCK_ITEMS);
+        }
+        long applied = item_log_offset;
+        replay_status_log('I', apply_logged_status, &item_log_offset);
+        if (item_log_offset != applied) {
+            mark_file(STATUS_LOG_PATH, item_log_offset, &item_log_mark);
+        }
+    }
+    unlock_data(LOCK_STATUS_LOG);
+    return rewritten;
+}
+
+// Looks up an item by ID in the store. Returns NULL if there is no such item.
+Item *find_item(int item_id) {
+    STATS_TIME(STAT_FIND_ITEM);
+    int index = item_index(item_id);
+    return index >= 0 ? stored_item(index) : NULL;
+}
+
+// How many items are in the store
+int item_total() {
+    load_items();
+    return item_store.count;
+}
+
+// How many items are currently available
+int count_available_items() {
+    load_items();
+    STATS_TIME(STAT_COUNT_AVAILABLE_ITEMS);
+    return available_count;
+}
+
+// Gives back the item at a position in the store (0 .. item_total() - 1)
+Item *item_at(int index) {
+    if (index < 0 || index >= item_store.count) {
+        return NULL;
+    }
+    return stored_item(index);
+}
+
+// dict_code for text cut to fit a 20-character field
+static int field_code(int dict, const char *text) {
+    char field[DICT_TEXT_SIZE];
+    strncpy(field, text, sizeof(field) - 1);
+    field[sizeof(field) - 1] = '\0';
+    return dict_code(dict, field);
+}
+
+// Adds an item without asking any questions: appends it to items.txt and the store.
+// Returns the new item_id, or 0 if it couldn't be saved.
+int create_item(const char *donor_username, const char *category,
+                const char *description, const char *condition) {
+    load_items();
+    STATS_TIME(STAT_CREATE_ITEM);
+    int category_code = field_code(DICT_CATEGORY, category);
+    int condition_code = field_code(DICT_CONDITION, condition);
+    if (category_code < 0 || condition_code < 0) {
+        printf("Error: Too many different categories or conditions.\n");
+        return 0;
+    }
+
+    // Hold the items lock while appending, so compaction can't swap the file out from
+    // under us and two programs can't both write the header into an empty file
+    lock_data(LOCK_ITEMS, 1);
+    FILE *file = stats_fopen(ITEM_FILE_PATH, "a+");  // Changed to a+
     if (!file) {
         printf("Error: Unable to open items.txt for writing.\n");
-        return;
+        unlock_data(LOCK_ITEMS);
+        return 0;
     }
 
     // If the file is empty, write a header first
     fseek(file, 0, SEEK_END);
     long fileSize = ftell(file);
-    
+
     if (fileSize == 0) {
         fprintf(file, "item_id,donor_username,category,description,condition,status\n");
     } else if (fileSize > 0) {
@@ -46,288 +577,366 @@ void add_item() {
     }
 
     Item newItem;
+    memset(&newItem, 0, sizeof(newItem));
+    strncpy(newItem.donor_username, donor_username, sizeof(newItem.donor_username) - 1);
+    newItem.category = (unsigned short)category_code;
+    strncpy(newItem.description, description, sizeof(newItem.description) - 1);
+    newItem.condition = (unsigned short)condition_code;
+
+    // By default, new items are available
+    newItem.status = STATUS_AVAILABLE;
+
+    // Take the next ID from the sequence file (no need to re-read items.txt)
+    newItem.item_id = next_id(ITEM_SEQ_PATH, max_item_id);
+
+    // Write the new item record to the file, then to the store
+    int written = write_item_row(file, &newItem);
+    stats_written(written > 0 ? written : 0);
+    int closed = close_durably(file);
+    unlock_data(LOCK_ITEMS);
+    if (!closed) {
+        printf("Error: Unable to write to items.txt.\n");
+        return 0;
+    }
+
+    if (!store_item(&newItem)) {
+        printf("Error: Not enough memory to keep the new item loaded.\n");
+    }
+
+    // Let recipients whose wishlists fit it know
+    notify_wishlists(&newItem);
+    return newItem.item_id;
+}
+
+// Lets you add a new item to the items file by asking for info from the user
+void add_item() {
+    STATS_TIME(STAT_ADD_ITEM);
+    char donor_username[21], category[21], description[MAX_DESC], condition[21];
 
     // Ask for username
     printf("Enter your username: ");
-    if (scanf("%20s", newItem.donor_username) != 1) {
+    if (scanf("%20s", donor_username) != 1) {
         printf("Invalid input for username.\n");
         clear_input_buffer();
-        fclose(file);
         return;
     }
     clear_input_buffer();
 
     // Ask for category (we use fgets to include spaces)
     printf("Enter category (e.g., Clothes, Furniture, Electronics, Books, etc.): ");
-    if (fgets(newItem.category, sizeof(newItem.category), stdin) == NULL) {
+    if (fgets(category, sizeof(category), stdin) == NULL) {
         printf("Error reading category.\n");
-        fclose(file);
         return;
     }
-    newItem.category[strcspn(newItem.category, "\n")] = '\0';
+    category[strcspn(category, "\n")] = '\0';
 
     // Ask for the description
     printf("Enter description: ");
-    if (fgets(newItem.description, MAX_DESC, stdin) == NULL) {
+    if (fgets(description, MAX_DESC, stdin) == NULL) {
         printf("Error reading description.\n");
-        fclose(file);
         return;
     }
-    newItem.description[strcspn(newItem.description, "\n")] = '\0';
+    description[strcspn(description, "\n")] = '\0';
 
     // Ask for the condition of the item
     printf("Enter condition (New/Good/Fair): ");
-    if (scanf("%20s", newItem.condition) != 1) {
+    if (scanf("%20s", condition) != 1) {
         printf("Invalid input for condition.\n");
         clear_input_buffer();
-        fclose(file);
         return;
     }
     clear_input_buffer();
 
-    // By default, new items are available
-    strcpy(newItem.status, "available");
-
-    // Figure out the next item_id by reading everything and finding the highest existing
-    int last_id = 0;
-    FILE *readFile = fopen(ITEM_FILE_PATH, "r");
-    if (readFile) {
-        char header[200];
-        fgets(header, sizeof(header), readFile); // skip the header
-        Item temp;
-        while (fscanf(readFile, "%d,%20[^,],%20[^,],%99[^,],%20[^,],%20[^\n]\n",
-                      &temp.item_id, temp.donor_username, temp.category, temp.description,
-                      temp.condition, temp.status) != EOF) {
-            if (temp.item_id > last_id) {
-                last_id = temp.item_id;
-            }
-        }
-        fclose(readFile);
+    if (create_item(donor_username, category, description, condition)) {
+        printf("Item successfully added!\n");
     }
-    newItem.item_id = last_id + 1;
-
-    // Write the new item record to the file
-    fprintf(file, "%d,%s,%s,%s,%s,%s\n",
-            newItem.item_id, newItem.donor_username, newItem.category,
-            newItem.description, newItem.condition, newItem.status);
-    fclose(file);
+}
 
-    printf("Item successfully added!\n");
+// Prints one item as a table row (an ItemVisitor for display_items and show_keyword_search)
+static void print_search_row(const Item *temp, void *context) {
+    (void)context;
+    printf("%-3d| %-12s| %-12s| %-36s| %-10s| %-10s\n",
+           temp->item_id, temp->donor_username, item_category(temp), temp->description,
+           item_condition(temp), item_status(temp));
 }
 
 // Displays all items that are currently available
 void display_items() {
-    FILE *file = fopen(ITEM_FILE_PATH, "r");
-    if (!file) {
-        printf("No items available.\n");
-        return;
-    }
-
-    // Skip the header line
-    char header[200];
-    if (!fgets(header, sizeof(header), file)) {
-        // If the file is empty or unreadable
-        fclose(file);
+    load_items();
+    STATS_TIME(STAT_DISPLAY_ITEMS);
+    if (item_store.count == 0) {
         printf("No items available.\n");
         return;
     }
 
-    Item temp;
-    int found = 0;
     printf("\nAvailable Items:\n");
     printf("--------------------------------------------------------------------------------\n");
     printf("ID | Donor        | Category     | Description                           | Condition | Status\n");
     printf("--------------------------------------------------------------------------------\n");
 
     // Print only items with status = "available"
-    while (fscanf(file, "%d,%20[^,],%20[^,],%99[^,],%20[^,],%20[^\n]\n",
-                  &temp.item_id, temp.donor_username, temp.category, temp.description,
-                  temp.condition, temp.status) != EOF) {
-        if (strcmp(temp.status, "available") == 0) {
-            printf("%-3d| %-12s| %-12s| %-36s| %-10s| %-10s\n",
-                   temp.item_id, temp.donor_username, temp.category, temp.description,
-                   temp.condition, temp.status);
-            found = 1;
+    ItemFilter available;
+    item_filter_any(&available);
+    available.status = STATUS_AVAILABLE;
+    if (visit_filtered_items(&available, print_search_row, NULL) == 0) {
+        printf("No items available.\n");
+    }
+}
+
+// Calls visit(item, context) for every available item (or only those in one category,
+// taken straight from its posting list). Returns how many items were visited.
+int visit_available_items(const char *category, ItemVisitor visit, void *context) {
+    load_items();
+    STATS_TIME(STAT_VISIT_AVAILABLE_ITEMS);
+    int visited = 0;
+    if (category) {
+        int c = find_category(category, 0);
+        if (c < 0) {
+            return 0;
         }
+        for (int i = 0; i < categories[c].posting_count; i++) {
+            visit(stored_item(categories[c].postings[i]), context);
+            visited++;
+        }
+        return visited;
     }
-    fclose(file);
-    if (!found) {
-        printf("No items available.\n");
+    ItemFilter available;
+    item_filter_any(&available);
+    available.status = STATUS_AVAILABLE;
+    return visit_filtered_items(&available, visit, context);
+}
+
+int use_item_columns() {
+    load_items();
+    if (item_columns_kept()) {
+        return 1;
+    }
+    if (columns_failed) {
+        return 0;
     }
+    item_columns_keep(1);
+    for (int i = 0; i < item_store.count; i++) {
+        if (!item_columns_add(i, stored_item(i))) {
+            item_columns_keep(0);
+            columns_failed = 1;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Calls visit(item, context) for every item a filter matches, in store order. The columns
+// give a bitmap of the matches, so only matching records are ever touched.
+int visit_filtered_items(const ItemFilter *filter, ItemVisitor visit, void *context) {
+    load_items();
+    STATS_TIME(STAT_VISIT_FILTERED_ITEMS);
+    int visited = 0;
+    unsigned long long *selection = NULL;
+    if (use_item_columns()) {
+        selection = malloc(sizeof(unsigned long long) * (item_columns_words() + 1));
+    }
+    if (!selection) {
+        // No columns (we ran out of memory), so test the records one by one
+        for (int i = 0; i < item_store.count; i++) {
+            if (item_matches_filter(filter, stored_item(i))) {
+                visit(stored_item(i), context);
+                visited++;
+            }
+        }
+        return visited;
+    }
+
+    item_columns_filter(filter, selection);
+    for (int w = 0; w < item_columns_words(); w++) {
+        // Bit b of word w stands for store position w * 64 + b; take them lowest first
+        unsigned long long bits = selection[w];
+        while (bits) {
+            visit(stored_item(w * 64 + __builtin_ctzll(bits)), context);
+            visited++;
+            bits &= bits - 1;
+        }
+    }
+    free(selection);
+    return visited;
 }
 
 // Shows a list of distinct categories for the user to choose from, then returns it
 int get_category_selection(char selected_category[]) {
-    FILE *file = fopen(ITEM_FILE_PATH, "r");
-    if (!file) {
+    load_items();
+    STATS_TIME(STAT_GET_CATEGORY_SELECTION);
+    if (item_store.count == 0) {
         printf("No items available.\n");
         return 0;
     }
 
-    // Skip the header
-    char header[200];
-    if (!fgets(header, sizeof(header), file)) {
-        fclose(file);
-        printf("No items available.\n");
+    // Only categories that still have available items are offered. choices maps the
+    // number we print to a position in the category dictionary.
+    int *choices = malloc(sizeof(int) * (category_count + 1));
+    if (!choices) {
+        printf("Error: Not enough memory.\n");
         return 0;
     }
-
-    char categories[MAX_ITEMS][21];
     int count = 0;
-    Item temp;
-
-    // Collect unique categories from available items
-    while (fscanf(file, "%d,%20[^,],%20[^,],%99[^,],%20[^,],%20[^\n]\n",
-                  &temp.item_id, temp.donor_username, temp.category,
-                  temp.description, temp.condition, temp.status) != EOF) {
-        if (strcmp(temp.status, "available") == 0) {
-            int exists = 0;
-            char lowerCat[21];
-            strcpy(lowerCat, temp.category);
-            to_lowercase(lowerCat);
-
-            // Check if it's already in the list
-            for (int i = 0; i < count; i++) {
-                char lowerStored[21];
-                strcpy(lowerStored, categories[i]);
-                to_lowercase(lowerStored);
-                if (strcmp(lowerStored, lowerCat) == 0) {
-                    exists = 1;
-                    break;
-                }
-            }
-            if (!exists && count < MAX_ITEMS) {
-                strcpy(categories[count], temp.category);
-                count++;
-            }
+    for (int i = 0; i < category_count; i++) {
+        if (categories[i].posting_count > 0) {
+            choices[count++] = i;
         }
     }
-    fclose(file);
-    
+
     if (count == 0) {
         printf("No available categories found.\n");
+        free(choices);
         return 0;
     }
     
     // Print out the categories and let user pick
     printf("\nAvailable Categories:\n");
     for (int i = 0; i < count; i++) {
-        printf("  %d. %s\n", i + 1, categories[i]);
+        printf("  %d. %s\n", i + 1, categories[choices[i]].name);
     }
     printf("Enter the number corresponding to the desired category: ");
     int selection;
     if (scanf("%d", &selection) != 1) {
         printf("Invalid input.\n");
         clear_input_buffer();
+        free(choices);
         return 0;
     }
     clear_input_buffer();
     if (selection < 1 || selection > count) {
         printf("Invalid selection.\n");
+        free(choices);
         return 0;
     }
 
     // Copy chosen category
-    strcpy(selected_category, categories[selection - 1]);
+    strcpy(selected_category, categories[choices[selection - 1]].name);
+    free(choices);
     return 1;
 }
 
-// Lets the user look for items in a certain category (case-insensitive)
+// Lets the user look for items by category (case-insensitive) or by keywords
 void search_items() {
-    char search_category[21];
-    if (!get_category_selection(search_category)) {
+    STATS_TIME(STAT_SEARCH_ITEMS);
+    printf("\nSearch by:\n");
+    printf("  1. Category\n");
+    printf("  2. Keywords\n");
+    printf("Enter your choice: ");
+    int choice;
+    if (scanf("%d", &choice) != 1) {
+        printf("Invalid input.\n");
+        clear_input_buffer();
         return;
     }
-    to_lowercase(search_category);
+    clear_input_buffer();
 
-    FILE *file = fopen(ITEM_FILE_PATH, "r");
-    if (!file) {
-        printf("No items available.\n");
-        return;
+    if (choice == 1) {
+        char search_category[21];
+        if (!get_category_selection(search_category)) {
+            return;
+        }
+        show_category(search_category);
+    } else if (choice == 2) {
+        char query[200];
+        printf("Enter keywords (OR for either word, word* for words starting with it): ");
+        if (!fgets(query, sizeof(query), stdin)) {
+            return;
+        }
+        query[strcspn(query, "\n")] = '\0';
+        show_keyword_search(query);
+    } else {
+        printf("Invalid selection.\n");
     }
+}
 
-    // Skip the header
-    char header[200];
-    if (!fgets(header, sizeof(header), file)) {
-        fclose(file);
-        printf("No items available.\n");
-        return;
+// Calls visit(item, context) for the best matches of a keyword query, best first
+int visit_keyword_matches(const char *query, int limit, ItemVisitor visit, void *context) {
+    load_items();
+    STATS_TIME(STAT_VISIT_KEYWORD_MATCHES);
+    if (limit <= 0) {
+        return 0;
     }
+    int *positions = malloc(sizeof(int) * limit);
+    if (!positions) {
+        return 0;
+    }
+    int total = 0;
+    int shown = text_index_search(query, positions, limit, &total);
+    for (int i = 0; i < shown; i++) {
+        visit(stored_item(positions[i]), context);
+    }
+    free(positions);
+    return total;
+}
 
-    Item temp;
-    int found = 0;
-
+// Prints the best available items for a keyword query, no questions asked
+void show_keyword_search(const char *query) {
+    STATS_TIME(STAT_SHOW_KEYWORD_SEARCH);
     printf("\nSearch Results:\n");
     printf("--------------------------------------------------------------------------------\n");
     printf("ID | Donor        | Category     | Description                           | Condition | Status\n");
     printf("--------------------------------------------------------------------------------\n");
 
-    while (fscanf(file, "%d,%20[^,],%20[^,],%99[^,],%20[^,],%20[^\n]\n",
-                  &temp.item_id, temp.donor_username, temp.category, temp.description,
-                  temp.condition, temp.status) != EOF) {
-        char lowerCat[21];
-        strcpy(lowerCat, temp.category);
-        to_lowercase(lowerCat);
-
-        // Must match category and be available
-        if (strcmp(lowerCat, search_category) == 0 && strcmp(temp.status, "available") == 0) {
-            printf("%-3d| %-12s| %-12s| %-36s| %-10s| %-10s\n",
-                   temp.item_id, temp.donor_username, temp.category, temp.description,
-                   temp.condition, temp.status);
-            found = 1;
-        }
-    }
-    fclose(file);
-    if (!found) {
-        printf("No items found in this category.\n");
+    int total = visit_keyword_matches(query, SEARCH_RESULT_LIMIT, print_search_row, NULL);
+    if (total == 0) {
+        printf("No items match those keywords.\n");
+    } else if (total > SEARCH_RESULT_LIMIT) {
+        printf("Showing the best %d of %d matching items.\n", SEARCH_RESULT_LIMIT, total);
     }
 }
 
-// Changes an item's status if we find the matching item_id
-void update_status(int item_id, char *new_status) {
-    FILE *file = fopen(ITEM_FILE_PATH, "r");
-    if (!file) {
-        printf("Error: Unable to open items.txt for reading.\n");
-        return;
-    }
+// Prints the available items in one category (case-insensitive), no questions asked
+void show_category(const char *category) {
+    load_items();
+    STATS_TIME(STAT_SHOW_CATEGORY);
 
-    // Skip the header
-    char header[200];
-    if (!fgets(header, sizeof(header), file)) {
-        fclose(file);
-        printf("Error: items file is empty or corrupted.\n");
-        return;
-    }
+    printf("\nSearch Results:\n");
+    printf("--------------------------------------------------------------------------------\n");
+    printf("ID | Donor        | Category     | Description                           | Condition | Status\n");
+    printf("--------------------------------------------------------------------------------\n");
 
-    // Create a temp file to rewrite data
-    FILE *tempFile = fopen("../data/temp_items.txt", "w");
-    if (!tempFile) {
-        printf("Error: Unable to create temporary file.\n");
-        fclose(file);
+    // The category's posting list holds exactly its available items
+    int c = find_category(category, 0);
+    if (c < 0 || categories[c].posting_count == 0) {
+        printf("No items found in this category.\n");
         return;
     }
+    for (int i = 0; i < categories[c].posting_count; i++) {
+        Item *temp = stored_item(categories[c].postings[i]);
+        printf("%-3d| %-12s| %-12s| %-36s| %-10s| %-10s\n",
+               temp->item_id, temp->donor_username, item_category(temp), temp->description,
+               item_condition(temp), item_status(temp));
+    }
+}
 
-    // Write header to the temp file
-    fprintf(tempFile, "item_id,donor_username,category,description,condition,status\n");
+// Changes an item's status if we find the matching item_id
+int update_status(int item_id, char *new_status) {
+    STATS_TIME(STAT_UPDATE_STATUS);
+    // Catch up with other programs first, and keep them out until the change is logged
+    lock_data(LOCK_STATUS_LOG, 1);
+    refresh_items();
+    int index = item_index(item_id);
+    if (index < 0) {
+        printf("Error: Item %d not found.\n", item_id);
+        unlock_data(LOCK_STATUS_LOG);
+        return 0;
+    }
 
-    Item temp;
-    // Go through the items and update status for matching ID
-    while (fscanf(file, "%d,%20[^,],%20[^,],%99[^,],%20[^,],%20[^\n]\n",
-                  &temp.item_id, temp.donor_username, temp.category,
-                  temp.description, temp.condition, temp.status) != EOF) {
-        if (temp.item_id == item_id) {
-            strcpy(temp.status, new_status);
-        }
-        fprintf(tempFile, "%d,%s,%s,%s,%s,%s\n",
-                temp.item_id, temp.donor_username, temp.category,
-                temp.description, temp.condition, temp.status);
+    int status = field_code(DICT_STATUS, new_status);
+    if (status < 0) {
+        printf("Error: Too many different statuses.\n");
+        unlock_data(LOCK_STATUS_LOG);
+        return 0;
     }
-    fclose(file);
-    fclose(tempFile);
 
-    // Replace the old file with the new one
-    remove(ITEM_FILE_PATH);
-    if (rename("../data/temp_items.txt", ITEM_FILE_PATH) != 0) {
-        printf("Error: Unable to update items file.\n");
+    // Append the change to the status log first. Any changes the caller already queued
+    // (like a request being approved) go out in the same commit. Only once it is written
+    // do we pick it up into the store, the same way we pick up other programs' changes.
+    log_item_status(item_id, dict_text(DICT_STATUS, status));
+    int ok = commit_status_log();  // prints an error if it fails
+    if (ok) {
+        refresh_items();
     }
+    unlock_data(LOCK_STATUS_LOG);
+    return ok;
 }
@@ -8,42 +8,111 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "csv.h"  // For reading rows of items.txt
+#include "dictionary.h"  // For the codes in category, condition and status
 
-// We can store up to 100 items and have descriptions up to 100 characters
-#define MAX_ITEMS 100
+// Descriptions can be up to 100 characters (there is no limit on how many items we store)
 #define MAX_DESC 100
 
 // This is where our items get saved and read
 #define ITEM_FILE_PATH "../data/items.txt"
 
-// Structure for donation items
+// Structure for donation items. Category, condition and status are codes from the
+// dictionaries in dictionary.h; item_category() and friends give back their text.
 typedef struct {
     int item_id;               // Unique ID for the item
     char donor_username[21];   // Username of the donor
-    char category[21];         // Item category like "Books", "Electronics", etc.
     char description[MAX_DESC]; // A short text describing the item
-    char condition[21];        // Like "New", "Good", "Fair"
-    char status[21];           // "available", "donated", etc.
+    unsigned short category;   // Item category like "Books", "Electronics", etc.
+    unsigned short condition;  // Like "New", "Good", "Fair"
+    unsigned short status;     // STATUS_AVAILABLE, STATUS_DONATED, etc.
 } Item;
 
+// A function that gets called once per item, used by visit_available_items
+typedef void (*ItemVisitor)(const Item *item, void *context);
+
 // Below are the functions we use in our program:
 
+// Reads items.txt into memory once (later calls do nothing). Every item function
+// works from this in-memory store instead of re-reading the file.
+void load_items();
+
+// Catches up with items and status changes that other programs sharing the data folder
+// have written since we loaded. If rows were only added, just those are read; if the
+// files were compacted or otherwise rewritten, everything is loaded again.
+// Functions that change data call this first, so they check against the latest state.
+// A reload moves records, so don't keep Item pointers across a call to this.
+// Returns 1 if everything was loaded again, 0 otherwise.
+int refresh_items();
+
+// Turns the current record of a CsvReader (see csv.h) reading items.txt into an Item.
+// Returns 1 on success, 0 if the row doesn't have 6 fields or a field doesn't fit.
+int item_from_row(const CsvReader *reader, Item *item);
+
+// Writes an Item as one items.txt row. Returns the bytes written, or -1 on error.
+int write_item_row(FILE *file, const Item *item);
+
+// The text of an item's category, condition and status
+const char *item_category(const Item *item);
+const char *item_condition(const Item *item);
+const char *item_status(const Item *item);
+
+// Finds an item by its ID in the store, or returns NULL if it doesn't exist
+Item *find_item(int item_id);
+
+// How many items are in the store, and the item at a given position (0 .. total - 1)
+int item_total();
+Item *item_at(int index);
+
+// How many items have the status "available"
+int count_available_items();
+
 // Lets user add a new item (asks for info, then saves it to items file)
 void add_item();
 
+// Saves a new available item without asking anything. Returns its item_id, or 0 on error.
+int create_item(const char *donor_username, const char *category,
+                const char *description, const char *condition);
+
 // Shows all items that are marked as "available"
 void display_items();
 
-// Lets user pick a category and shows items matching that category
+// Lets user search by category (picked from a list) or by keywords
 void search_items();
 
+// Shows the available items in one category (any upper/lower case), without asking anything
+void show_category(const char *category);
+
+// Shows the best-matching available items for a keyword query (see text_index.h for the
+// query syntax), without asking anything
+void show_keyword_search(const char *query);
+
+// Calls visit(item, context) for up to limit available items matching a keyword query,
+// best match first. Returns how many items match in all (can be more than limit).
+int visit_keyword_matches(const char *query, int limit, ItemVisitor visit, void *context);
+
+// Calls visit(item, context) for each available item; pass a category to only visit that
+// category (any upper/lower case), or NULL for all of them. Returns how many were visited.
+int visit_available_items(const char *category, ItemVisitor visit, void *context);
+
+// Calls visit(item, context) for each item matching a filter (see item_columns.h), in store
+// order. Returns how many were visited. The first call starts the filter columns.
+struct ItemFilter;
+int visit_filtered_items(const struct ItemFilter *filter, ItemVisitor visit, void *context);
+
+// Starts the filter columns now rather than at the first filter. Server mode calls this at
+// startup, because starting them changes the store and the server runs filters side by side.
+// Returns 0 if we ran out of memory.
+int use_item_columns();
+
 // Asks user to pick from a list of categories (returns selected one)
 int get_category_selection(char selected_category[]);
 
 // Makes a string lowercase for case-insensitive matching
 void to_lowercase(char *str);
 
-// Changes the status of an item (like from "available" to "donated")
-void update_status(int item_id, char *new_status);
+// Changes the status of an item (like from "available" to "donated").
+// Returns 1 once the change is saved, 0 (after printing an error) if it wasn't.
+int update_status(int item_id, char *new_status);
 
 #endif /* ITEMS_H */
@@ -1,7 +1,8 @@
 // main.c
 // This program starts our Community Donation Platform. We let people log in as a donor or recipient.
 // Donors can add items, see requests, and approve or reject them. Recipients can look at what's available, 
-// search by category, request items, and see what they've gotten.
+// search by category, request items, and see what they've gotten. They can also keep wishlists and get
+// notified when a new item fits one.
 
 #include <stdio.h>      // Standard I/O functions
 #include <stdlib.h>     // Standard library functions
@@ -9,6 +10,13 @@
 #include "user.h"       // User authentication stuff
 #include "items.h"      // Functions for item management
 #include "requests.h"   // Functions for handling requests
+#include "wishlist.h"   // Wishlists and their notifications
+#include "binary_table.h" // Converting between the CSV and binary data files
+#include "id_index.h"   // On-disk indexes by ID
+#include "batch.h"      // Non-interactive batch command mode
+#include "server.h"     // Multi-client server mode
+#include "stats.h"      // Built-in call counters (dumped on SIGUSR1)
+#include "data_watch.h" // Noticing what other programs changed in the data folder
 
 // Clears leftover input so that stray characters won't mess up the next input
 static void clear_input_buffer() {
@@ -16,20 +24,110 @@ static void clear_input_buffer() {
     while ((ch = getchar()) != '\n' && ch != EOF);
 }
 
-int main() {
+// Things the menus show that are worked out from the data, kept for the logged-in user
+// so redrawing a menu after an action that changed nothing doesn't work them out again
+typedef struct {
+    int valid;               // 0 until the first count (and again after each login)
+    unsigned long version;   // requests_version() when pending_count was counted
+    int pending_count;       // the donor's inbox badge
+    unsigned long wishlist_version;  // wishlist_version() when new_count was counted
+    int new_count;           // the recipient's new notifications badge
+} MenuCache;
+
+// The donor's inbox badge, counted again only if the requests changed since last time
+static int inbox_badge(MenuCache *cache, char *donor_username) {
+    if (!cache->valid || cache->version != requests_version()) {
+        cache->pending_count = count_pending_requests(donor_username);
+        cache->version = requests_version();
+        cache->valid = 1;
+    }
+    return cache->pending_count;
+}
+
+// The recipient's notifications badge, counted again only if notifications changed
+static int notification_badge(MenuCache *cache, char *recipient_username) {
+    if (!cache->valid || cache->wishlist_version != wishlist_version()) {
+        cache->new_count = count_new_notifications(recipient_username);
+        cache->wishlist_version = wishlist_version();
+        cache->valid = 1;
+    }
+    return cache->new_count;
+}
+
+int main(int argc, char *argv[]) {
     int choice;
+
+    // "--to-binary" and "--to-csv" convert the data files and exit without starting the menus
+    if (argc > 1 && strcmp(argv[1], "--to-binary") == 0) {
+        int ok = convert_items_to_binary() && convert_requests_to_binary();
+        printf(ok ? "Wrote items.bin and requests.bin.\n" : "Conversion failed.\n");
+        return ok ? 0 : 1;
+    }
+    if (argc > 1 && strcmp(argv[1], "--to-csv") == 0) {
+        int ok = convert_items_to_csv() && convert_requests_to_csv();
+        printf(ok ? "Wrote items.txt and requests.txt from the binary files.\n" : "Conversion failed.\n");
+        return ok ? 0 : 1;
+    }
+    // "--to-index" builds items.idx and requests.idx for lookups by ID (see id_index.h)
+    if (argc > 1 && strcmp(argv[1], "--to-index") == 0) {
+        int ok = build_item_index() && build_request_index();
+        printf(ok ? "Wrote items.idx and requests.idx.\n" : "Building the indexes failed.\n");
+        return ok ? 0 : 1;
+    }
+
+    // "--serve <port or socket path> [--workers N]" serves many clients at once
+    if (argc > 2 && strcmp(argv[1], "--serve") == 0) {
+        int workers = DEFAULT_WORKERS;
+        if (argc > 4 && strcmp(argv[3], "--workers") == 0) {
+            workers = atoi(argv[4]);
+        }
+        return run_server(argv[2], workers);
+    }
+
+    // From here on "kill -USR1 <pid>" prints the call counters to stderr, even while we
+    // sit waiting for input
+    stats_start_signal_thread();
+
+    // "--batch [file]" runs commands from a file (or standard input) instead of the menus,
+    // and "--lookup [file]" runs only lookups, without loading the data files
+    int lookups_only = argc > 1 && strcmp(argv[1], "--lookup") == 0;
+    if (argc > 1 && (strcmp(argv[1], "--batch") == 0 || lookups_only)) {
+        FILE *input = stdin;
+        if (argc > 2 && strcmp(argv[2], "-") != 0) {
+            input = fopen(argv[2], "r");
+            if (!input) {
+                printf("Error: Unable to open %s.\n", argv[2]);
+                return 1;
+            }
+        }
+        int failed = lookups_only ? run_lookups(input, stdout) : run_batch(input, stdout);
+        if (input != stdin) {
+            fclose(input);
+        }
+        return failed ? 1 : 0;
+    }
     char logged_in_user[50];  // stores the username of the current user
     char logged_in_role[10];  // "donor" or "recipient"
 
     // Greet the user
     printf("Welcome to the Community Donation Platform\n");
 
+    // Read the accounts, item catalog, requests and wishlists into memory once, up front
+    load_users();
+    load_items();
+    load_requests();
+    load_wishlists();
+
     // Run until user chooses to exit
     while (1) {
         int logged_in = 0;
 
         // Keep trying to log in or sign up until success
         while (!logged_in) {
+            stats_poll();
+            if (data_watch_changed()) {
+                refresh_data();  // pick up what other programs wrote while we waited
+            }
             printf("\n===== Login Menu =====\n");
             printf("1. Login\n");
             printf("2. Signup\n");
@@ -52,8 +150,8 @@ int main() {
                     break;
                 case 2:
                     // Sign up a new user
-                    signup();
-                    printf("\nSignup successful! Please log in.\n");
+                    if (signup())
+                        printf("\nSignup successful! Please log in.\n");
                     break;
                 case 3:
                     // Quit the program
@@ -66,10 +164,17 @@ int main() {
 
         // If we get here, user is logged in
         int logout = 0;
+        MenuCache cache;
+        memset(&cache, 0, sizeof(cache));
         while (!logout) {
+            stats_poll();
+            if (data_watch_changed()) {
+                refresh_data();
+            }
+
             // Show donor menu
             if (strcmp(logged_in_role, "donor") == 0) {
-                int pending_count = count_pending_requests(logged_in_user);
+                int pending_count = inbox_badge(&cache, logged_in_user);
 
                 printf("\n===== Main Menu =====\n");
                 printf("1. View Available Items\n");
@@ -113,12 +218,16 @@ int main() {
             }
             // Show recipient menu
             else if (strcmp(logged_in_role, "recipient") == 0) {
+                int new_count = notification_badge(&cache, logged_in_user);
+
                 printf("\n===== Main Menu =====\n");
                 printf("1. View Available Items\n");
                 printf("2. Search for an Item\n");
                 printf("3. Request an Item\n");
                 printf("4. View Inventory\n");
-                printf("5. Logout\n");
+                printf("5. My Wishlists\n");
+                printf("6. New Matches (%d)\n", new_count);
+                printf("7. Logout\n");
                 printf("Enter your choice: ");
 
                 if (scanf("%d", &choice) != 1) {
@@ -142,6 +251,12 @@ int main() {
                         view_inventory(logged_in_user);
                         break;
                     case 5:
+                        manage_wishlists(logged_in_user);
+                        break;
+                    case 6:
+                        view_notifications(logged_in_user);
+                        break;
+                    case 7:
                         printf("Logging out...\n");
                         logout = 1;
                         break;
@@ -1,15 +1,94 @@
 // This file handles item requests in our donation system. Recipients can request items, 
 // and donors can approve or reject those requests. We also have helper 
 // functions to view pending requests, count them, and look at a recipient's approved items.
+// Like the item store, requests.txt is read once into memory (see load_requests). We also
+// keep a per-donor list of pending requests so the inbox and its badge never touch the files,
+// and a per-recipient list of approved requests for the inventory.
+// Decisions are appended to the status log (status_log.c) rather than rewriting requests.txt.
 
 #include "requests.h"   // For request functions and Request structure
 #include "items.h"      // For Item structure and update_status function
+#include "status_log.h" // For recording status changes
+#include "id_sequence.h" // For new request IDs
+#include "binary_table.h" // For loading from requests.bin
+#include "arena.h"      // For the chunked request table
+#include "file_lock.h"  // For sharing the data folder with other programs
+#include "stats.h"      // For counting calls, time and file activity
+#include "durable.h"    // For writes that survive a crash
+#include "csv.h"        // For reading and writing requests.txt rows
+#include "data_watch.h" // For noticing when requests.txt was rewritten
 #include <ctype.h>      // For tolower()
 #include <string.h>     // For string operations
 #include <stdio.h>      // For standard input/output
 #include <stdlib.h>     // For general utilities
 #include <sys/stat.h>   // For directory checking and creation
 
+// In-memory copy of requests.txt (in arena chunks, so records never move), plus a hash
+// table from request_id to a position in it
+static RecordArena request_store = { sizeof(Request), 0, NULL, 0, 0 };
+static int *request_slots = NULL;   // -1 means the slot is empty
+static int request_slot_count = 0;  // always a power of two
+static int max_request_id = 0;
+static int requests_loaded = 0;
+static unsigned long store_version = 0;  // goes up on every change (see requests_version)
+
+// How far we've read, so refresh_requests can pick up what other programs added since
+static long long requests_offset = 0;  // bytes of requests.txt already in the store
+static long request_log_offset = 0;    // bytes of the status log already applied
+static int request_generation = 0;     // data_generation() when the store was loaded
+static FileMark requests_mark;         // requests.txt as it was when we last read it
+static FileMark request_log_mark;      // the status log as it was when we last replayed it
+
+// Shorthand for the request at a store position
+static Request *stored_request(int index) {
+    return arena_at(&request_store, index);
+}
+
+// Pending requests grouped by the donor who owns the requested item. The item store
+// already maps item_id -> donor_username, so this is the other half of the join.
+typedef struct {
+    char username[21];
+    int pending_count;   // the inbox badge
+    int *pending;        // positions in request_store, oldest first
+    int capacity;
+} DonorInbox;
+
+static DonorInbox *inboxes = NULL;
+static int inbox_count = 0;
+static int inbox_capacity = 0;
+static int *inbox_slots = NULL;     // hash table from donor username to a position in inboxes
+static int inbox_slot_count = 0;
+
+// Approved requests grouped by recipient, so a recipient's inventory only looks at their
+// own requests instead of every request in the file
+typedef struct {
+    char username[21];
+    int approved_count;
+    int *approved;       // positions in request_store, in store order
+    int capacity;
+} Inventory;
+
+static Inventory *inventories = NULL;
+static int inventory_count = 0;
+static int inventory_capacity = 0;
+static int *inventory_slots = NULL;  // hash table from recipient username to a position in inventories
+static int inventory_slot_count = 0;
+
+// Pending requests grouped by item, so approving one request can find the requests
+// competing with it without looking through every request
+typedef struct {
+    int item_id;
+    int pending_count;
+    int *pending;        // positions in request_store, oldest first
+    int capacity;
+} ItemQueue;
+
+static ItemQueue *queues = NULL;
+static int queue_count = 0;
+static int queue_capacity = 0;
+static int *queue_slots = NULL;     // hash table from item_id to a position in queues
+static int queue_slot_count = 0;
+
 // Clears leftover chars in stdin
 static void clear_input_buffer() {
     int ch;
@@ -35,75 +114,683 @@ static void ensure_data_directory() {
     }
 }
 
-// Recipients can request an available item by ID
-void request_item(char *recipient_username) {
-    // Ensure data directory exists
-    ensure_data_directory();
-    
-    // Show available items first
-    display_items();
+// Picks the starting hash slot for a request_id
+static int request_hash(int request_id) {
+    return (int)(((unsigned int)request_id * 2654435761u) & (unsigned int)(request_slot_count - 1));
+}
 
-    // Check if at least one available item exists
-    FILE *itemFile = fopen(ITEM_FILE_PATH, "r");
-    int available = 0;
-    if (itemFile) {
-        char itemHeader[100];
-        fgets(itemHeader, sizeof(itemHeader), itemFile); // skip item file header
-        Item temp;
-        while (fscanf(itemFile, "%d,%20[^,],%20[^,],%99[^,],%20[^,],%20[^\n]\n",
-                      &temp.item_id, temp.donor_username, temp.category,
-                      temp.description, temp.condition, temp.status) != EOF) {
-            if (strcmp(temp.status, "available") == 0) {
-                available = 1;
-                break;
+// Picks the starting hash slot for a username (FNV-1a)
+static int name_hash(const char *name, int slots) {
+    unsigned int h = 2166136261u;
+    for (int i = 0; name[i]; i++) {
+        h = (h ^ (unsigned char)name[i]) * 16777619u;
+    }
+    return (int)(h & (unsigned int)(slots - 1));
+}
+
+// Puts a store position into the request_id hash table
+static void index_request(int index) {
+    int slot = request_hash(stored_request(index)->request_id);
+    while (request_slots[slot] != -1) {
+        slot = (slot + 1) & (request_slot_count - 1);
+    }
+    request_slots[slot] = index;
+}
+
+// Doubles the request_id hash table and re-inserts every request
+static int grow_request_slots() {
+    int new_count = request_slot_count ? request_slot_count * 2 : 64;
+    int *new_slots = malloc(sizeof(int) * new_count);
+    if (!new_slots) {
+        return 0;
+    }
+    free(request_slots);
+    request_slots = new_slots;
+    request_slot_count = new_count;
+    for (int i = 0; i < request_slot_count; i++) {
+        request_slots[i] = -1;
+    }
+    for (int i = 0; i < request_store.count; i++) {
+        index_request(i);
+    }
+    return 1;
+}
+
+// Doubles the donor hash table and re-inserts every donor
+static int grow_inbox_slots() {
+    int new_count = inbox_slot_count ? inbox_slot_count * 2 : 64;
+    int *new_slots = malloc(sizeof(int) * new_count);
+    if (!new_slots) {
+        return 0;
+    }
+    free(inbox_slots);
+    inbox_slots = new_slots;
+    inbox_slot_count = new_count;
+    for (int i = 0; i < inbox_slot_count; i++) {
+        inbox_slots[i] = -1;
+    }
+    for (int i = 0; i < inbox_count; i++) {
+        int slot = name_hash(inboxes[i].username, inbox_slot_count);
+        while (inbox_slots[slot] != -1) {
+            slot = (slot + 1) & (inbox_slot_count - 1);
+        }
+        inbox_slots[slot] = i;
+    }
+    return 1;
+}
+
+// Finds a donor's inbox. If create is set, an empty one is made when it doesn't exist yet.
+static DonorInbox *find_inbox(const char *donor_username, int create) {
+    if (inbox_slot_count > 0) {
+        int slot = name_hash(donor_username, inbox_slot_count);
+        while (inbox_slots[slot] != -1) {
+            if (strcmp(inboxes[inbox_slots[slot]].username, donor_username) == 0) {
+                return &inboxes[inbox_slots[slot]];
             }
+            slot = (slot + 1) & (inbox_slot_count - 1);
         }
-        fclose(itemFile);
     }
-    if (!available) {
-        printf("No available items to request.\n");
+    if (!create) {
+        return NULL;
+    }
+
+    if (inbox_count == inbox_capacity) {
+        int new_capacity = inbox_capacity ? inbox_capacity * 2 : 16;
+        DonorInbox *bigger = realloc(inboxes, sizeof(DonorInbox) * new_capacity);
+        if (!bigger) {
+            return NULL;
+        }
+        inboxes = bigger;
+        inbox_capacity = new_capacity;
+    }
+    if ((inbox_count + 1) * 10 > inbox_slot_count * 7 && !grow_inbox_slots()) {
+        return NULL;
+    }
+
+    DonorInbox *inbox = &inboxes[inbox_count];
+    strncpy(inbox->username, donor_username, sizeof(inbox->username) - 1);
+    inbox->username[sizeof(inbox->username) - 1] = '\0';
+    inbox->pending_count = 0;
+    inbox->pending = NULL;
+    inbox->capacity = 0;
+
+    int slot = name_hash(inbox->username, inbox_slot_count);
+    while (inbox_slots[slot] != -1) {
+        slot = (slot + 1) & (inbox_slot_count - 1);
+    }
+    inbox_slots[slot] = inbox_count;
+    inbox_count++;
+    return inbox;
+}
+
+// Doubles the recipient hash table and re-inserts every recipient
+static int grow_inventory_slots() {
+    int new_count = inventory_slot_count ? inventory_slot_count * 2 : 64;
+    int *new_slots = malloc(sizeof(int) * new_count);
+    if (!new_slots) {
+        return 0;
+    }
+    free(inventory_slots);
+    inventory_slots = new_slots;
+    inventory_slot_count = new_count;
+    for (int i = 0; i < inventory_slot_count; i++) {
+        inventory_slots[i] = -1;
+    }
+    for (int i = 0; i < inventory_count; i++) {
+        int slot = name_hash(inventories[i].username, inventory_slot_count);
+        while (inventory_slots[slot] != -1) {
+            slot = (slot + 1) & (inventory_slot_count - 1);
+        }
+        inventory_slots[slot] = i;
+    }
+    return 1;
+}
+
+// Finds a recipient's inventory. If create is set, an empty one is made when it doesn't
+// exist yet.
+static Inventory *find_inventory(const char *recipient_username, int create) {
+    if (inventory_slot_count > 0) {
+        int slot = name_hash(recipient_username, inventory_slot_count);
+        while (inventory_slots[slot] != -1) {
+            if (strcmp(inventories[inventory_slots[slot]].username, recipient_username) == 0) {
+                return &inventories[inventory_slots[slot]];
+            }
+            slot = (slot + 1) & (inventory_slot_count - 1);
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    if (inventory_count == inventory_capacity) {
+        int new_capacity = inventory_capacity ? inventory_capacity * 2 : 16;
+        Inventory *bigger = realloc(inventories, sizeof(Inventory) * new_capacity);
+        if (!bigger) {
+            return NULL;
+        }
+        inventories = bigger;
+        inventory_capacity = new_capacity;
+    }
+    if ((inventory_count + 1) * 10 > inventory_slot_count * 7 && !grow_inventory_slots()) {
+        return NULL;
+    }
+
+    Inventory *inventory = &inventories[inventory_count];
+    strncpy(inventory->username, recipient_username, sizeof(inventory->username) - 1);
+    inventory->username[sizeof(inventory->username) - 1] = '\0';
+    inventory->approved_count = 0;
+    inventory->approved = NULL;
+    inventory->capacity = 0;
+
+    int slot = name_hash(inventory->username, inventory_slot_count);
+    while (inventory_slots[slot] != -1) {
+        slot = (slot + 1) & (inventory_slot_count - 1);
+    }
+    inventory_slots[slot] = inventory_count;
+    inventory_count++;
+    return inventory;
+}
+
+// Adds an approved request (by store position) to its recipient's inventory, keeping
+// the list in store order (approvals usually come in for recent requests, so this is
+// almost always an append)
+static void inventory_add(int index) {
+    Inventory *inventory = find_inventory(stored_request(index)->recipient_username, 1);
+    if (!inventory) {
         return;
     }
+    if (inventory->approved_count == inventory->capacity) {
+        int new_capacity = inventory->capacity ? inventory->capacity * 2 : 4;
+        int *bigger = realloc(inventory->approved, sizeof(int) * new_capacity);
+        if (!bigger) {
+            return;
+        }
+        inventory->approved = bigger;
+        inventory->capacity = new_capacity;
+    }
+    int at = inventory->approved_count;
+    while (at > 0 && inventory->approved[at - 1] > index) {
+        at--;
+    }
+    memmove(&inventory->approved[at + 1], &inventory->approved[at],
+            sizeof(int) * (inventory->approved_count - at));
+    inventory->approved[at] = index;
+    inventory->approved_count++;
+}
 
-    // Ask for the item ID to request
-    int item_id;
-    printf("Enter the ID of the item you want to request: ");
-    if (scanf("%d", &item_id) != 1) {
-        printf("Invalid input for item ID.\n");
-        clear_input_buffer();
+// Takes a request (by store position) back out of its recipient's inventory
+static void inventory_remove(int index) {
+    Inventory *inventory = find_inventory(stored_request(index)->recipient_username, 0);
+    if (!inventory) {
         return;
     }
-    clear_input_buffer();
+    for (int i = 0; i < inventory->approved_count; i++) {
+        if (inventory->approved[i] == index) {
+            memmove(&inventory->approved[i], &inventory->approved[i + 1],
+                    sizeof(int) * (inventory->approved_count - i - 1));
+            inventory->approved_count--;
+            return;
+        }
+    }
+}
 
-    // Ensure this item is actually available
-    itemFile = fopen(ITEM_FILE_PATH, "r");
-    if (!itemFile) {
-        printf("Error: No items available.\n");
+// Picks the starting hash slot for an item_id in queue_slots
+static int queue_hash(int item_id) {
+    return (int)(((unsigned int)item_id * 2654435761u) & (unsigned int)(queue_slot_count - 1));
+}
+
+// Doubles the item queue hash table and re-inserts every queue
+static int grow_queue_slots() {
+    int new_count = queue_slot_count ? queue_slot_count * 2 : 64;
+    int *new_slots = malloc(sizeof(int) * new_count);
+    if (!new_slots) {
+        return 0;
+    }
+    free(queue_slots);
+    queue_slots = new_slots;
+    queue_slot_count = new_count;
+    for (int i = 0; i < queue_slot_count; i++) {
+        queue_slots[i] = -1;
+    }
+    for (int i = 0; i < queue_count; i++) {
+        int slot = queue_hash(queues[i].item_id);
+        while (queue_slots[slot] != -1) {
+            slot = (slot + 1) & (queue_slot_count - 1);
+        }
+        queue_slots[slot] = i;
+    }
+    return 1;
+}
+
+// Finds an item's queue of pending requests. If create is set, an empty one is made
+// when it doesn't exist yet.
+static ItemQueue *find_queue(int item_id, int create) {
+    if (queue_slot_count > 0) {
+        int slot = queue_hash(item_id);
+        while (queue_slots[slot] != -1) {
+            if (queues[queue_slots[slot]].item_id == item_id) {
+                return &queues[queue_slots[slot]];
+            }
+            slot = (slot + 1) & (queue_slot_count - 1);
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    if (queue_count == queue_capacity) {
+        int new_capacity = queue_capacity ? queue_capacity * 2 : 64;
+        ItemQueue *bigger = realloc(queues, sizeof(ItemQueue) * new_capacity);
+        if (!bigger) {
+            return NULL;
+        }
+        queues = bigger;
+        queue_capacity = new_capacity;
+    }
+    if ((queue_count + 1) * 10 > queue_slot_count * 7 && !grow_queue_slots()) {
+        return NULL;
+    }
+
+    ItemQueue *queue = &queues[queue_count];
+    queue->item_id = item_id;
+    queue->pending_count = 0;
+    queue->pending = NULL;
+    queue->capacity = 0;
+
+    int slot = queue_hash(item_id);
+    while (queue_slots[slot] != -1) {
+        slot = (slot + 1) & (queue_slot_count - 1);
+    }
+    queue_slots[slot] = queue_count;
+    queue_count++;
+    return queue;
+}
+
+// Adds a pending request (by store position) to its item's queue
+static void queue_add(int index) {
+    ItemQueue *queue = find_queue(stored_request(index)->item_id, 1);
+    if (!queue) {
+        return;
+    }
+    if (queue->pending_count == queue->capacity) {
+        int new_capacity = queue->capacity ? queue->capacity * 2 : 4;
+        int *bigger = realloc(queue->pending, sizeof(int) * new_capacity);
+        if (!bigger) {
+            return;
+        }
+        queue->pending = bigger;
+        queue->capacity = new_capacity;
+    }
+    queue->pending[queue->pending_count++] = index;
+}
+
+// Takes a request (by store position) back out of its item's queue
+static void queue_remove(int index) {
+    ItemQueue *queue = find_queue(stored_request(index)->item_id, 0);
+    if (!queue) {
+        return;
+    }
+    for (int i = 0; i < queue->pending_count; i++) {
+        if (queue->pending[i] == index) {
+            memmove(&queue->pending[i], &queue->pending[i + 1],
+                    sizeof(int) * (queue->pending_count - i - 1));
+            queue->pending_count--;
+            return;
+        }
+    }
+}
+
+// Adds a pending request (by store position) to the inbox of the item's donor
+// and to the item's queue
+static void inbox_add(int index) {
+    queue_add(index);
+    Item *item = find_item(stored_request(index)->item_id);
+    if (!item) {
+        return;
+    }
+    DonorInbox *inbox = find_inbox(item->donor_username, 1);
+    if (!inbox) {
+        return;
+    }
+    if (inbox->pending_count == inbox->capacity) {
+        int new_capacity = inbox->capacity ? inbox->capacity * 2 : 8;
+        int *bigger = realloc(inbox->pending, sizeof(int) * new_capacity);
+        if (!bigger) {
+            return;
+        }
+        inbox->pending = bigger;
+        inbox->capacity = new_capacity;
+    }
+    inbox->pending[inbox->pending_count++] = index;
+}
+
+// Takes a request (by store position) back out of its donor's inbox and its item's queue
+static void inbox_remove(int index) {
+    queue_remove(index);
+    Item *item = find_item(stored_request(index)->item_id);
+    if (!item) {
+        return;
+    }
+    DonorInbox *inbox = find_inbox(item->donor_username, 0);
+    if (!inbox) {
+        return;
+    }
+    for (int i = 0; i < inbox->pending_count; i++) {
+        if (inbox->pending[i] == index) {
+            // Shift the rest down so the inbox stays in request order
+            memmove(&inbox->pending[i], &inbox->pending[i + 1],
+                    sizeof(int) * (inbox->pending_count - i - 1));
+            inbox->pending_count--;
+            return;
+        }
+    }
+}
+
+// Adds one request to the store and the request_id index
+static int store_request(const Request *req) {
+    if ((request_store.count + 1) * 10 > request_slot_count * 7 && !grow_request_slots()) {
+        return 0;
+    }
+    Request *stored = arena_add(&request_store);
+    if (!stored) {
+        return 0;
+    }
+    *stored = *req;
+    index_request(request_store.count - 1);
+    store_version++;
+    if (req->request_id > max_request_id) {
+        max_request_id = req->request_id;
+    }
+    return 1;
+}
+
+// Finds a request's position in the store by ID, or -1 if there is no such request
+static int request_index(int request_id) {
+    load_requests();
+    if (request_slot_count == 0) {
+        return -1;
+    }
+    int slot = request_hash(request_id);
+    while (request_slots[slot] != -1) {
+        if (stored_request(request_slots[slot])->request_id == request_id) {
+            return request_slots[slot];
+        }
+        slot = (slot + 1) & (request_slot_count - 1);
+    }
+    return -1;
+}
+
+// Sets a request's status in the store and keeps the inboxes and inventories in step
+static void set_request_status(int index, int status) {
+    Request *req = stored_request(index);
+    int was_pending = req->status == STATUS_PENDING;
+    int now_pending = status == STATUS_PENDING;
+    int was_approved = req->status == STATUS_APPROVED;
+    int now_approved = status == STATUS_APPROVED;
+    if (was_pending && !now_pending) {
+        inbox_remove(index);
+    } else if (!was_pending && now_pending) {
+        inbox_add(index);
+    }
+    if (was_approved && !now_approved) {
+        inventory_remove(index);
+    } else if (!was_approved && now_approved) {
+        inventory_add(index);
+    }
+    req->status = (unsigned short)status;
+    store_version++;
+}
+
+// Files a request under its donor's inbox if it's pending, or its recipient's
+// inventory if it's approved
+static void list_request(int index) {
+    int status = stored_request(index)->status;
+    if (status == STATUS_PENDING) {
+        inbox_add(index);
+    } else if (status == STATUS_APPROVED) {
+        inventory_add(index);
+    }
+}
+
+// Applies one status change from the status log to the store (before the inboxes and
+// inventories are built)
+static void apply_logged_status(int request_id, const char *status) {
+    int index = request_index(request_id);
+    int code = dict_code(DICT_STATUS, status);
+    if (index >= 0 && code >= 0) {
+        stored_request(index)->status = (unsigned short)code;
+    }
+}
+
+// Applies a status change from the status log once the inboxes are built
+static void apply_new_status(int request_id, const char *status) {
+    int index = request_index(request_id);
+    int code = dict_code(DICT_STATUS, status);
+    if (index >= 0 && code >= 0) {
+        set_request_status(index, code);
+    }
+}
+
+const char *request_status(const Request *req) {
+    return dict_text(DICT_STATUS, req->status);
+}
+
+// Opens requests.txt at requests_offset. Returns NULL if there's no file.
+static FILE *open_request_rows() {
+    FILE *file = stats_fopen(REQUEST_FILE_PATH, "r");
+    if (file && requests_offset > 0) {
+        fseek(file, (long)requests_offset, SEEK_SET);
+    }
+    return file;
+}
+
+int request_from_row(const CsvReader *reader, Request *req) {
+    memset(req, 0, sizeof(*req));
+    return reader->field_count == 4 &&
+           csv_int(reader, 0, &req->request_id) &&
+           csv_int(reader, 1, &req->item_id) &&
+           csv_copy(reader, 2, req->recipient_username, sizeof(req->recipient_username)) &&
+           dict_field(DICT_STATUS, reader, 3, &req->status);
+}
+
+int write_request_row(FILE *file, const Request *req) {
+    char request_id[12], item_id[12];
+    snprintf(request_id, sizeof(request_id), "%d", req->request_id);
+    snprintf(item_id, sizeof(item_id), "%d", req->item_id);
+    const char *row[] = { request_id, item_id, req->recipient_username, request_status(req) };
+    return csv_write_row(file, row, 4);
+}
+
+// Stores every row from the current position of requests.txt to the end, skipping IDs
+// already in the store. If add_to_lists is set, new requests also go into their donor's
+// inbox or recipient's inventory. Remembers how far we got in requests_offset.
+// On the first read the header line is skipped.
+static void read_request_rows(FILE *file, int add_to_lists) {
+    CsvReader reader;
+    if (!csv_open(&reader, file, "requests.txt")) {
+        printf("Error: Not enough memory to load requests.\n");
         return;
     }
-    char itemHeader[100];
-    fgets(itemHeader, sizeof(itemHeader), itemFile); // skip item file header
-    Item temp_item;
-    int item_found = 0;
-    while (fscanf(itemFile, "%d,%20[^,],%20[^,],%99[^,],%20[^,],%20[^\n]\n",
-                  &temp_item.item_id, temp_item.donor_username, temp_item.category,
-                  temp_item.description, temp_item.condition, temp_item.status) != EOF) {
-        if (temp_item.item_id == item_id && strcmp(temp_item.status, "available") == 0) {
-            item_found = 1;
+    long long start = reader.offset;
+    long long records = 0;
+    int header = requests_offset == 0;
+    while (csv_next(&reader)) {
+        if (header) {
+            header = 0;
+            continue;
+        }
+        Request req;
+        if (!request_from_row(&reader, &req)) {
+            csv_skip(&reader);
+            continue;
+        }
+        records++;
+        if (request_index(req.request_id) >= 0) {
+            continue;
+        }
+        if (!store_request(&req)) {
+            printf("Error: Not enough memory to load requests.\n");
             break;
         }
+        if (add_to_lists) {
+            list_request(request_store.count - 1);
+        }
     }
-    fclose(itemFile);
-    if (!item_found) {
-        printf("Error: Item not found or not available.\n");
+    requests_offset = reader.offset;
+    stats_read(requests_offset - start, records);
+    csv_close(&reader);
+}
+
+// Reads requests.txt into the request store. Only the first call does any work.
+void load_requests() {
+    if (requests_loaded) {
         return;
     }
+    STATS_TIME(STAT_LOAD_REQUESTS);
+    requests_loaded = 1;
+    load_items();  // the donor inboxes need item -> donor lookups
+
+    // Keep compaction from rewriting the files while we read them
+    lock_data(LOCK_STATUS_LOG, 0);
+    lock_data(LOCK_REQUESTS, 0);
+    request_generation = data_generation();
+
+    // Start from the binary copy (requests.bin) if it still matches requests.txt
+    requests_offset = 0;
+    BinaryTable table;
+    if (open_binary_table(REQUEST_BIN_PATH, "CDPR", sizeof(Request), &table)) {
+        if (binary_matches_csv(&table, REQUEST_FILE_PATH)) {
+            for (int i = 0; i < table.header->record_count; i++) {
+                Request req;
+                binary_request_at(&table, i, &req);
+                store_request(&req);
+            }
+            stats_read((long long)table.header->record_count * (long long)sizeof(Request),
+                       table.header->record_count);
+            requests_offset = table.header->source_size;
+        }
+        close_binary_table(&table);
+    }
+
+    FILE *file = open_request_rows();
+    if (file) {
+        read_request_rows(file, 0);
+        fclose(file);
+    }
+    mark_file(REQUEST_FILE_PATH, requests_offset, &requests_mark);
+    unlock_data(LOCK_REQUESTS);
+
+    // Apply status changes that haven't been compacted yet, then file every pending
+    // request under its donor and every approved one under its recipient in one pass
+    request_log_offset = 0;
+    replay_status_log('R', apply_logged_status, &request_log_offset);
+    mark_file(STATUS_LOG_PATH, request_log_offset, &request_log_mark);
+    unlock_data(LOCK_STATUS_LOG);
+    for (int i = 0; i < request_store.count; i++) {
+        list_request(i);
+    }
+}
+
+// Size of a file in bytes, or -1 if it doesn't exist
+static long long file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (long long)st.st_size : -1;
+}
+
+// Empties the store, inboxes, queues and inventories so they can be loaded again from scratch
+static void reset_requests() {
+    arena_clear(&request_store);
+    for (int i = 0; i < request_slot_count; i++) {
+        request_slots[i] = -1;
+    }
+    for (int i = 0; i < inbox_count; i++) {
+        inboxes[i].pending_count = 0;
+    }
+    for (int i = 0; i < queue_count; i++) {
+        queues[i].pending_count = 0;
+    }
+    for (int i = 0; i < inventory_count; i++) {
+        inventories[i].approved_count = 0;
+    }
+    requests_loaded = 0;
+    store_version++;
+}
+
+void refresh_requests() {
+    if (!requests_loaded) {
+        load_requests();
+        return;
+    }
+    STATS_TIME(STAT_REFRESH_REQUESTS);
+    lock_data(LOCK_STATUS_LOG, 0);
+    // New requests may be for items we haven't seen yet. If the items had to be loaded
+    // again, the inboxes may point at donors that changed, so load the requests again too.
+    int items_reloaded = refresh_items();
+    int rewritten = items_reloaded || data_generation() != request_generation ||
+                    file_rewritten(REQUEST_FILE_PATH, &requests_mark) ||
+                    file_rewritten(STATUS_LOG_PATH, &request_log_mark);
+    if (rewritten) {
+        reset_requests();
+        load_requests();
+    } else {
+        // Otherwise rows can only have been added, so just read the new ones
+        if (file_size(REQUEST_FILE_PATH) > requests_offset) {
+            lock_data(LOCK_REQUESTS, 0);
+            FILE *file = open_request_rows();
+            if (file) {
+                read_request_rows(file, 1);
+                fclose(file);
+            }
+            mark_file(REQUEST_FILE_PATH, requests_offset, &requests_mark);
+            unlock_data(LOCK_REQUESTS);
+        }
+        long applied = request_log_offset;
+        replay_status_log('R', apply_new_status, &request_log_offset);
+        if (request_log_offset != applied) {
+            mark_file(STATUS_LOG_PATH, request_log_offset, &request_log_mark);
+        }
+    }
+    unlock_data(LOCK_STATUS_LOG);
+}
+
+// Looks up a request by ID in the store. Returns NULL if there is no such request.
+Request *find_request(int request_id) {
+    STATS_TIME(STAT_FIND_REQUEST);
+    int index = request_index(request_id);
+    return index >= 0 ? stored_request(index) : NULL;
+}
+
+// Files a pending request for an item without asking anything.
+// Returns the new request_id, or one of the REQUEST_* error codes (all below zero).
+int submit_request(const char *recipient_username, int item_id) {
+    STATS_TIME(STAT_SUBMIT_REQUEST);
+    // Ensure data directory exists
+    ensure_data_directory();
+
+    // Catch up with other programs, and hold the status log (shared) so nobody can
+    // donate the item between our check and our append
+    lock_data(LOCK_STATUS_LOG, 0);
+    refresh_requests();
+
+    // Ensure this item is actually available
+    Item *wanted = find_item(item_id);
+    if (!wanted || wanted->status != STATUS_AVAILABLE) {
+        unlock_data(LOCK_STATUS_LOG);
+        return REQUEST_ITEM_UNAVAILABLE;
+    }
+    // Nobody can ask for their own item
+    if (strcmp(wanted->donor_username, recipient_username) == 0) {
+        unlock_data(LOCK_STATUS_LOG);
+        return REQUEST_OWN_ITEM;
+    }
 
     // Open requests file in append mode and ensure it has a header
-    FILE *file = fopen(REQUEST_FILE_PATH, "a+");  // Changed from "a" to "a+"
+    lock_data(LOCK_REQUESTS, 1);
+    FILE *file = stats_fopen(REQUEST_FILE_PATH, "a+");  // Changed from "a" to "a+"
     if (!file) {
-        printf("Error: Unable to open requests.txt for writing.\n");
-        return;
+        unlock_data(LOCK_REQUESTS);
+        unlock_data(LOCK_STATUS_LOG);
+        return REQUEST_WRITE_FAILED;
     }
     
     // If the file is empty, write a header so we can skip it later
@@ -122,35 +809,282 @@ void request_item(char *recipient_username) {
         fseek(file, 0, SEEK_END);  // Move back to end for appending
     }
 
-    // Figure out the last used request ID, so we know what the next one is
-    int last_id = 0;
-    FILE *readFile = fopen(REQUEST_FILE_PATH, "r");
-    if (readFile) {
-        char reqHeader[100];
-        fgets(reqHeader, sizeof(reqHeader), readFile); // skip request file header
-        Request tempReq;
-        while (fscanf(readFile, "%d,%d,%20[^,],%20[^\n]\n",
-                      &tempReq.request_id, &tempReq.item_id,
-                      tempReq.recipient_username, tempReq.status) != EOF) {
-            if (tempReq.request_id > last_id) {
-                last_id = tempReq.request_id;
+    // Take the next request ID from the sequence file (no need to re-read requests.txt)
+    Request newReq;
+    memset(&newReq, 0, sizeof(newReq));
+    newReq.request_id = next_id(REQUEST_SEQ_PATH, max_request_id);
+    newReq.item_id = item_id;
+    strncpy(newReq.recipient_username, recipient_username, sizeof(newReq.recipient_username) - 1);
+    newReq.status = STATUS_PENDING;
+
+    // Write the new request (with "pending" status) to the file, then to the store
+    int written = write_request_row(file, &newReq);
+    stats_written(written > 0 ? written : 0);
+    int closed = close_durably(file);
+    unlock_data(LOCK_REQUESTS);
+    unlock_data(LOCK_STATUS_LOG);
+    if (!closed) {
+        return REQUEST_WRITE_FAILED;
+    }
+    if (store_request(&newReq)) {
+        inbox_add(request_store.count - 1);
+    } else {
+        printf("Error: Not enough memory to keep the new request loaded.\n");
+    }
+    return newReq.request_id;
+}
+
+// Recipients can request an available item by ID
+void request_item(char *recipient_username) {
+    STATS_TIME(STAT_REQUEST_ITEM);
+    load_requests();
+
+    // Show available items first
+    display_items();
+
+    // Check if at least one available item exists
+    if (count_available_items() == 0) {
+        printf("No available items to request.\n");
+        return;
+    }
+
+    // Ask for the item ID to request
+    int item_id;
+    printf("Enter the ID of the item you want to request: ");
+    if (scanf("%d", &item_id) != 1) {
+        printf("Invalid input for item ID.\n");
+        clear_input_buffer();
+        return;
+    }
+    clear_input_buffer();
+
+    int result = submit_request(recipient_username, item_id);
+    if (result == REQUEST_ITEM_UNAVAILABLE) {
+        printf("Error: Item not found or not available.\n");
+    } else if (result == REQUEST_OWN_ITEM) {
+        printf("Error: You can't request your own item.\n");
+    } else if (result == REQUEST_WRITE_FAILED) {
+        printf("Error: Unable to open requests.txt for writing.\n");
+    } else {
+        printf("Request successfully submitted!\n");
+    }
+}
+
+// Checks that a decision still makes sense against the latest data: the request is for
+// one of this donor's items, nobody has decided it yet, and (to approve) the item hasn't
+// been given to someone else. Returns 0 or a REQUEST_* error code.
+static int check_decision(const char *donor_username, int request_id, const char *decision) {
+    // Donors can only decide requests for their own items
+    int index = request_index(request_id);
+    if (index < 0) {
+        return REQUEST_NOT_FOUND;
+    }
+    Request *req = stored_request(index);
+    Item *item = find_item(req->item_id);
+    if (!item || strcmp(item->donor_username, donor_username) != 0) {
+        return REQUEST_NOT_FOUND;
+    }
+    if (req->status != STATUS_PENDING) {
+        return REQUEST_ALREADY_DECIDED;
+    }
+    if (strcmp(decision, "approve") == 0 && item->status != STATUS_AVAILABLE) {
+        return REQUEST_ITEM_UNAVAILABLE;
+    }
+    return 0;
+}
+
+// A small set of IDs (open addressing), used by decide_requests to remember which
+// requests and items the earlier decisions in a batch have already used
+typedef struct {
+    int *slots;      // 0 means the slot is empty (IDs start at 1)
+    int slot_count;  // a power of two, at least twice the most IDs we'll add
+} IdSet;
+
+static int id_set_init(IdSet *set, int max_ids) {
+    set->slot_count = 16;
+    while (set->slot_count < max_ids * 2) {
+        set->slot_count *= 2;
+    }
+    set->slots = calloc((size_t)set->slot_count, sizeof(int));
+    return set->slots != NULL;
+}
+
+// Finds the slot holding an ID, or the empty slot where it would go
+static int id_set_slot(const IdSet *set, int id) {
+    int slot = (int)(((unsigned int)id * 2654435761u) & (unsigned int)(set->slot_count - 1));
+    while (set->slots[slot] != 0 && set->slots[slot] != id) {
+        slot = (slot + 1) & (set->slot_count - 1);
+    }
+    return slot;
+}
+
+static int id_set_has(const IdSet *set, int id) {
+    return set->slots[id_set_slot(set, id)] == id;
+}
+
+static void id_set_add(IdSet *set, int id) {
+    set->slots[id_set_slot(set, id)] = id;
+}
+
+// Approves or rejects several of this donor's requests in one status log group.
+// Returns how many were applied, or REQUEST_WRITE_FAILED.
+int decide_requests(const char *donor_username, Decision *decisions, int count) {
+    STATS_TIME(STAT_DECIDE_REQUESTS);
+    ensure_data_directory();
+
+    // Hold the status log from the checks below until the decisions are written, after
+    // catching up with anything other programs have decided in the meantime
+    lock_data(LOCK_STATUS_LOG, 1);
+    refresh_requests();
+
+    // Approvals also reject the other requests for their item, so the set of decided
+    // requests can hold more than count IDs
+    int most_decided = count;
+    for (int i = 0; i < count; i++) {
+        decisions[i].competing_rejected = 0;
+        int index = request_index(decisions[i].request_id);
+        ItemQueue *queue = index >= 0 ? find_queue(stored_request(index)->item_id, 0) : NULL;
+        if (queue) {
+            most_decided += queue->pending_count;
+        }
+    }
+    IdSet decided, given;
+    decided.slots = given.slots = NULL;
+    if (!id_set_init(&decided, most_decided) || !id_set_init(&given, count)) {
+        printf("Error: Not enough memory.\n");
+        unlock_data(LOCK_STATUS_LOG);
+        free(decided.slots);
+        free(given.slots);
+        for (int i = 0; i < count; i++) {
+            decisions[i].result = REQUEST_WRITE_FAILED;
+        }
+        return REQUEST_WRITE_FAILED;
+    }
+
+    int applied = 0;
+    for (int i = 0; i < count; i++) {
+        Decision *d = &decisions[i];
+        int approve = strcmp(d->decision, "approve") == 0;
+        if (!approve && strcmp(d->decision, "reject") != 0) {
+            d->result = REQUEST_BAD_DECISION;
+            continue;
+        }
+        d->result = check_decision(donor_username, d->request_id, d->decision);
+        if (d->result != 0) {
+            continue;
+        }
+
+        // The store doesn't change until the group is written, so check against the
+        // earlier decisions in this batch too
+        Request *req = stored_request(request_index(d->request_id));
+        if (id_set_has(&decided, d->request_id)) {
+            d->result = REQUEST_ALREADY_DECIDED;
+            continue;
+        }
+        if (approve && id_set_has(&given, req->item_id)) {
+            d->result = REQUEST_ITEM_UNAVAILABLE;
+            continue;
+        }
+        id_set_add(&decided, d->request_id);
+        if (approve) {
+            id_set_add(&given, req->item_id);
+        }
+        log_request_status(req->request_id, approve ? "approved" : "rejected");
+        if (approve) {
+            log_item_status(req->item_id, "donated");
+
+            // Nobody else can get this item now, so reject every other request for it
+            // in the same group instead of leaving them pending forever
+            ItemQueue *queue = find_queue(req->item_id, 0);
+            for (int j = 0; queue && j < queue->pending_count; j++) {
+                Request *other = stored_request(queue->pending[j]);
+                if (!id_set_has(&decided, other->request_id)) {
+                    id_set_add(&decided, other->request_id);
+                    log_request_status(other->request_id, "rejected");
+                    d->competing_rejected++;
+                }
             }
         }
-        fclose(readFile);
+        applied++;
     }
-    int request_id = last_id + 1;
 
-    // Write the new request (with "pending" status) to the file
-    fprintf(file, "%d,%d,%s,pending\n", request_id, item_id, recipient_username);
-    fclose(file);
-    printf("Request successfully submitted!\n");
+    // Write every accepted decision as one group, then pick them up into the store the
+    // same way we pick up other programs' changes
+    if (applied > 0) {
+        if (commit_status_log()) {
+            refresh_requests();
+        } else {
+            for (int i = 0; i < count; i++) {
+                if (decisions[i].result == 0) {
+                    decisions[i].result = REQUEST_WRITE_FAILED;
+                }
+            }
+            applied = REQUEST_WRITE_FAILED;
+        }
+    }
+    unlock_data(LOCK_STATUS_LOG);
+    free(decided.slots);
+    free(given.slots);
+    return applied;
 }
 
-// Donors can approve or reject a request
+// Approves or rejects one of this donor's requests without asking anything.
+// decision is "approve" or "reject". Returns 0, or one of the REQUEST_* error codes.
+int decide_request(const char *donor_username, int request_id, const char *decision) {
+    STATS_TIME(STAT_DECIDE_REQUEST);
+    Decision d;
+    d.request_id = request_id;
+    strncpy(d.decision, decision, sizeof(d.decision) - 1);
+    d.decision[sizeof(d.decision) - 1] = '\0';
+    decide_requests(donor_username, &d, 1);
+    return d.result;
+}
+
+// Gives an item to whoever asked for it first. Returns the approved request_id,
+// or a REQUEST_* error code.
+int allocate_item(const char *donor_username, int item_id) {
+    STATS_TIME(STAT_ALLOCATE_ITEM);
+    lock_data(LOCK_STATUS_LOG, 1);
+    refresh_requests();
+    int result;
+    Item *item = find_item(item_id);
+    ItemQueue *queue = find_queue(item_id, 0);
+    if (!item || strcmp(item->donor_username, donor_username) != 0) {
+        result = REQUEST_NOT_FOUND;
+    } else if (item->status != STATUS_AVAILABLE) {
+        result = REQUEST_ITEM_UNAVAILABLE;
+    } else if (!queue || queue->pending_count == 0) {
+        result = REQUEST_NOT_FOUND;
+    } else {
+        // The queue is in request order, so the first entry has waited longest
+        Decision d;
+        d.request_id = stored_request(queue->pending[0])->request_id;
+        strcpy(d.decision, "approve");
+        decide_requests(donor_username, &d, 1);
+        result = d.result == 0 ? d.request_id : d.result;
+    }
+    unlock_data(LOCK_STATUS_LOG);
+    return result;
+}
+
+// What we tell the donor about one decision
+static const char *decision_message(int result) {
+    switch (result) {
+        case 0:                        return "Request successfully updated.";
+        case REQUEST_NOT_FOUND:        return "Request ID not found.";
+        case REQUEST_BAD_DECISION:     return "Invalid decision. Request not updated.";
+        case REQUEST_ALREADY_DECIDED:  return "That request has already been approved or rejected.";
+        case REQUEST_ITEM_UNAVAILABLE: return "That item has already been donated. Request not updated.";
+        default:                       return "Unable to save the decision. Request not updated.";
+    }
+}
+
+#define MAX_MENU_DECISIONS 32
+
+// Donors can approve or reject a request, or several at once by typing
+// "ID decision" pairs on one line
 void approve_request(char *donor_username) {
-    // Ensure data directory exists
-    ensure_data_directory();
-    
+    STATS_TIME(STAT_APPROVE_REQUEST);
     if (count_pending_requests(donor_username) == 0) {
         printf("No pending requests for approval.\n");
         return;
@@ -159,232 +1093,186 @@ void approve_request(char *donor_username) {
     printf("\nPending Requests for Approval:\n");
     view_inbox(donor_username);
 
-    int request_id;
-    char decision[10];
-    printf("Enter the ID of the request to approve/reject: ");
-    if (scanf("%d", &request_id) != 1) {
-        printf("Invalid input for request ID.\n");
-        clear_input_buffer();
+    char line[512];
+    printf("Enter the ID of the request to approve/reject\n");
+    printf("(or several at once, like \"12 approve 15 reject\",\n");
+    printf(" or \"first 7\" to give item 7 to whoever asked for it first): ");
+    if (!fgets(line, sizeof(line), stdin)) {
         return;
     }
-    clear_input_buffer();
+    if (!strchr(line, '\n')) {
+        clear_input_buffer();  // the line was too long; drop the rest of it
+    }
 
-    printf("Enter decision (approve/reject): ");
-    if (scanf("%9s", decision) != 1) {
-        printf("Invalid input for decision.\n");
-        clear_input_buffer();
+    // Split the line into words: either a single ID (we ask for the decision next) or
+    // pairs like "12 approve 15 reject"
+    char *words[MAX_MENU_DECISIONS * 2 + 1];
+    int word_count = 0;
+    for (char *word = strtok(line, " \t\r\n"); word && word_count < MAX_MENU_DECISIONS * 2 + 1;
+         word = strtok(NULL, " \t\r\n")) {
+        words[word_count++] = word;
+    }
+    if (word_count == 0 || (word_count > 1 && word_count % 2 != 0)) {
+        printf("Invalid input for request ID.\n");
         return;
     }
-    clear_input_buffer();
-    local_to_lowercase(decision);
 
-    FILE *file = fopen(REQUEST_FILE_PATH, "r");
-    if (!file) {
-        printf("Error: Unable to open requests.txt for reading.\n");
-        return;
+    // "first <item_id>": the donor lets the oldest request win
+    if (word_count == 2) {
+        local_to_lowercase(words[0]);
     }
-    char reqHeader[100];
-    fgets(reqHeader, sizeof(reqHeader), file); // skip request file header
-    FILE *tempFile = fopen("../data/temp_requests.txt", "w");
-    if (!tempFile) {
-        printf("Error: Unable to create temporary file.\n");
-        fclose(file);
+    if (word_count == 2 && strcmp(words[0], "first") == 0) {
+        int item_id = atoi(words[1]);
+        int result = allocate_item(donor_username, item_id);
+        if (result > 0) {
+            printf("Item %d goes to request %d (%s).\n", item_id, result,
+                   find_request(result)->recipient_username);
+        } else if (result == REQUEST_NOT_FOUND) {
+            printf("No pending requests for that item.\n");
+        } else {
+            printf("%s\n", decision_message(result));
+        }
         return;
     }
-    // Write the CSV header into the temp file
-    fprintf(tempFile, "request_id,item_id,recipient_username,status\n");
 
-    Request temp;
-    int found = 0;
-    // Check each request
-    while (fscanf(file, "%d,%d,%20[^,],%20[^\n]\n",
-                  &temp.request_id, &temp.item_id,
-                  temp.recipient_username, temp.status) != EOF) {
-        if (temp.request_id == request_id) {
-            found = 1;
-            if (strcmp(decision, "approve") == 0) {
-                strcpy(temp.status, "approved");
-                // Also mark the item as donated
-                update_status(temp.item_id, "donated");
-            } else if (strcmp(decision, "reject") == 0) {
-                strcpy(temp.status, "rejected");
-            } else {
-                printf("Invalid decision. Request not updated.\n");
-                fprintf(tempFile, "%d,%d,%s,%s\n",
-                        temp.request_id, temp.item_id,
-                        temp.recipient_username, temp.status);
-                continue;
-            }
+    Decision decisions[MAX_MENU_DECISIONS];
+    int count = word_count == 1 ? 1 : word_count / 2;
+    for (int i = 0; i < count; i++) {
+        char extra;
+        if (sscanf(words[i * 2], "%d%c", &decisions[i].request_id, &extra) != 1) {
+            printf("Invalid input for request ID.\n");
+            return;
+        }
+        if (word_count > 1) {
+            strncpy(decisions[i].decision, words[i * 2 + 1], sizeof(decisions[i].decision) - 1);
+            decisions[i].decision[sizeof(decisions[i].decision) - 1] = '\0';
+            local_to_lowercase(decisions[i].decision);
         }
-        fprintf(tempFile, "%d,%d,%s,%s\n",
-                temp.request_id, temp.item_id,
-                temp.recipient_username, temp.status);
     }
-    fclose(file);
-    fclose(tempFile);
 
-    if (!found) {
-        printf("Request ID not found.\n");
-        remove("../data/temp_requests.txt");
-    } else {
-        remove(REQUEST_FILE_PATH);
-        if (rename("../data/temp_requests.txt", REQUEST_FILE_PATH) != 0) {
-            printf("Error: Unable to update requests file.\n");
-        } else {
-            printf("Request successfully updated.\n");
+    if (word_count == 1) {
+        printf("Enter decision (approve/reject): ");
+        if (scanf("%9s", decisions[0].decision) != 1) {
+            printf("Invalid input for decision.\n");
+            clear_input_buffer();
+            return;
         }
+        clear_input_buffer();
+        local_to_lowercase(decisions[0].decision);
     }
+
+    int applied = decide_requests(donor_username, decisions, count);
+    if (count == 1) {
+        printf("%s\n", decision_message(decisions[0].result));
+        if (decisions[0].competing_rejected > 0) {
+            printf("%d other request(s) for this item were rejected automatically.\n",
+                   decisions[0].competing_rejected);
+        }
+        return;
+    }
+    printf("\nDecisions:\n");
+    for (int i = 0; i < count; i++) {
+        printf("  Request %d (%s): %s\n", decisions[i].request_id, decisions[i].decision,
+               decision_message(decisions[i].result));
+        if (decisions[i].competing_rejected > 0) {
+            printf("    %d other request(s) for this item were rejected automatically.\n",
+                   decisions[i].competing_rejected);
+        }
+    }
+    printf("%d of %d requests updated.\n", applied > 0 ? applied : 0, count);
 }
 
 // Shows all pending requests for this donor
 void view_inbox(char *donor_username) {
-    FILE *reqFile = fopen(REQUEST_FILE_PATH, "r");
-    if (!reqFile) {
-        printf("No request notifications available.\n");
-        return;
-    }
-    char header[100];
-    fgets(header, sizeof(header), reqFile); // skip request file header
-    int found = 0;
-    Request req;
+    load_requests();
+    STATS_TIME(STAT_VIEW_INBOX);
+    DonorInbox *inbox = find_inbox(donor_username, 0);
 
     printf("\nInbox - Pending Requests:\n");
     printf("-------------------------------------------------\n");
     printf("ReqID | ItemID | Recipient\n");
     printf("-------------------------------------------------\n");
 
-    while (fscanf(reqFile, "%d,%d,%20[^,],%20[^\n]\n",
-                  &req.request_id, &req.item_id,
-                  req.recipient_username, req.status) != EOF) {
-        if (strcmp(req.status, "pending") == 0) {
-            FILE *itemFile = fopen(ITEM_FILE_PATH, "r");
-            if (!itemFile) {
-                printf("Error: Unable to open items.txt.\n");
-                continue;
-            }
-            char itemHeader[100];
-            fgets(itemHeader, sizeof(itemHeader), itemFile); // skip item file header
-            Item item;
-            int donorMatch = 0;
-            while (fscanf(itemFile, "%d,%20[^,],%20[^,],%99[^,],%20[^,],%20[^\n]\n",
-                          &item.item_id, item.donor_username, item.category, item.description,
-                          item.condition, item.status) != EOF) {
-                if (item.item_id == req.item_id &&
-                    strcmp(item.donor_username, donor_username) == 0) {
-                    donorMatch = 1;
-                    break;
-                }
-            }
-            fclose(itemFile);
-
-            if (donorMatch) {
-                printf("%-6d| %-7d| %-20s\n",
-                       req.request_id, req.item_id, req.recipient_username);
-                found = 1;
-            }
-        }
-    }
-    fclose(reqFile);
-
-    if (!found) {
+    if (!inbox || inbox->pending_count == 0) {
         printf("No pending notifications.\n");
+        return;
+    }
+    for (int i = 0; i < inbox->pending_count; i++) {
+        Request *req = stored_request(inbox->pending[i]);
+        printf("%-6d| %-7d| %-20s\n",
+               req->request_id, req->item_id, req->recipient_username);
     }
 }
 
-// Counts how many pending requests belong to this donor
-int count_pending_requests(char *donor_username) {
-    FILE *reqFile = fopen(REQUEST_FILE_PATH, "r");
-    if (!reqFile) {
+// Calls visit for each pending request on this donor's items, oldest first
+int visit_inbox(const char *donor_username, RequestVisitor visit, void *context) {
+    load_requests();
+    STATS_TIME(STAT_VISIT_INBOX);
+    DonorInbox *inbox = find_inbox(donor_username, 0);
+    if (!inbox) {
         return 0;
     }
-    char header[100];
-    fgets(header, sizeof(header), reqFile); // skip request file header
-    int count = 0;
-    Request req;
-
-    while (fscanf(reqFile, "%d,%d,%20[^,],%20[^\n]\n",
-                  &req.request_id, &req.item_id,
-                  req.recipient_username, req.status) != EOF) {
-        if (strcmp(req.status, "pending") == 0) {
-            FILE *itemFile = fopen(ITEM_FILE_PATH, "r");
-            if (!itemFile) {
-                continue;
-            }
-            char itemHeader[100];
-            fgets(itemHeader, sizeof(itemHeader), itemFile); // skip item file header
-            Item item;
-            int donorMatch = 0;
-            while (fscanf(itemFile, "%d,%20[^,],%20[^,],%99[^,],%20[^,],%20[^\n]\n",
-                          &item.item_id, item.donor_username,
-                          item.category, item.description,
-                          item.condition, item.status) != EOF) {
-                if (item.item_id == req.item_id &&
-                    strcmp(item.donor_username, donor_username) == 0) {
-                    donorMatch = 1;
-                    break;
-                }
-            }
-            fclose(itemFile);
-            if (donorMatch) {
-                count++;
-            }
-        }
+    for (int i = 0; i < inbox->pending_count; i++) {
+        Request *req = stored_request(inbox->pending[i]);
+        visit(req, find_item(req->item_id), context);
     }
-    fclose(reqFile);
-    return count;
+    return inbox->pending_count;
+}
+
+// A number that goes up whenever the requests change (see requests.h)
+unsigned long requests_version() {
+    return store_version;
+}
+
+// Counts how many pending requests belong to this donor
+int count_pending_requests(char *donor_username) {
+    load_requests();
+    STATS_TIME(STAT_COUNT_PENDING_REQUESTS);
+    DonorInbox *inbox = find_inbox(donor_username, 0);
+    return inbox ? inbox->pending_count : 0;
 }
 
 // Shows items that have been approved for a given recipient
 void view_inventory(char *recipient_username) {
-    FILE *reqFile = fopen(REQUEST_FILE_PATH, "r");
-    if (!reqFile) {
-        printf("No inventory records available.\n");
-        return;
-    }
-    char header[100];
-    fgets(header, sizeof(header), reqFile); // skip request file header
+    load_requests();
+    STATS_TIME(STAT_VIEW_INVENTORY);
     int found = 0;
-    Request req;
 
     printf("\nYour Inventory (Approved Items):\n");
     printf("---------------------------------------------------------------\n");
     printf("ReqID | ItemID | Category         | Description\n");
     printf("---------------------------------------------------------------\n");
 
-    while (fscanf(reqFile, "%d,%d,%20[^,],%20[^\n]\n",
-                  &req.request_id, &req.item_id,
-                  req.recipient_username, req.status) != EOF) {
-        if (strcmp(req.status, "approved") == 0 &&
-            strcmp(req.recipient_username, recipient_username) == 0) {
-            FILE *itemFile = fopen(ITEM_FILE_PATH, "r");
-            if (!itemFile) {
-                continue;
-            }
-            char itemHeader[100];
-            fgets(itemHeader, sizeof(itemHeader), itemFile); // skip item file header
-            Item item;
-            int itemFound = 0;
-            while (fscanf(itemFile, "%d,%20[^,],%20[^,],%99[^,],%20[^,],%20[^\n]\n",
-                          &item.item_id, item.donor_username,
-                          item.category, item.description,
-                          item.condition, item.status) != EOF) {
-                if (item.item_id == req.item_id) {
-                    itemFound = 1;
-                    break;
-                }
-            }
-            fclose(itemFile);
-
-            if (itemFound) {
-                printf("%-6d| %-7d| %-17s| %s\n",
-                       req.request_id, req.item_id, item.category, item.description);
-                found = 1;
-            }
+    // Only this recipient's approved requests, each joined to its item by ID
+    Inventory *inventory = find_inventory(recipient_username, 0);
+    for (int i = 0; inventory && i < inventory->approved_count; i++) {
+        Request *req = stored_request(inventory->approved[i]);
+        Item *item = find_item(req->item_id);
+        if (item) {
+            printf("%-6d| %-7d| %-17s| %s\n",
+                   req->request_id, req->item_id, item_category(item), item->description);
+            found = 1;
         }
     }
-    fclose(reqFile);
 
     if (!found) {
         printf("Your inventory is empty.\n");
     }
-}
\ No newline at end of file
+}
+
+// Calls visit for each approved request (and its item) belonging to this recipient
+int visit_inventory(const char *recipient_username, RequestVisitor visit, void *context) {
+    load_requests();
+    STATS_TIME(STAT_VISIT_INVENTORY);
+    int visited = 0;
+    Inventory *inventory = find_inventory(recipient_username, 0);
+    for (int i = 0; inventory && i < inventory->approved_count; i++) {
+        Request *req = stored_request(inventory->approved[i]);
+        Item *item = find_item(req->item_id);
+        if (item) {
+            visit(req, item, context);
+            visited++;
+        }
+    }
+    return visited;
+}
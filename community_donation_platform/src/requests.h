@@ -19,22 +19,94 @@ typedef struct {
     int request_id;
     int item_id;
     char recipient_username[21]; 
-    char status[21]; // "pending", "approved", or "rejected"
+    unsigned short status; // STATUS_PENDING, STATUS_APPROVED or STATUS_REJECTED (see dictionary.h)
 } Request;
 
+// The request's status as text ("pending", "approved", ...)
+const char *request_status(const Request *req);
+
+// A function that gets called once per request (with the item it is for)
+typedef void (*RequestVisitor)(const Request *req, const Item *item, void *context);
+
+// Error codes returned by submit_request and decide_request (always below zero)
+#define REQUEST_NOT_FOUND -1         // no such request, or it isn't for this donor's item
+#define REQUEST_ITEM_UNAVAILABLE -2  // the item doesn't exist or isn't available
+#define REQUEST_BAD_DECISION -3      // decision wasn't "approve" or "reject"
+#define REQUEST_WRITE_FAILED -4      // couldn't write to the data files
+#define REQUEST_ALREADY_DECIDED -5   // the request was approved or rejected already
+#define REQUEST_OWN_ITEM -6          // the recipient donated the item themselves
+
+// Reads requests.txt into memory once (later calls do nothing) and builds the
+// per-donor pending-request index used by the inbox
+void load_requests();
+
+// Catches up with requests and decisions that other programs sharing the data folder
+// have written since we loaded (see refresh_items)
+void refresh_requests();
+
+// Finds a request by its ID, or returns NULL if it doesn't exist
+Request *find_request(int request_id);
+
+// Turns the current record of a CsvReader (see csv.h) reading requests.txt into a Request.
+// Returns 1 on success, 0 if the row doesn't have 4 fields or a field doesn't fit.
+int request_from_row(const CsvReader *reader, Request *req);
+
+// Writes a Request as one requests.txt row. Returns the bytes written, or -1 on error.
+int write_request_row(FILE *file, const Request *req);
+
 // Lets a recipient ask for an available item
 void request_item(char *recipient_username);
 
-// Lets a donor approve or reject an item request
+// Files a request for an item without asking anything.
+// Returns the new request_id, or a REQUEST_* error code.
+int submit_request(const char *recipient_username, int item_id);
+
+// Lets a donor approve or reject an item request (or several at once)
 void approve_request(char *donor_username);
 
+// Approves ("approve") or rejects ("reject") one of this donor's requests without
+// asking anything. Returns 0 on success, or a REQUEST_* error code.
+int decide_request(const char *donor_username, int request_id, const char *decision);
+
+// One decision in a batch for decide_requests
+typedef struct {
+    int request_id;
+    char decision[10];   // "approve" or "reject"
+    int result;          // set by decide_requests: 0 if applied, or a REQUEST_* error code
+    int competing_rejected;  // set by decide_requests: other requests for the same item
+                             // that an approval rejected automatically
+} Decision;
+
+// Applies several of this donor's decisions at once. Each one is checked against the latest
+// data and against the decisions before it in the list (a request is decided once, an item
+// is given away once); the ones that pass are written as a single group, so they all take
+// effect or, if the write fails, none do. Fills in each result. Returns how many were
+// applied, or REQUEST_WRITE_FAILED.
+// Approving a request also rejects every other pending request for the same item, in the
+// same group, since the item can only go to one recipient.
+int decide_requests(const char *donor_username, Decision *decisions, int count);
+
+// First come, first served: approves the oldest pending request for one of this donor's
+// items (and rejects the rest). Returns the approved request_id, or a REQUEST_* error code.
+int allocate_item(const char *donor_username, int item_id);
+
 // Shows the donor all the pending requests for their items
 void view_inbox(char *donor_username);
 
-// Counts how many pending requests belong to a specific donor
+// Counts how many pending requests belong to a specific donor (kept up to date in memory)
 int count_pending_requests(char *donor_username);
 
+// A number that goes up whenever a request is added, changes status or is reloaded, in
+// this program or picked up from others. Anything worked out from the requests (like the
+// inbox badge) is still correct as long as this hasn't changed.
+unsigned long requests_version();
+
 // Shows a recipient all items that have been approved for them
 void view_inventory(char *recipient_username);
 
+// Call visit(req, item, context) for each of a donor's pending requests, or for each
+// item approved for a recipient. Both return how many requests were visited.
+int visit_inbox(const char *donor_username, RequestVisitor visit, void *context);
+int visit_inventory(const char *recipient_username, RequestVisitor visit, void *context);
+
 #endif /* REQUESTS_H */
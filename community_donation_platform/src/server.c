@@ -0,0 +1,340 @@
+// server.c
+// The accept loop hands each new connection to a small queue, and a fixed pool of worker
+// threads takes connections off the queue and serves them one line at a time. A client
+// that sends nothing for IDLE_TIMEOUT seconds is dropped, freeing its worker.
+//
+// All workers share one copy of the data, guarded by a reader/writer lock:
+//   - commands that only read (list, search, inbox, count, inventory, wishlists, stats, help)
+//     take the lock for reading, so any number of them run at the same time;
+//   - commands that change data (signup, login, add_item, request, approve, reject, wish,
+//     unwish, and notifications, which marks them seen) take it
+//     for writing, so they run one at a time and never while a read is in progress. These
+//     also catch up with anything other programs sharing the data folder have written.
+//   - when data_watch.h notices that another program changed the data folder, the next
+//     command takes the lock for writing and catches up first, whatever it is. A write
+//     takes in its own changes to the files before letting go of the lock, so they
+//     don't make the reads after it catch up as well.
+// A write is only acknowledged once it is on disk. Workers flush after letting go of the
+// lock, and share flushes with each other (see durable.h), so waiting for the disk
+// doesn't hold up the next write.
+// Each connection has its own Session, and the server requires login: a client can only
+// add items, request, approve or look at inboxes as the user it logged in as.
+
+// pthread_rwlockattr_setkind_np (glibc) lets us make waiting writers go first
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "server.h"
+
+#ifdef _WIN32
+
+int run_server(const char *address, int workers) {
+    (void)address;
+    (void)workers;
+    printf("Error: Server mode isn't available on Windows.\n");
+    return 1;
+}
+
+#else
+
+#include "batch.h"
+#include "user.h"
+#include "items.h"
+#include "requests.h"
+#include "wishlist.h"
+#include "stats.h"
+#include "durable.h"
+#include "data_watch.h"
+#include <pthread.h>
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define MAX_WORKERS 256
+#define QUEUE_SIZE 128   // connections waiting for a free worker
+#define MAX_LINE 512
+#define IDLE_TIMEOUT 30  // seconds a client may keep a worker waiting before it is dropped
+
+// Connections waiting to be served (a ring buffer of socket descriptors)
+static int waiting[QUEUE_SIZE];
+static int waiting_head = 0;
+static int waiting_count = 0;
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_not_empty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t queue_not_full = PTHREAD_COND_INITIALIZER;
+
+// Guards every item, request and user in memory (set up in init_data_lock)
+static pthread_rwlock_t data_lock;
+
+// Set by the signal handler to stop the accept loop
+static volatile sig_atomic_t stopping = 0;
+
+static void handle_stop(int signal_number) {
+    (void)signal_number;
+    stopping = 1;
+}
+
+// Sets up the data lock. By default glibc lets new readers in while a writer is waiting,
+// so a steady stream of reads could keep a write waiting forever; where we can, we ask for
+// waiting writers to go first instead.
+static void init_data_lock() {
+    pthread_rwlockattr_t attributes;
+    pthread_rwlockattr_init(&attributes);
+#ifdef PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP
+    pthread_rwlockattr_setkind_np(&attributes, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+    pthread_rwlock_init(&data_lock, &attributes);
+    pthread_rwlockattr_destroy(&attributes);
+}
+
+// Adds a connection to the queue, waiting if every slot is taken
+static void push_connection(int fd) {
+    pthread_mutex_lock(&queue_lock);
+    while (waiting_count == QUEUE_SIZE) {
+        pthread_cond_wait(&queue_not_full, &queue_lock);
+    }
+    waiting[(waiting_head + waiting_count) % QUEUE_SIZE] = fd;
+    waiting_count++;
+    pthread_cond_signal(&queue_not_empty);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+// Takes the oldest connection off the queue, waiting until there is one
+static int pop_connection() {
+    pthread_mutex_lock(&queue_lock);
+    while (waiting_count == 0) {
+        pthread_cond_wait(&queue_not_empty, &queue_lock);
+    }
+    int fd = waiting[waiting_head];
+    waiting_head = (waiting_head + 1) % QUEUE_SIZE;
+    waiting_count--;
+    pthread_cond_signal(&queue_not_full);
+    pthread_mutex_unlock(&queue_lock);
+    return fd;
+}
+
+// Serves one client until it says "quit", hangs up, or sends nothing for IDLE_TIMEOUT
+// seconds (so a few idle clients can't keep every worker to themselves)
+static void serve_connection(int fd) {
+    // Reading or writing gives up after the timeout, and the connection is closed
+    struct timeval timeout = { IDLE_TIMEOUT, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    int out_fd = dup(fd);
+    FILE *in = fdopen(fd, "r");
+    FILE *out = out_fd >= 0 ? fdopen(out_fd, "w") : NULL;
+    if (!in || !out) {
+        if (in) {
+            fclose(in);
+        } else {
+            close(fd);
+        }
+        if (out) {
+            fclose(out);
+        } else if (out_fd >= 0) {
+            close(out_fd);
+        }
+        return;
+    }
+
+    Session session;
+    memset(&session, 0, sizeof(session));
+    session.require_login = 1;
+
+    char line[MAX_LINE];
+    int got;
+    while ((got = read_command_line(in, line, sizeof(line))) != 0) {
+        if (got == LINE_TOO_LONG) {
+            // Never run what is left of a line that didn't fit as a command of its own
+            fprintf(out, "error line too long\n");
+            if (fflush(out) != 0) {
+                break;
+            }
+            continue;
+        }
+        int writes = is_write_command(line);
+        if (writes) {
+            pthread_rwlock_wrlock(&data_lock);
+        } else {
+            pthread_rwlock_rdlock(&data_lock);
+        }
+        // Asked while holding the lock, so none of our own writes is half done and
+        // anything reported was written by another program. Catching up changes data,
+        // so a read has to trade its lock for the write lock first.
+        int catch_up = data_watch_changed();
+        if (catch_up && !writes) {
+            pthread_rwlock_unlock(&data_lock);
+            pthread_rwlock_wrlock(&data_lock);
+        }
+        if (catch_up) {
+            refresh_data();
+        }
+        int result = run_command(line, out, &session);
+        // Take in what this command wrote before letting go, so the changes it made to the
+        // files aren't reported to the next command as if another program had made them
+        if (writes && data_watch_changed()) {
+            refresh_data();
+        }
+        pthread_rwlock_unlock(&data_lock);
+        if (writes && !wait_durable()) {
+            printf("Error: Unable to flush a write to disk.\n");
+        }
+
+        // Send the reply once the lock is released, so a slow client can't hold it up
+        if (fflush(out) != 0 || result == BATCH_QUIT) {
+            break;
+        }
+    }
+    if (ferror(in) && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        fprintf(out, "error idle timeout\n");
+    }
+    fclose(in);
+    fclose(out);
+}
+
+static void *worker_main(void *unused) {
+    (void)unused;
+    for (;;) {
+        serve_connection(pop_connection());
+    }
+    return NULL;
+}
+
+// Opens the listening socket: a TCP port on 127.0.0.1 if address is all digits,
+// otherwise a Unix socket at that path. Returns the socket, or -1 on error.
+static int open_listener(const char *address) {
+    int is_port = address[0] != '\0' && strspn(address, "0123456789") == strlen(address);
+    int fd;
+    if (is_port) {
+        int port = atoi(address);
+        if (port <= 0 || port > 65535) {
+            printf("Error: %s is not a valid port.\n", address);
+            return -1;
+        }
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((unsigned short)port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            return -1;
+        }
+    } else {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(address) >= sizeof(addr.sun_path)) {
+            printf("Error: Socket path %s is too long.\n", address);
+            return -1;
+        }
+        strcpy(addr.sun_path, address);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        unlink(address);  // remove a socket file left over from an earlier run
+        if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    if (listen(fd, QUEUE_SIZE) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int run_server(const char *address, int workers) {
+    if (workers < 1 || workers > MAX_WORKERS) {
+        printf("Error: The number of workers must be between 1 and %d.\n", MAX_WORKERS);
+        return 1;
+    }
+
+    // Everything is loaded (and the filter columns started) before any worker starts, so
+    // workers only ever read or change data that is already in memory
+    load_users();
+    load_items();
+    load_requests();
+    load_wishlists();
+    use_item_columns();
+
+    init_data_lock();
+    defer_durability(1);
+    int listener = open_listener(address);
+    if (listener < 0) {
+        printf("Error: Unable to listen on %s.\n", address);
+        return 1;
+    }
+
+    // A client hanging up mid-reply shouldn't kill the server. SIGINT/SIGTERM stop the
+    // accept loop (no SA_RESTART, so a blocked accept returns with EINTR).
+    signal(SIGPIPE, SIG_IGN);
+    struct sigaction stop_action;
+    memset(&stop_action, 0, sizeof(stop_action));
+    stop_action.sa_handler = handle_stop;
+    sigemptyset(&stop_action.sa_mask);
+    sigaction(SIGINT, &stop_action, NULL);
+    sigaction(SIGTERM, &stop_action, NULL);
+    // SIGUSR1 dumps the call counters to stderr, also from the accept loop
+    stats_install_signal(1);
+
+    // Workers start with these signals blocked (threads inherit the mask), so they are
+    // always delivered to this thread and wake up its accept
+    sigset_t accept_signals, old_mask;
+    sigemptyset(&accept_signals);
+    sigaddset(&accept_signals, SIGINT);
+    sigaddset(&accept_signals, SIGTERM);
+    sigaddset(&accept_signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &accept_signals, &old_mask);
+
+    for (int i = 0; i < workers; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, worker_main, NULL) != 0) {
+            printf("Error: Unable to start worker thread.\n");
+            close(listener);
+            return 1;
+        }
+        pthread_detach(thread);
+    }
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+    printf("Serving on %s with %d workers.\n", address, workers);
+    fflush(stdout);
+
+    while (!stopping) {
+        stats_poll();
+        int client = accept(listener, NULL, NULL);
+        if (client < 0) {
+            if (errno != EINTR) {
+                printf("Error: accept failed.\n");
+            }
+            continue;
+        }
+        push_connection(client);
+    }
+
+    close(listener);
+    if (address[strspn(address, "0123456789")] != '\0') {
+        unlink(address);
+    }
+    // Wait for any write in progress to finish, then exit with the lock held so no new
+    // write can start while the process shuts down
+    pthread_rwlock_wrlock(&data_lock);
+    printf("Server stopped.\n");
+    return 0;
+}
+
+#endif
@@ -0,0 +1,24 @@
+// server.h
+// Server mode: lets many people use the platform at once. The program listens on a local
+// TCP port or a Unix socket and speaks the same one-command-per-line protocol as batch mode
+// (see batch.c). A fixed pool of worker threads serves the connections, all sharing the
+// same in-memory items, requests and users. Run it with:
+//   ./donation_platform --serve 5000                  (TCP port on 127.0.0.1)
+//   ./donation_platform --serve /tmp/donations.sock   (Unix socket)
+//   ./donation_platform --serve 5000 --workers 16
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// How many worker threads serve connections if --workers isn't given
+#define DEFAULT_WORKERS 8
+
+// Starts listening on address (a port number, or a path for a Unix socket) and serves
+// clients until the process gets SIGINT or SIGTERM. Returns 0 on a clean stop, 1 on error.
+int run_server(const char *address, int workers);
+
+#endif /* SERVER_H */
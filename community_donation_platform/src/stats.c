@@ -0,0 +1,301 @@
+// stats.c
+// Each operation has a fixed slot of counters. Finishing a call adds to them with atomic
+// additions (several server threads can finish calls at once), so nothing ever waits on
+// a lock and the cost per call is two clock reads and a handful of additions.
+//
+// Latencies go into a histogram instead of being stored one by one: bucket boundaries
+// double every 4 buckets (1, 2, 3, 4, 5, 6, 7, 8, 10, 12, 14, 16, 20, ... nanoseconds),
+// so p50 and p99 are read off the buckets to within about 20%, in constant memory.
+//
+// File activity is counted per thread. A timer remembers the thread's counts when it
+// starts, and the difference when it stops is what that call did.
+
+#include "stats.h"
+#include <signal.h>
+#include <time.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#define SUB_BUCKETS 4                    // buckets per doubling
+#define STATS_BUCKETS (SUB_BUCKETS * 44) // up to 2^44 ns, about 5 hours
+
+typedef struct {
+    long long calls;
+    long long total_ns;
+    long long max_ns;
+    StatsIo io;
+    long long buckets[STATS_BUCKETS];
+} OperationStats;
+
+// Same order as the STAT_* numbers in stats.h
+static const char *operation_names[STAT_OPERATIONS] = {
+    "signup", "login", "load_users", "find_user", "save_user", "validate_credentials",
+    "load_items", "refresh_items", "find_item", "find_indexed_item", "count_available_items",
+    "add_item", "create_item", "display_items", "search_items", "show_category",
+    "show_keyword_search", "visit_keyword_matches", "visit_available_items",
+    "visit_filtered_items", "get_category_selection",
+    "update_status",
+    "load_requests", "refresh_requests", "find_request", "find_indexed_request", "request_item",
+    "submit_request", "approve_request", "decide_request", "decide_requests", "allocate_item",
+    "view_inbox", "count_pending_requests", "view_inventory", "visit_inbox", "visit_inventory",
+    "load_wishlists", "refresh_wishlists", "add_wishlist", "cancel_wishlist", "visit_wishlists",
+    "visit_wishlist_matches", "notify_wishlists", "count_new_notifications",
+    "visit_new_notifications", "manage_wishlists", "view_notifications"
+};
+
+static OperationStats operations[STAT_OPERATIONS];
+static StatsIo totals;                  // all file activity, inside an operation or not
+static _Thread_local StatsIo thread_io; // this thread's file activity so far
+
+// Adds to a counter that other threads may be adding to at the same time
+static void add_counter(long long *counter, long long amount) {
+#if defined(__GNUC__)
+    __atomic_fetch_add(counter, amount, __ATOMIC_RELAXED);
+#else
+    *counter += amount;
+#endif
+}
+
+// Raises a counter to value if value is bigger
+static void raise_counter(long long *counter, long long value) {
+#if defined(__GNUC__)
+    long long seen = __atomic_load_n(counter, __ATOMIC_RELAXED);
+    while (value > seen &&
+           !__atomic_compare_exchange_n(counter, &seen, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+#else
+    if (value > *counter) {
+        *counter = value;
+    }
+#endif
+}
+
+// Current time in nanoseconds (only differences matter)
+static long long now_ns() {
+    struct timespec ts;
+#ifdef _WIN32
+    timespec_get(&ts, TIME_UTC);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Which histogram bucket a latency falls in
+static int bucket_of(long long ns) {
+    if (ns < SUB_BUCKETS) {
+        return ns < 0 ? 0 : (int)ns;
+    }
+    int top_bit = 0;  // position of the highest set bit
+#if defined(__GNUC__)
+    top_bit = 63 - __builtin_clzll((unsigned long long)ns);
+#else
+    while ((ns >> (top_bit + 1)) != 0) {
+        top_bit++;
+    }
+#endif
+    int sub = (int)((ns >> (top_bit - 2)) & (SUB_BUCKETS - 1));
+    int bucket = (top_bit - 1) * SUB_BUCKETS + sub;
+    return bucket < STATS_BUCKETS ? bucket : STATS_BUCKETS - 1;
+}
+
+// The first latency past a bucket (its upper edge)
+static long long bucket_end(int bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket + 1;
+    }
+    int top_bit = bucket / SUB_BUCKETS + 1;
+    int sub = bucket % SUB_BUCKETS;
+    return (long long)(SUB_BUCKETS + sub + 1) << (top_bit - 2);
+}
+
+StatsTimer stats_start(int operation) {
+    StatsTimer timer;
+    timer.operation = operation;
+    timer.io_at_start = thread_io;
+    timer.start_ns = now_ns();
+    return timer;
+}
+
+void stats_stop(StatsTimer *timer) {
+    long long elapsed = now_ns() - timer->start_ns;
+    OperationStats *op = &operations[timer->operation];
+    add_counter(&op->calls, 1);
+    add_counter(&op->total_ns, elapsed);
+    add_counter(&op->buckets[bucket_of(elapsed)], 1);
+    raise_counter(&op->max_ns, elapsed);
+
+    // Only touch the shared I/O counters if this call did any I/O
+    StatsIo *start = &timer->io_at_start;
+    if (thread_io.opens != start->opens || thread_io.bytes_read != start->bytes_read ||
+        thread_io.bytes_written != start->bytes_written || thread_io.records != start->records) {
+        add_counter(&op->io.opens, thread_io.opens - start->opens);
+        add_counter(&op->io.bytes_read, thread_io.bytes_read - start->bytes_read);
+        add_counter(&op->io.bytes_written, thread_io.bytes_written - start->bytes_written);
+        add_counter(&op->io.records, thread_io.records - start->records);
+    }
+}
+
+void stats_opened() {
+    thread_io.opens++;
+    add_counter(&totals.opens, 1);
+}
+
+void stats_read(long long bytes, long long records) {
+    thread_io.bytes_read += bytes;
+    thread_io.records += records;
+    add_counter(&totals.bytes_read, bytes);
+    add_counter(&totals.records, records);
+}
+
+void stats_written(long long bytes) {
+    thread_io.bytes_written += bytes;
+    add_counter(&totals.bytes_written, bytes);
+}
+
+FILE *stats_fopen(const char *path, const char *mode) {
+    FILE *file = fopen(path, mode);
+    if (file) {
+        stats_opened();
+    }
+    return file;
+}
+
+// Estimates a percentile (0.5 for p50) from an operation's histogram, in microseconds.
+// Uses the nearest rank: the smallest latency that at least p of the calls didn't exceed.
+static double percentile_us(const OperationStats *op, double p) {
+    long long count = 0;
+    for (int b = 0; b < STATS_BUCKETS; b++) {
+        count += op->buckets[b];
+    }
+    if (count == 0) {
+        return 0;
+    }
+    long long rank = (long long)(p * count);
+    if ((double)rank < p * count) {
+        rank++;  // round up
+    }
+    if (rank < 1) {
+        rank = 1;
+    }
+    long long seen = 0;
+    for (int b = 0; b < STATS_BUCKETS; b++) {
+        seen += op->buckets[b];
+        if (seen >= rank) {
+            long long end = bucket_end(b);
+            return (end < op->max_ns ? end : op->max_ns) / 1000.0;
+        }
+    }
+    return op->max_ns / 1000.0;
+}
+
+void stats_dump(FILE *out, int json) {
+    if (json) {
+        fprintf(out, "{\"operations\": [");
+    } else {
+        fprintf(out, "%-24s %9s %10s %10s %10s %10s %8s %10s %10s %9s\n",
+                "operation", "calls", "mean_us", "p50_us", "p99_us", "max_us",
+                "opens", "read_B", "written_B", "records");
+        fprintf(out, "%-24s %9s %10s %10s %10s %10s %8s %10s %10s %9s\n",
+                "", "", "", "", "", "", "per call", "per call", "per call", "per call");
+    }
+    int printed = 0;
+    for (int i = 0; i < STAT_OPERATIONS; i++) {
+        const OperationStats *op = &operations[i];
+        long long calls = op->calls;
+        if (calls == 0) {
+            continue;
+        }
+        double mean_us = op->total_ns / 1000.0 / calls;
+        if (json) {
+            fprintf(out, "%s\n  {\"name\": \"%s\", \"calls\": %lld, \"mean_us\": %.2f, "
+                         "\"p50_us\": %.2f, \"p99_us\": %.2f, \"max_us\": %.2f, "
+                         "\"opens\": %lld, \"bytes_read\": %lld, \"bytes_written\": %lld, "
+                         "\"records\": %lld}",
+                    printed ? "," : "", operation_names[i], calls, mean_us,
+                    percentile_us(op, 0.5), percentile_us(op, 0.99), op->max_ns / 1000.0,
+                    op->io.opens, op->io.bytes_read, op->io.bytes_written, op->io.records);
+        } else {
+            fprintf(out, "%-24s %9lld %10.2f %10.2f %10.2f %10.2f %8.2f %10.1f %10.1f %9.1f\n",
+                    operation_names[i], calls, mean_us, percentile_us(op, 0.5),
+                    percentile_us(op, 0.99), op->max_ns / 1000.0,
+                    (double)op->io.opens / calls, (double)op->io.bytes_read / calls,
+                    (double)op->io.bytes_written / calls, (double)op->io.records / calls);
+        }
+        printed++;
+    }
+    if (json) {
+        fprintf(out, "%s],\n \"totals\": {\"opens\": %lld, \"bytes_read\": %lld, "
+                     "\"bytes_written\": %lld, \"records\": %lld}}\n",
+                printed ? "\n" : "", totals.opens, totals.bytes_read, totals.bytes_written,
+                totals.records);
+    } else {
+        fprintf(out, "total: %lld opens, %lld bytes read, %lld bytes written, %lld records\n",
+                totals.opens, totals.bytes_read, totals.bytes_written, totals.records);
+    }
+}
+
+// Set by the SIGUSR1 handler, checked by stats_poll
+static volatile sig_atomic_t dump_requested = 0;
+
+#if defined(SIGUSR1) && !defined(_WIN32)
+static void handle_dump_signal(int signal_number) {
+    (void)signal_number;
+    dump_requested = 1;
+}
+#endif
+
+void stats_install_signal(int interrupt_calls) {
+#if defined(SIGUSR1) && !defined(_WIN32)
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_dump_signal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = interrupt_calls ? 0 : SA_RESTART;
+    sigaction(SIGUSR1, &action, NULL);
+#else
+    (void)interrupt_calls;
+#endif
+}
+
+void stats_poll() {
+    if (dump_requested) {
+        dump_requested = 0;
+        stats_dump(stderr, 0);
+        fflush(stderr);
+    }
+}
+
+#if defined(SIGUSR1) && !defined(_WIN32)
+// Dumps once per SIGUSR1. The counters are only ever added to atomically, so reading them
+// while the main thread works is fine.
+static void *dump_on_signal(void *signals) {
+    for (;;) {
+        int signal_number;
+        if (sigwait((sigset_t *)signals, &signal_number) == 0) {
+            stats_dump(stderr, 0);
+            fflush(stderr);
+        }
+    }
+    return NULL;
+}
+#endif
+
+void stats_start_signal_thread() {
+#if defined(SIGUSR1) && !defined(_WIN32)
+    // Block SIGUSR1 here, so every thread started from now on leaves it to sigwait
+    static sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, dump_on_signal, &signals) == 0) {
+        pthread_detach(thread);
+    } else {
+        // No thread: fall back to dumping between commands
+        pthread_sigmask(SIG_UNBLOCK, &signals, NULL);
+        stats_install_signal(0);
+    }
+#endif
+}
@@ -0,0 +1,126 @@
+// stats.h
+// Built-in counters for the platform: for each public function in user.c, items.c,
+// requests.c and wishlist.c we count calls, keep a latency histogram (for p50/p99) and the slowest call,
+// and add up the data files opened, bytes read and written and records parsed while it ran.
+// The numbers can be dumped at any time as text or JSON: send the process SIGUSR1, or use
+// the "stats" command in batch/server mode.
+//
+// Everything is a few additions to counters in memory, so it is always on.
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The operations we time. Keep stats.c's operation_names in the same order.
+enum {
+    // user.c
+    STAT_SIGNUP,
+    STAT_LOGIN,
+    STAT_LOAD_USERS,
+    STAT_FIND_USER,
+    STAT_SAVE_USER,
+    STAT_VALIDATE_CREDENTIALS,
+    // items.c
+    STAT_LOAD_ITEMS,
+    STAT_REFRESH_ITEMS,
+    STAT_FIND_ITEM,
+    STAT_FIND_INDEXED_ITEM,
+    STAT_COUNT_AVAILABLE_ITEMS,
+    STAT_ADD_ITEM,
+    STAT_CREATE_ITEM,
+    STAT_DISPLAY_ITEMS,
+    STAT_SEARCH_ITEMS,
+    STAT_SHOW_CATEGORY,
+    STAT_SHOW_KEYWORD_SEARCH,
+    STAT_VISIT_KEYWORD_MATCHES,
+    STAT_VISIT_AVAILABLE_ITEMS,
+    STAT_VISIT_FILTERED_ITEMS,
+    STAT_GET_CATEGORY_SELECTION,
+    STAT_UPDATE_STATUS,
+    // requests.c
+    STAT_LOAD_REQUESTS,
+    STAT_REFRESH_REQUESTS,
+    STAT_FIND_REQUEST,
+    STAT_FIND_INDEXED_REQUEST,
+    STAT_REQUEST_ITEM,
+    STAT_SUBMIT_REQUEST,
+    STAT_APPROVE_REQUEST,
+    STAT_DECIDE_REQUEST,
+    STAT_DECIDE_REQUESTS,
+    STAT_ALLOCATE_ITEM,
+    STAT_VIEW_INBOX,
+    STAT_COUNT_PENDING_REQUESTS,
+    STAT_VIEW_INVENTORY,
+    STAT_VISIT_INBOX,
+    STAT_VISIT_INVENTORY,
+
+    STAT_LOAD_WISHLISTS,
+    STAT_REFRESH_WISHLISTS,
+    STAT_ADD_WISHLIST,
+    STAT_CANCEL_WISHLIST,
+    STAT_VISIT_WISHLISTS,
+    STAT_VISIT_WISHLIST_MATCHES,
+    STAT_NOTIFY_WISHLISTS,
+    STAT_COUNT_NEW_NOTIFICATIONS,
+    STAT_VISIT_NEW_NOTIFICATIONS,
+    STAT_MANAGE_WISHLISTS,
+    STAT_VIEW_NOTIFICATIONS,
+    STAT_OPERATIONS
+};
+
+// File activity, counted per thread while an operation runs
+typedef struct {
+    long long opens;
+    long long bytes_read;
+    long long bytes_written;
+    long long records;
+} StatsIo;
+
+// One running measurement (see STATS_TIME)
+typedef struct {
+    int operation;
+    long long start_ns;
+    StatsIo io_at_start;
+} StatsTimer;
+
+StatsTimer stats_start(int operation);
+void stats_stop(StatsTimer *timer);
+
+// Put STATS_TIME(STAT_...) at the top of a function to time it up to whichever return it
+// takes. GCC and Clang run stats_stop when the timer goes out of scope; other compilers
+// simply don't time anything.
+#if defined(__GNUC__)
+#define STATS_TIME(operation) \
+    StatsTimer stats_timer __attribute__((cleanup(stats_stop))) = stats_start(operation)
+#else
+#define STATS_TIME(operation) ((void)0)
+#endif
+
+// Record file activity (it is added to whatever operations are running on this thread)
+void stats_opened();
+void stats_read(long long bytes, long long records);
+void stats_written(long long bytes);
+
+// fopen that counts the open when it succeeds
+FILE *stats_fopen(const char *path, const char *mode);
+
+// Writes every operation that has been called, plus the totals, as a text table
+// (json = 0) or a JSON object (json = 1)
+void stats_dump(FILE *out, int json);
+
+// Makes SIGUSR1 ask for a text dump to stderr (there's no SIGUSR1 on Windows). The dump
+// happens at the next stats_poll, since printing inside a signal handler isn't safe.
+// With interrupt_calls set, blocking calls like accept() return early (EINTR) when the
+// signal arrives, so a loop waiting in one can poll right away.
+void stats_install_signal(int interrupt_calls);
+void stats_poll();
+
+// For programs that spend most of their time waiting for input (the menus, batch mode):
+// a thread of its own waits for SIGUSR1 and dumps right away, so a program blocked
+// reading a line still answers. Call it before starting any other thread.
+void stats_start_signal_thread();
+
+#endif /* STATS_H */
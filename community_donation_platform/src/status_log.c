@@ -0,0 +1,357 @@
+// status_log.c
+// Keeps status changes in a small append-only log (status_log.txt) so that flipping one
+// item or request status costs a single short append instead of a full-file rewrite.
+// Each line is "I,<item_id>,<status>", "R,<request_id>,<status>" or "W,<wishlist_id>,<status>",
+// and a group of changes ends with a "commit,<count>" line. Changes that aren't covered by a
+// commit line (for example if the program crashed halfway through writing) are ignored when
+// the log is replayed.
+
+#include "status_log.h"
+#include "items.h"      // For ITEM_FILE_PATH
+#include "requests.h"   // For REQUEST_FILE_PATH
+#include "wishlist.h"   // For WISHLIST_FILE_PATH
+#include "binary_table.h" // For refreshing items.bin / requests.bin
+#include "id_index.h"   // For keeping items.idx / requests.idx in step
+#include "file_lock.h"  // For sharing the log with other programs
+#include "stats.h"      // For counting file activity
+#include "durable.h"    // For crash-safe writes
+#include "csv.h"        // For reading the log and the data files
+#include <sys/stat.h>   // For checking file sizes
+
+// One status change
+typedef struct {
+    char table;       // 'I' for items, 'R' for requests
+    int id;
+    char status[21];
+    int seq;          // position in the log, so the newest change wins
+} StatusEntry;
+
+// Changes waiting for the next commit_status_log call
+static StatusEntry *queued = NULL;
+static int queued_count = 0;
+static int queued_capacity = 0;
+
+// Adds a change to the queue
+static void queue_status(char table, int id, const char *new_status) {
+    if (queued_count == queued_capacity) {
+        int new_capacity = queued_capacity ? queued_capacity * 2 : 8;
+        StatusEntry *bigger = realloc(queued, sizeof(StatusEntry) * new_capacity);
+        if (!bigger) {
+            printf("Error: Not enough memory to record a status change.\n");
+            return;
+        }
+        queued = bigger;
+        queued_capacity = new_capacity;
+    }
+    StatusEntry *entry = &queued[queued_count++];
+    entry->table = table;
+    entry->id = id;
+    strncpy(entry->status, new_status, sizeof(entry->status) - 1);
+    entry->status[sizeof(entry->status) - 1] = '\0';
+}
+
+void log_item_status(int item_id, const char *new_status) {
+    queue_status('I', item_id, new_status);
+}
+
+void log_request_status(int request_id, const char *new_status) {
+    queue_status('R', request_id, new_status);
+}
+
+void log_wishlist_status(int wishlist_id, const char *new_status) {
+    queue_status('W', wishlist_id, new_status);
+}
+
+// Size of a file in bytes, or 0 if it doesn't exist
+static long file_size(const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return 0;
+    }
+    return (long)st.st_size;
+}
+
+// Checks whether the log is big enough (compared to the data files) to be worth compacting
+static int log_needs_compaction() {
+    long log_bytes = file_size(STATUS_LOG_PATH);
+    if (log_bytes < STATUS_LOG_MIN_COMPACT_BYTES) {
+        return 0;
+    }
+    long data_bytes = file_size(ITEM_FILE_PATH) + file_size(REQUEST_FILE_PATH) +
+                      file_size(WISHLIST_FILE_PATH);
+    return log_bytes * 4 >= data_bytes;
+}
+
+int commit_status_log() {
+    if (queued_count == 0) {
+        return 1;
+    }
+
+    // Build the whole group in memory so it goes out in a single write
+    size_t size = (size_t)queued_count * 40 + 32;
+    char *buffer = malloc(size);
+    if (!buffer) {
+        printf("Error: Not enough memory to record a status change.\n");
+        queued_count = 0;
+        return 0;
+    }
+    size_t used = 0;
+    for (int i = 0; i < queued_count; i++) {
+        used += (size_t)snprintf(buffer + used, size - used, "%c,%d,%s\n",
+                                 queued[i].table, queued[i].id, queued[i].status);
+    }
+    used += (size_t)snprintf(buffer + used, size - used, "commit,%d\n", queued_count);
+    queued_count = 0;
+
+    lock_data(LOCK_STATUS_LOG, 1);
+    FILE *file = stats_fopen(STATUS_LOG_PATH, "a");
+    if (!file) {
+        printf("Error: Unable to open status_log.txt for writing.\n");
+        unlock_data(LOCK_STATUS_LOG);
+        free(buffer);
+        return 0;
+    }
+    int ok = fwrite(buffer, 1, used, file) == used;
+    if (!close_durably(file)) {
+        ok = 0;
+    }
+    stats_written((long long)used);
+    free(buffer);
+    if (!ok) {
+        printf("Error: Unable to write to status_log.txt.\n");
+        unlock_data(LOCK_STATUS_LOG);
+        return 0;
+    }
+
+    if (log_needs_compaction()) {
+        compact_status_log();
+    }
+    unlock_data(LOCK_STATUS_LOG);
+    return 1;
+}
+
+// Reads every committed change in the log from byte *offset on, and moves *offset past
+// the last commit line. Returns how many were found (0 if no log). The caller frees *entries.
+static int read_committed_entries(StatusEntry **entries, long *offset) {
+    *entries = NULL;
+    FILE *file = stats_fopen(STATUS_LOG_PATH, "rb");  // binary, so offsets are exact byte counts
+    if (!file) {
+        return 0;
+    }
+    if (*offset > 0 && fseek(file, *offset, SEEK_SET) != 0) {
+        fclose(file);
+        return 0;
+    }
+
+    CsvReader reader;
+    if (!csv_open(&reader, file, "status_log.txt")) {
+        fclose(file);
+        return 0;
+    }
+    // A line cut short by a crash is expected here, so don't report it, just skip it
+    reader.keep_malformed = 1;
+
+    StatusEntry *list = NULL;
+    int count = 0, capacity = 0, lines = 0;
+    int committed = 0;  // entries before this index belong to a finished group
+    long start = *offset;
+    while (csv_next(&reader)) {
+        int group_size;
+        if (reader.field_count == 2 && strcmp(reader.fields[0], "commit") == 0 &&
+            csv_int(&reader, 1, &group_size)) {
+            // The group is the last group_size entries. Anything between the previous
+            // commit and this group is left over from an interrupted write, so drop it.
+            if (group_size >= 0 && group_size <= count - committed) {
+                memmove(&list[committed], &list[count - group_size],
+                        sizeof(StatusEntry) * group_size);
+                committed += group_size;
+            }
+            count = committed;
+            *offset = (long)reader.offset;
+            continue;
+        }
+
+        StatusEntry entry;
+        if (reader.field_count != 3 || strlen(reader.fields[0]) != 1 ||
+            !csv_int(&reader, 1, &entry.id) ||
+            !csv_copy(&reader, 2, entry.status, sizeof(entry.status))) {
+            continue;  // skip anything we don't understand
+        }
+        entry.table = reader.fields[0][0];
+        entry.seq = lines++;
+        if (count == capacity) {
+            int new_capacity = capacity ? capacity * 2 : 64;
+            StatusEntry *bigger = realloc(list, sizeof(StatusEntry) * new_capacity);
+            if (!bigger) {
+                break;
+            }
+            list = bigger;
+            capacity = new_capacity;
+        }
+        list[count++] = entry;
+    }
+    stats_read(reader.offset - start, lines);
+    csv_close(&reader);
+    fclose(file);
+
+    *entries = list;
+    return committed;
+}
+
+void replay_status_log(char table, void (*apply)(int id, const char *status), long *offset) {
+    // Nothing new since last time? Then skip opening the log at all.
+    if (*offset > 0 && file_size(STATUS_LOG_PATH) == *offset) {
+        return;
+    }
+    lock_data(LOCK_STATUS_LOG, 0);
+    StatusEntry *entries;
+    int count = read_committed_entries(&entries, offset);
+    unlock_data(LOCK_STATUS_LOG);
+    for (int i = 0; i < count; i++) {
+        if (entries[i].table == table) {
+            apply(entries[i].id, entries[i].status);
+        }
+    }
+    free(entries);
+}
+
+// Sorts entries by table and id; ties keep their log order so the latest change wins
+static int compare_entries(const void *a, const void *b) {
+    const StatusEntry *x = a, *y = b;
+    if (x->table != y->table) {
+        return x->table - y->table;
+    }
+    if (x->id != y->id) {
+        return x->id < y->id ? -1 : 1;
+    }
+    return x->seq - y->seq;
+}
+
+// Finds the newest status for an id among sorted entries, or NULL if it never changed
+static const char *latest_status(StatusEntry *entries, int count, char table, int id) {
+    int lo = 0, hi = count - 1, found = -1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        StatusEntry *e = &entries[mid];
+        if (e->table < table || (e->table == table && e->id <= id)) {
+            if (e->table == table && e->id == id) {
+                found = mid;  // keep looking right for a newer one
+            }
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return found >= 0 ? entries[found].status : NULL;
+}
+
+// Rewrites one data file with the newest statuses. Every row starts with its id and
+// ends with its status, so we only have to swap the last field.
+static int fold_into_file(const char *path, char table, StatusEntry *entries, int count) {
+    FILE *file = stats_fopen(path, "r");
+    if (!file) {
+        return 1;  // nothing to fold into
+    }
+    char temp_path[300];
+    FILE *tempFile = create_temp_file(path, temp_path, sizeof(temp_path));
+    if (!tempFile) {
+        printf("Error: Unable to create temporary file.\n");
+        fclose(file);
+        return 0;
+    }
+
+    CsvReader reader;
+    if (!csv_open(&reader, file, path)) {
+        printf("Error: Not enough memory to rewrite %s.\n", path);
+        fclose(file);
+        fclose(tempFile);
+        remove(temp_path);
+        return 0;
+    }
+    reader.keep_malformed = 1;  // copy lines we can't read through as they are
+    int first = 1;
+    long long bytes_written = 0, rows = 0;
+    while (csv_next(&reader)) {
+        const char *status = NULL;
+        int id;
+        if (!first && reader.field_count >= 2 && csv_int(&reader, 0, &id)) {
+            status = latest_status(entries, count, table, id);
+        }
+        int written;
+        if (status) {
+            const char *row[CSV_MAX_FIELDS];
+            memcpy(row, reader.fields, sizeof(char *) * (size_t)reader.field_count);
+            row[reader.field_count - 1] = status;
+            written = csv_write_row(tempFile, row, reader.field_count);
+        } else {
+            // header or unchanged row
+            written = (int)fwrite(reader.line, 1, reader.line_length, tempFile);
+            written += putc('\n', tempFile) != EOF;
+        }
+        bytes_written += written > 0 ? written : 0;
+        rows += first ? 0 : 1;
+        first = 0;
+    }
+    long long bytes_read = reader.offset;
+    csv_close(&reader);
+    fclose(file);
+    stats_read(bytes_read, rows);
+    stats_written(bytes_written);
+    if (!close_temp_file(tempFile)) {
+        remove(temp_path);
+        return 0;
+    }
+
+    if (!replace_file(temp_path, path)) {
+        printf("Error: Unable to update %s.\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+int compact_status_log() {
+    // Nobody may append to the log or read the data files while they are being rewritten
+    lock_data(LOCK_STATUS_LOG, 1);
+    lock_data(LOCK_ITEMS, 1);
+    lock_data(LOCK_REQUESTS, 1);
+    lock_data(LOCK_WISHLISTS, 1);
+
+    StatusEntry *entries;
+    long offset = 0;
+    int count = read_committed_entries(&entries, &offset);
+    int ok = 1;
+    if (count > 0) {
+        qsort(entries, count, sizeof(StatusEntry), compare_entries);
+        // Any indexes must take in the log now; afterwards it is gone
+        catch_up_indexes();
+
+        // If we crash partway, the log is still there and replaying it again is harmless
+        ok = fold_into_file(ITEM_FILE_PATH, 'I', entries, count) &&
+             fold_into_file(REQUEST_FILE_PATH, 'R', entries, count) &&
+             fold_into_file(WISHLIST_FILE_PATH, 'W', entries, count);
+        if (ok) {
+            remove(STATUS_LOG_PATH);
+
+            // Keep any binary copies in step with the rewritten CSV files
+            if (file_size(ITEM_BIN_PATH) > 0) {
+                convert_items_to_binary();
+            }
+            if (file_size(REQUEST_BIN_PATH) > 0) {
+                convert_requests_to_binary();
+            }
+        }
+        // Rows have moved, so every program has to reload instead of reading on from
+        // where it left off
+        bump_data_generation();
+        if (ok) {
+            restamp_indexes();  // their records already match the rewritten rows
+        }
+    }
+    free(entries);
+
+    unlock_data(LOCK_WISHLISTS);
+    unlock_data(LOCK_REQUESTS);
+    unlock_data(LOCK_ITEMS);
+    unlock_data(LOCK_STATUS_LOG);
+    return ok;
+}
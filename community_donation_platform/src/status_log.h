@@ -0,0 +1,44 @@
+// status_log.h
+// Instead of rewriting items.txt or requests.txt every time one status changes, we append
+// a tiny line to a status log. When the program loads the data files it replays the log
+// on top of them, and once the log gets big we fold it back into the data files (compaction).
+
+#ifndef STATUS_LOG_H
+#define STATUS_LOG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Where status changes are appended
+#define STATUS_LOG_PATH "../data/status_log.txt"
+
+// Compact once the log holds at least this many bytes AND is at least a quarter the size
+// of the data files. That keeps the average cost of a status change constant.
+#define STATUS_LOG_MIN_COMPACT_BYTES 65536L
+
+// Queue a status change for an item, a request or a wishlist. Nothing is written until
+// commit_status_log.
+void log_item_status(int item_id, const char *new_status);
+void log_request_status(int request_id, const char *new_status);
+void log_wishlist_status(int wishlist_id, const char *new_status);
+
+// Appends every queued change followed by a "commit" line in one write, so a group of
+// changes (like approving a request and donating its item) is replayed all or nothing.
+// The caller should hold LOCK_STATUS_LOG exclusive from the moment it checked the records
+// it is changing, so no other program can change them in between.
+// Compacts the log if it has grown past the threshold. Returns 1 on success.
+int commit_status_log();
+
+// Calls apply(id, status) for every committed change in the log from byte *offset on,
+// oldest first, then moves *offset past the last commit line. table is 'I' for items,
+// 'R' for requests or 'W' for wishlists. Start with *offset = 0; later calls only see
+// changes added since, including ones written by other programs sharing the data folder.
+void replay_status_log(char table, void (*apply)(int id, const char *status), long *offset);
+
+// Folds every committed change into items.txt, requests.txt and wishlists.txt, then
+// empties the log.
+// This moves rows around, so it bumps the data generation (see file_lock.h).
+int compact_status_log();
+
+#endif /* STATUS_LOG_H */
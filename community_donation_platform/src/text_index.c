@@ -0,0 +1,705 @@
+// text_index.c
+// The inverted index behind keyword search. Each distinct word (a "term") has a posting
+// list: the store positions of the available items whose description or category contains
+// it, in increasing order. New items have the largest positions, so adding one is almost
+// always an append.
+//
+// When an item stops being available we don't search every list for it; we only count
+// the entry as dead and clear the item's bit in live_bits, and searches skip entries whose
+// bit is off. Once more than half of a list is dead it is cleaned out in one pass, so
+// removals stay cheap on average. The bitmap is tiny (one bit per item), so checking it
+// doesn't mean touching the item records themselves.
+//
+// For prefix searches ("jack*") the terms are also kept in alphabetical order, so all the
+// words starting with a prefix sit next to each other and are found by binary search.
+
+#include "text_index.h"
+#include <ctype.h>
+
+#define MAX_QUERY_TERMS 16   // words a single query can use
+
+typedef struct {
+    char *word;
+    int *postings;     // store positions in increasing order
+    int count;         // entries in postings, including dead ones
+    int capacity;
+    int dead;          // entries whose item is no longer available
+} Term;
+
+static Term *terms = NULL;
+static int term_count = 0;
+static int term_capacity = 0;
+static int *term_slots = NULL;      // hash table from word to a position in terms
+static int term_slot_count = 0;
+static int *sorted_terms = NULL;    // positions in terms, in alphabetical order of word
+static int sorted_capacity = 0;
+static int sorted_dirty = 0;        // new words were appended out of order (bulk loading)
+static int bulk_loading = 0;
+static int live_items = 0;          // how many items are indexed right now
+static unsigned char *live_bits = NULL;  // bit per store position: is it indexed right now?
+static int live_bits_size = 0;           // bytes in live_bits
+
+// Splits text into lowercase words made of letters and digits, adding them to words
+// (count so far in *found). Returns 1 if the text ended in the middle of a word.
+static int split_words(const char *text, char words[][MAX_WORD], int *found, int max_words) {
+    int length = 0;
+    for (const char *p = text; ; p++) {
+        if (isalnum((unsigned char)*p)) {
+            if (length == 0 && *found == max_words) {
+                return 0;
+            }
+            if (length < MAX_WORD - 1) {
+                words[*found][length++] = (char)tolower((unsigned char)*p);
+            }
+            continue;
+        }
+        if (length > 0) {
+            words[*found][length] = '\0';
+            (*found)++;
+            length = 0;
+            if (*p == '\0') {
+                return 1;
+            }
+        }
+        if (*p == '\0') {
+            return 0;
+        }
+    }
+}
+
+// Picks the starting hash slot for a word (FNV-1a)
+static int word_hash(const char *word) {
+    unsigned int h = 2166136261u;
+    for (int i = 0; word[i]; i++) {
+        h = (h ^ (unsigned char)word[i]) * 16777619u;
+    }
+    return (int)(h & (unsigned int)(term_slot_count - 1));
+}
+
+// Doubles the term hash table and re-inserts every term
+static int grow_term_slots() {
+    int new_count = term_slot_count ? term_slot_count * 2 : 1024;
+    int *new_slots = malloc(sizeof(int) * new_count);
+    if (!new_slots) {
+        return 0;
+    }
+    free(term_slots);
+    term_slots = new_slots;
+    term_slot_count = new_count;
+    for (int i = 0; i < term_slot_count; i++) {
+        term_slots[i] = -1;
+    }
+    for (int i = 0; i < term_count; i++) {
+        int slot = word_hash(terms[i].word);
+        while (term_slots[slot] != -1) {
+            slot = (slot + 1) & (term_slot_count - 1);
+        }
+        term_slots[slot] = i;
+    }
+    return 1;
+}
+
+// First position in sorted_terms whose word is >= word
+static int sorted_lower_bound(const char *word) {
+    int lo = 0, hi = term_count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (strcmp(terms[sorted_terms[mid]].word, word) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Finds a term by word. If create is set, adds it when missing. Returns -1 if not found.
+static int find_term(const char *word, int create) {
+    if (term_slot_count > 0) {
+        int slot = word_hash(word);
+        while (term_slots[slot] != -1) {
+            if (strcmp(terms[term_slots[slot]].word, word) == 0) {
+                return term_slots[slot];
+            }
+            slot = (slot + 1) & (term_slot_count - 1);
+        }
+    }
+    if (!create) {
+        return -1;
+    }
+
+    // Keep the hash table at most 70% full so lookups stay short
+    if ((term_count + 1) * 10 > term_slot_count * 7 && !grow_term_slots()) {
+        return -1;
+    }
+    if (term_count == term_capacity) {
+        int new_capacity = term_capacity ? term_capacity * 2 : 1024;
+        Term *bigger = realloc(terms, sizeof(Term) * new_capacity);
+        int *bigger_sorted = realloc(sorted_terms, sizeof(int) * new_capacity);
+        if (bigger) {
+            terms = bigger;
+        }
+        if (bigger_sorted) {
+            sorted_terms = bigger_sorted;
+            sorted_capacity = new_capacity;
+        }
+        if (!bigger || !bigger_sorted) {
+            return -1;
+        }
+        term_capacity = new_capacity;
+    }
+    char *copy = malloc(strlen(word) + 1);
+    if (!copy) {
+        return -1;
+    }
+    strcpy(copy, word);
+
+    Term *term = &terms[term_count];
+    memset(term, 0, sizeof(Term));
+    term->word = copy;
+    int slot = word_hash(word);
+    while (term_slots[slot] != -1) {
+        slot = (slot + 1) & (term_slot_count - 1);
+    }
+    term_slots[slot] = term_count;
+
+    // Put the new word in alphabetical order (or just append it while bulk loading)
+    if (bulk_loading) {
+        sorted_terms[term_count] = term_count;
+        sorted_dirty = 1;
+    } else {
+        int at = sorted_lower_bound(word);
+        memmove(&sorted_terms[at + 1], &sorted_terms[at], sizeof(int) * (term_count - at));
+        sorted_terms[at] = term_count;
+    }
+    return term_count++;
+}
+
+// First index in a term's postings that is >= position
+static int posting_lower_bound(const Term *term, int position) {
+    int lo = 0, hi = term->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (term->postings[mid] < position) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Checks whether the item at a store position can still be found by searches
+static int is_available(int position) {
+    return position / 8 < live_bits_size && (live_bits[position / 8] >> (position % 8)) & 1;
+}
+
+// Turns the bit for a store position on or off, growing the bitmap if needed
+static int set_available(int position, int available) {
+    if (position / 8 >= live_bits_size) {
+        if (!available) {
+            return 1;
+        }
+        int new_size = live_bits_size ? live_bits_size : 1024;
+        while (position / 8 >= new_size) {
+            new_size *= 2;
+        }
+        unsigned char *bigger = realloc(live_bits, (size_t)new_size);
+        if (!bigger) {
+            return 0;
+        }
+        memset(bigger + live_bits_size, 0, (size_t)(new_size - live_bits_size));
+        live_bits = bigger;
+        live_bits_size = new_size;
+    }
+    if (available) {
+        live_bits[position / 8] |= (unsigned char)(1 << (position % 8));
+    } else {
+        live_bits[position / 8] &= (unsigned char)~(1 << (position % 8));
+    }
+    return 1;
+}
+
+int text_words(const char *text, char words[][MAX_WORD], int max_words) {
+    int found = 0;
+    split_words(text, words, &found, max_words);
+    return found;
+}
+
+// Splits an item's description and category into its distinct words. Returns how many.
+int item_words(const Item *item, char words[][MAX_WORD]) {
+    int found = 0;
+    split_words(item->description, words, &found, MAX_ITEM_WORDS);
+    split_words(item_category(item), words, &found, MAX_ITEM_WORDS);
+
+    // Drop repeats so each item appears at most once in a posting list
+    int distinct = 0;
+    for (int i = 0; i < found; i++) {
+        int seen = 0;
+        for (int j = 0; j < distinct && !seen; j++) {
+            seen = strcmp(words[i], words[j]) == 0;
+        }
+        if (!seen) {
+            if (distinct != i) {
+                strcpy(words[distinct], words[i]);
+            }
+            distinct++;
+        }
+    }
+    return distinct;
+}
+
+void text_index_add(int position, const Item *item) {
+    if (is_available(position) || !set_available(position, 1)) {
+        return;  // already indexed, or out of memory
+    }
+    char words[MAX_ITEM_WORDS][MAX_WORD];
+    int count = item_words(item, words);
+    for (int i = 0; i < count; i++) {
+        int t = find_term(words[i], 1);
+        if (t < 0) {
+            continue;
+        }
+        Term *term = &terms[t];
+        int at = posting_lower_bound(term, position);
+        if (at < term->count && term->postings[at] == position) {
+            // Still listed from when it was available before, so it's live again
+            if (term->dead > 0) {
+                term->dead--;
+            }
+            continue;
+        }
+        if (term->count == term->capacity) {
+            int new_capacity = term->capacity ? term->capacity * 2 : 4;
+            int *bigger = realloc(term->postings, sizeof(int) * new_capacity);
+            if (!bigger) {
+                continue;
+            }
+            term->postings = bigger;
+            term->capacity = new_capacity;
+        }
+        memmove(&term->postings[at + 1], &term->postings[at], sizeof(int) * (term->count - at));
+        term->postings[at] = position;
+        term->count++;
+    }
+    live_items++;
+}
+
+void text_index_remove(int position, const Item *item) {
+    if (!is_available(position)) {
+        return;
+    }
+    set_available(position, 0);
+    char words[MAX_ITEM_WORDS][MAX_WORD];
+    int count = item_words(item, words);
+    for (int i = 0; i < count; i++) {
+        int t = find_term(words[i], 0);
+        if (t < 0) {
+            continue;
+        }
+        Term *term = &terms[t];
+        term->dead++;
+        if (term->dead * 2 <= term->count) {
+            continue;
+        }
+
+        // Mostly dead: keep only the items that are still available
+        int kept = 0;
+        for (int j = 0; j < term->count; j++) {
+            int p = term->postings[j];
+            if (is_available(p)) {
+                term->postings[kept++] = p;
+            }
+        }
+        term->count = kept;
+        term->dead = 0;
+    }
+    live_items--;
+}
+
+void text_index_clear() {
+    for (int i = 0; i < term_count; i++) {
+        terms[i].count = 0;
+        terms[i].dead = 0;
+    }
+    if (live_bits) {
+        memset(live_bits, 0, (size_t)live_bits_size);
+    }
+    live_items = 0;
+}
+
+// Sorts positions in terms by their word (for qsort)
+static int compare_term_words(const void *a, const void *b) {
+    return strcmp(terms[*(const int *)a].word, terms[*(const int *)b].word);
+}
+
+void text_index_begin_bulk() {
+    bulk_loading = 1;
+}
+
+void text_index_end_bulk() {
+    bulk_loading = 0;
+    if (sorted_dirty) {
+        qsort(sorted_terms, (size_t)term_count, sizeof(int), compare_term_words);
+        sorted_dirty = 0;
+    }
+}
+
+// ---------- searching ----------
+
+// The items matching one query word: positions in increasing order with a weight each.
+// For a whole word this points straight at the term's postings (one weight for all).
+typedef struct {
+    const int *positions;
+    double *weights;     // one per position, or NULL if every position has weight
+    double weight;
+    int count;
+    int *owned;          // memory to free (prefix matches build their own list)
+} MatchList;
+
+// A matching item and its score
+typedef struct {
+    int position;
+    double score;
+} Match;
+
+// How much a word counts: roughly log2(indexed items / items with the word) + 1, so a
+// word found in few items counts for more than one found in nearly all of them
+static double rarity(const Term *term) {
+    int df = term->count - term->dead;
+    if (df < 1) {
+        df = 1;
+    }
+    int ratio = (live_items > df ? live_items : df) / df;
+    double score = 1.0;
+    while (ratio > 1) {
+        ratio >>= 1;
+        score += 1.0;
+    }
+    return score;
+}
+
+static int compare_match_positions(const void *a, const void *b) {
+    const Match *x = a, *y = b;
+    return (x->position > y->position) - (x->position < y->position);
+}
+
+// Builds the match list for one query word. A prefix word merges the lists of every
+// term that starts with it; a term equal to the prefix counts fully, longer ones less.
+static int build_match_list(const char *word, int prefix, MatchList *list) {
+    memset(list, 0, sizeof(MatchList));
+    if (!prefix) {
+        int t = find_term(word, 0);
+        if (t >= 0) {
+            list->positions = terms[t].postings;
+            list->count = terms[t].count;
+            list->weight = rarity(&terms[t]);
+        }
+        return 1;
+    }
+
+    size_t prefix_length = strlen(word);
+    int first = sorted_lower_bound(word);
+    int last = first;
+    long total = 0;
+    while (last < term_count && strncmp(terms[sorted_terms[last]].word, word, prefix_length) == 0) {
+        total += terms[sorted_terms[last]].count;
+        last++;
+    }
+    if (total == 0) {
+        return 1;
+    }
+
+    Match *all = malloc(sizeof(Match) * (size_t)total);
+    if (!all) {
+        return 0;
+    }
+    int used = 0;
+    for (int s = first; s < last; s++) {
+        const Term *term = &terms[sorted_terms[s]];
+        double weight = rarity(term) * (strlen(term->word) == prefix_length ? 1.0 : 0.75);
+        for (int j = 0; j < term->count; j++) {
+            all[used].position = term->postings[j];
+            all[used].score = weight;
+            used++;
+        }
+    }
+    if (last - first > 1) {
+        qsort(all, (size_t)used, sizeof(Match), compare_match_positions);
+    }
+
+    // One entry per item, keeping its best weight
+    int *positions = malloc(sizeof(int) * (size_t)used);
+    double *weights = malloc(sizeof(double) * (size_t)used);
+    if (!positions || !weights) {
+        free(all);
+        free(positions);
+        free(weights);
+        return 0;
+    }
+    int count = 0;
+    for (int j = 0; j < used; j++) {
+        if (count > 0 && positions[count - 1] == all[j].position) {
+            if (all[j].score > weights[count - 1]) {
+                weights[count - 1] = all[j].score;
+            }
+        } else {
+            positions[count] = all[j].position;
+            weights[count] = all[j].score;
+            count++;
+        }
+    }
+    free(all);
+    list->positions = positions;
+    list->weights = weights;
+    list->count = count;
+    list->owned = positions;
+    return 1;
+}
+
+static void free_match_list(MatchList *list) {
+    free(list->owned);
+    free(list->weights);
+}
+
+static int compare_list_sizes(const void *a, const void *b) {
+    const MatchList *x = a, *y = b;
+    return x->count - y->count;
+}
+
+// Finds the items in every list (an AND group) and adds them to results with the sum of
+// their weights. Walks the shortest list and looks each item up in the others, moving a
+// cursor forward in each, so the cost depends on the shortest list, not the longest.
+static int intersect_lists(MatchList *lists, int list_count, Match **results,
+                           int *result_count, int *result_capacity) {
+    qsort(lists, (size_t)list_count, sizeof(MatchList), compare_list_sizes);
+    int cursors[MAX_QUERY_TERMS] = {0};
+    const MatchList *shortest = &lists[0];
+
+    for (int i = 0; i < shortest->count; i++) {
+        int position = shortest->positions[i];
+        if (!is_available(position)) {
+            continue;
+        }
+        double score = shortest->weights ? shortest->weights[i] : shortest->weight;
+        int in_all = 1;
+        for (int l = 1; l < list_count && in_all; l++) {
+            const MatchList *other = &lists[l];
+            // Gallop forward from the cursor (1, 2, 4, ... entries) to find a small range
+            // holding the position, then binary search inside it
+            int lo = cursors[l], step = 1;
+            while (lo + step < other->count && other->positions[lo + step] < position) {
+                lo += step;
+                step *= 2;
+            }
+            int hi = lo + step < other->count ? lo + step : other->count;
+            while (lo < hi) {
+                int mid = (lo + hi) / 2;
+                if (other->positions[mid] < position) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            cursors[l] = lo;
+            if (lo == other->count || other->positions[lo] != position) {
+                in_all = 0;
+            } else {
+                score += other->weights ? other->weights[lo] : other->weight;
+            }
+        }
+        if (!in_all) {
+            continue;
+        }
+
+        if (*result_count == *result_capacity) {
+            int new_capacity = *result_capacity ? *result_capacity * 2 : 256;
+            Match *bigger = realloc(*results, sizeof(Match) * new_capacity);
+            if (!bigger) {
+                return 0;
+            }
+            *results = bigger;
+            *result_capacity = new_capacity;
+        }
+        (*results)[*result_count].position = position;
+        (*results)[*result_count].score = score;
+        (*result_count)++;
+    }
+    return 1;
+}
+
+// Merges two runs of matches sorted by position, results[0 .. split) and
+// results[split .. count), into one. An item in both (matched by more than one OR group)
+// gets the scores added together. Returns the new count, or -1 if out of memory.
+static int merge_runs(Match *results, int split, int count) {
+    Match *merged = malloc(sizeof(Match) * (size_t)count);
+    if (!merged) {
+        return -1;
+    }
+    int a = 0, b = split, used = 0;
+    while (a < split || b < count) {
+        if (b == count || (a < split && results[a].position < results[b].position)) {
+            merged[used++] = results[a++];
+        } else if (a == split || results[b].position < results[a].position) {
+            merged[used++] = results[b++];
+        } else {
+            merged[used] = results[a++];
+            merged[used++].score += results[b++].score;
+        }
+    }
+    memcpy(results, merged, sizeof(Match) * (size_t)used);
+    free(merged);
+    return used;
+}
+
+// Is match a ranked ahead of match b? Higher score first, then the older item (the one
+// earlier in the store), so equal matches come out in the order they were added.
+static int ranks_ahead(const Match *a, const Match *b) {
+    if (a->score != b->score) {
+        return a->score > b->score;
+    }
+    return a->position < b->position;
+}
+
+// Moves heap[i] down to its place in a heap that keeps the weakest match on top
+static void sift_down(Match *heap, int size, int i) {
+    for (;;) {
+        int weakest = i, left = 2 * i + 1, right = left + 1;
+        if (left < size && ranks_ahead(&heap[weakest], &heap[left])) {
+            weakest = left;
+        }
+        if (right < size && ranks_ahead(&heap[weakest], &heap[right])) {
+            weakest = right;
+        }
+        if (weakest == i) {
+            return;
+        }
+        Match swap = heap[i];
+        heap[i] = heap[weakest];
+        heap[weakest] = swap;
+        i = weakest;
+    }
+}
+
+// Puts the best `limit` matches at the front of results, best first. Returns how many.
+// Uses a small heap of the best so far, so a word that matches a million items doesn't
+// mean sorting a million items.
+static int pick_best(Match *results, int count, int limit) {
+    if (limit > count) {
+        limit = count;
+    }
+    if (limit <= 0) {
+        return 0;
+    }
+    for (int i = limit / 2 - 1; i >= 0; i--) {
+        sift_down(results, limit, i);
+    }
+    for (int i = limit; i < count; i++) {
+        if (ranks_ahead(&results[i], &results[0])) {
+            results[0] = results[i];
+            sift_down(results, limit, 0);
+        }
+    }
+    // Take the weakest off the top one at a time, filling the array from the back
+    for (int size = limit; size > 1; size--) {
+        Match weakest = results[0];
+        results[0] = results[size - 1];
+        results[size - 1] = weakest;
+        sift_down(results, size - 1, 0);
+    }
+    return limit;
+}
+
+int text_index_search(const char *query, int *positions, int limit, int *total) {
+    if (total) {
+        *total = 0;
+    }
+
+    // Break the query into words, grouped by OR
+    char words[MAX_QUERY_TERMS][MAX_WORD];
+    int is_prefix[MAX_QUERY_TERMS];
+    int group_of[MAX_QUERY_TERMS];
+    int word_count = 0, group = 0;
+    char chunk[100];
+    const char *p = query;
+    while (*p) {
+        while (isspace((unsigned char)*p)) {
+            p++;
+        }
+        size_t length = 0;
+        while (p[length] && !isspace((unsigned char)p[length])) {
+            length++;
+        }
+        if (length == 0) {
+            break;
+        }
+        if (length >= sizeof(chunk)) {
+            length = sizeof(chunk) - 1;
+        }
+        memcpy(chunk, p, length);
+        chunk[length] = '\0';
+        p += length;
+        while (*p && !isspace((unsigned char)*p)) {
+            p++;  // skip whatever didn't fit in chunk
+        }
+
+        if (strcmp(chunk, "OR") == 0) {
+            if (word_count > 0 && group_of[word_count - 1] == group) {
+                group++;
+            }
+            continue;
+        }
+        int before = word_count;
+        int open_word = split_words(chunk, words, &word_count, MAX_QUERY_TERMS);
+        for (int i = before; i < word_count; i++) {
+            group_of[i] = group;
+            is_prefix[i] = 0;
+        }
+        // "jack*" means any word starting with "jack"
+        if (word_count > before && chunk[length - 1] == '*' && !open_word) {
+            is_prefix[word_count - 1] = 1;
+        }
+    }
+    if (word_count == 0) {
+        return 0;
+    }
+
+    Match *results = NULL;
+    int result_count = 0, result_capacity = 0;
+    int ok = 1;
+    int groups = group_of[word_count - 1] + 1;
+    for (int g = 0; g < groups && ok; g++) {
+        MatchList lists[MAX_QUERY_TERMS];
+        int list_count = 0;
+        for (int i = 0; i < word_count && ok; i++) {
+            if (group_of[i] == g) {
+                ok = build_match_list(words[i], is_prefix[i], &lists[list_count++]);
+            }
+        }
+        int run_start = result_count;
+        if (ok && list_count > 0) {
+            ok = intersect_lists(lists, list_count, &results, &result_count, &result_capacity);
+        }
+        if (ok && run_start > 0) {
+            result_count = merge_runs(results, run_start, result_count);
+            ok = result_count >= 0;
+        }
+        for (int l = 0; l < list_count; l++) {
+            free_match_list(&lists[l]);
+        }
+    }
+    if (!ok) {
+        free(results);
+        return 0;
+    }
+
+    int shown = pick_best(results, result_count, limit);
+    for (int i = 0; i < shown; i++) {
+        positions[i] = results[i].position;
+    }
+    if (total) {
+        *total = result_count;
+    }
+    free(results);
+    return shown;
+}
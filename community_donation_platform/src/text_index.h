@@ -0,0 +1,53 @@
+// text_index.h
+// Keyword search over item descriptions and categories. Every word of an available item
+// points back to the item (an "inverted index"), so a search only looks at the items that
+// contain the words asked for instead of scanning the whole catalog.
+//
+// Query syntax (upper/lower case doesn't matter):
+//   winter coat            items with both words (AND)
+//   coat OR parka          items with either word
+//   winter coat OR parka   (winter AND coat) OR parka
+//   jack*                  any word starting with "jack" (jacket, jackets, ...)
+// Results are ranked: rarer words count for more, and whole-word matches beat prefix matches.
+
+#ifndef TEXT_INDEX_H
+#define TEXT_INDEX_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "items.h"
+
+// How many results the menus and batch mode show at most
+#define SEARCH_RESULT_LIMIT 50
+
+#define MAX_WORD 24          // longer words are cut to this many characters
+#define MAX_ITEM_WORDS 64    // words indexed per item (descriptions are under 100 chars)
+
+// Keeps the index in step with the item store. position is the item's place in the store.
+// Only available items are indexed: add an item when it becomes available, remove it
+// when it stops being available.
+void text_index_add(int position, const Item *item);
+void text_index_remove(int position, const Item *item);
+
+// Forgets every item (the words themselves are kept for reuse)
+void text_index_clear();
+
+// While loading many items at once, new words are collected and sorted once at the end
+// instead of being put in order one by one
+void text_index_begin_bulk();
+void text_index_end_bulk();
+
+// The same word splitting the index uses, for code that matches words itself (wishlist.c).
+// item_words fills words with the distinct lowercase words of an item's description and
+// category; text_words with up to max_words words of any text, repeats included.
+// Both return how many words they wrote.
+int item_words(const Item *item, char words[][MAX_WORD]);
+int text_words(const char *text, char words[][MAX_WORD], int max_words);
+
+// Runs a query. Fills positions with up to limit store positions, best match first, and
+// returns how many it wrote. *total (if not NULL) gets the number of matching items.
+// Only reads the index, so several searches can run at once.
+int text_index_search(const char *query, int *positions, int limit, int *total);
+
+#endif /* TEXT_INDEX_H */
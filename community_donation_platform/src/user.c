@@ -1,9 +1,33 @@
 // user.c
 // This file handles user operations like signing up, logging in, and checking credentials.
 // It uses a "users.txt" file to store and load usernames, passwords, and roles.
+// The file is read once into a user directory: a hash table keyed by username, so
+// checking a login or spotting a taken username doesn't mean reading the file again.
 
 #include "user.h"   // For the User structure and function prototypes
+#include "arena.h"  // For the chunked user table
+#include "file_lock.h" // For sharing users.txt with other programs
+#include "stats.h"  // For counting calls, time and file activity
+#include "durable.h"  // For writes that survive a crash
+#include "csv.h"      // For reading and writing users.txt rows
+#include "data_watch.h" // For noticing when users.txt was rewritten
 #include <stdio.h>  // For input/output functions
+#include <sys/stat.h> // For checking the file size
+
+// The user directory. user_store holds every account in file order (in arena chunks, so
+// records never move) and user_slots is an open-addressing hash table from username to a
+// position in user_store.
+static RecordArena user_store = { sizeof(User), 0, NULL, 0, 0 };
+static int *user_slots = NULL;   // -1 means the slot is empty
+static int user_slot_count = 0;  // always a power of two
+static int users_loaded = 0;
+static long long users_offset = 0;  // bytes of users.txt already in the directory
+static FileMark users_mark;         // users.txt as it was when we last read it
+
+// Shorthand for the user at a store position
+static User *stored_user(int index) {
+    return arena_at(&user_store, index);
+}
 
 // Clears leftover characters in stdin so they don't affect future inputs
 static void clear_input_buffer() {
@@ -12,7 +36,8 @@ static void clear_input_buffer() {
 }
 
 // Lets a new user sign up by providing username, password, and role
-void signup() {
+int signup() {
+    STATS_TIME(STAT_SIGNUP);
     User newUser;
 
     // Ask for a username
@@ -20,16 +45,22 @@ void signup() {
     if (scanf("%49s", newUser.username) != 1) {
         printf("Invalid input.\n");
         clear_input_buffer();
-        return;
+        return 0;
     }
     clear_input_buffer();
 
+    // Usernames have to be unique
+    if (find_user(newUser.username)) {
+        printf("That username is already taken.\n");
+        return 0;
+    }
+
     // Ask for a password
     printf("Enter password: ");
     if (scanf("%49s", newUser.password) != 1) {
         printf("Invalid input.\n");
         clear_input_buffer();
-        return;
+        return 0;
     }
     clear_input_buffer();
 
@@ -39,7 +70,7 @@ void signup() {
     if (scanf(" %c", &roleChar) != 1) {
         printf("Invalid input for role.\n");
         clear_input_buffer();
-        return;
+        return 0;
     }
     clear_input_buffer();
 
@@ -50,16 +81,20 @@ void signup() {
         strcpy(newUser.role, "recipient");
     } else {
         printf("Invalid role selection.\n");
-        return;
+        return 0;
     }
 
-    // Save the new user into the file
-    save_user(newUser);
-    printf("Signup successful!\n");
+    // Save the new user into the file (someone else may have taken the name meanwhile)
+    if (!save_user(newUser)) {
+        printf("That username is already taken.\n");
+        return 0;
+    }
+    return 1;
 }
 
 // Lets a user log in by checking username and password against the file
 int login(char *logged_in_user, char *logged_in_role) {
+    STATS_TIME(STAT_LOGIN);
     char username[50], password[50];
 
     // Ask for username
@@ -90,41 +125,174 @@ int login(char *logged_in_user, char *logged_in_role) {
     }
 }
 
-// Loads all users from the users.txt file into an array
-void load_users(User users[], int *user_count) {
-    FILE *file = fopen("../data/users.txt", "r");
-    if (!file) {
-        printf("No user data found.\n");
-        return;
+// Picks the starting hash slot for a username (FNV-1a)
+static int username_hash(const char *username) {
+    unsigned int h = 2166136261u;
+    for (int i = 0; username[i]; i++) {
+        h = (h ^ (unsigned char)username[i]) * 16777619u;
+    }
+    return (int)(h & (unsigned int)(user_slot_count - 1));
+}
+
+// Puts a store position into the hash table (the table must have a free slot)
+static void index_user(int index) {
+    int slot = username_hash(stored_user(index)->username);
+    while (user_slots[slot] != -1) {
+        slot = (slot + 1) & (user_slot_count - 1);
+    }
+    user_slots[slot] = index;
+}
+
+// Doubles the hash table and re-inserts every user
+static int grow_user_slots() {
+    int new_count = user_slot_count ? user_slot_count * 2 : 64;
+    int *new_slots = malloc(sizeof(int) * new_count);
+    if (!new_slots) {
+        return 0;
+    }
+    free(user_slots);
+    user_slots = new_slots;
+    user_slot_count = new_count;
+    for (int i = 0; i < user_slot_count; i++) {
+        user_slots[i] = -1;
+    }
+    for (int i = 0; i < user_store.count; i++) {
+        index_user(i);
+    }
+    return 1;
+}
+
+// Adds one account to the directory. Returns 0 if we ran out of memory.
+static int store_user(const User *user) {
+    // Keep the hash table at most 70% full so lookups stay short
+    if ((user_store.count + 1) * 10 > user_slot_count * 7 && !grow_user_slots()) {
+        return 0;
+    }
+    User *stored = arena_add(&user_store);
+    if (!stored) {
+        return 0;
+    }
+    *stored = *user;
+    index_user(user_store.count - 1);
+    return 1;
+}
+
+// The hash table lookup behind find_user (also used while loading)
+static User *lookup_user(const char *username) {
+    if (user_slot_count == 0) {
+        return NULL;
+    }
+    int slot = username_hash(username);
+    while (user_slots[slot] != -1) {
+        if (strcmp(stored_user(user_slots[slot])->username, username) == 0) {
+            return stored_user(user_slots[slot]);
+        }
+        slot = (slot + 1) & (user_slot_count - 1);
     }
+    return NULL;
+}
 
-    // Skip the header line
+// Reads user records from the current position of users.txt to the end, and remembers
+// how far we got. On the first read the header line is skipped.
+static void read_user_rows(FILE *file) {
+    CsvReader reader;
+    if (!csv_open(&reader, file, "users.txt")) {
+        printf("Error: Not enough memory to load users.\n");
+        return;
+    }
+    long long start = reader.offset;
+    long long records = 0;
     // (We assume the first line is always: "username,password,role")
-    char header[200];
-    if (fgets(header, sizeof(header), file) == NULL) {
-        // The file was empty or had an unexpected format
+    int header = users_offset == 0;
+    while (csv_next(&reader)) {
+        if (header) {
+            header = 0;
+            continue;
+        }
+        User user;
+        if (reader.field_count != 3 ||
+            !csv_copy(&reader, 0, user.username, sizeof(user.username)) ||
+            !csv_copy(&reader, 1, user.password, sizeof(user.password)) ||
+            !csv_copy(&reader, 2, user.role, sizeof(user.role))) {
+            csv_skip(&reader);
+            continue;
+        }
+        records++;
+        // If a name shows up twice, the first account keeps it
+        if (!lookup_user(user.username) && !store_user(&user)) {
+            printf("Error: Not enough memory to load users.\n");
+            break;
+        }
+    }
+    users_offset = reader.offset;
+    stats_read(users_offset - start, records);
+    csv_close(&reader);
+}
+
+// Reads the users that were added to users.txt since we last looked (all of them the
+// first time), including ones added by other programs sharing the data folder
+void refresh_users() {
+    struct stat st;
+    if (users_offset > 0) {
+        if (file_rewritten("../data/users.txt", &users_mark)) {
+            // Someone rewrote the file (removed or changed an account), so read it all again
+            arena_clear(&user_store);
+            for (int i = 0; i < user_slot_count; i++) {
+                user_slots[i] = -1;
+            }
+            users_offset = 0;
+        } else if (stat("../data/users.txt", &st) != 0 || st.st_size <= users_offset) {
+            return;  // nothing new
+        }
+    }
+    lock_data(LOCK_USERS, 0);
+    FILE *file = stats_fopen("../data/users.txt", "r");
+    if (file) {
+        if (users_offset > 0) {
+            fseek(file, (long)users_offset, SEEK_SET);
+        }
+        read_user_rows(file);
         fclose(file);
-        printf("No user data found.\n");
-        return;
     }
+    mark_file("../data/users.txt", users_offset, &users_mark);
+    unlock_data(LOCK_USERS);
+}
 
-    *user_count = 0;
-    // Now read each user record line
-    while (fscanf(file, "%49[^,],%49[^,],%9s\n",
-                  users[*user_count].username,
-                  users[*user_count].password,
-                  users[*user_count].role) != EOF) {
-        (*user_count)++;
+// Loads all users from the users.txt file into the user directory (first call only)
+void load_users() {
+    if (users_loaded) {
+        return;
     }
-    fclose(file);
+    STATS_TIME(STAT_LOAD_USERS);
+    users_loaded = 1;
+    refresh_users();
 }
 
-// Saves one new user to the end of the users file
-void save_user(User newUser) {
-    FILE *file = fopen("../data/users.txt", "a+");  // Changed 'a' to 'a+'
+// Looks up an account by username, or returns NULL if there is none
+User *find_user(const char *username) {
+    load_users();
+    STATS_TIME(STAT_FIND_USER);
+    return lookup_user(username);
+}
+
+// Saves one new user to the end of the users file.
+// Returns 1 if saved, 0 if the name is taken (maybe just now, by another program) or on error.
+int save_user(User newUser) {
+    load_users();
+    STATS_TIME(STAT_SAVE_USER);
+
+    // Hold the users lock from the name check until the record is written
+    lock_data(LOCK_USERS, 1);
+    refresh_users();
+    if (find_user(newUser.username)) {
+        unlock_data(LOCK_USERS);
+        return 0;
+    }
+    FILE *file = stats_fopen("../data/users.txt", "a+");  // Changed 'a' to 'a+'
     if (!file) {
         printf("Error opening user file!\n");
-        return;
+        unlock_data(LOCK_USERS);
+        return 0;
     }
 
     // If the file is empty, write a header first
@@ -143,38 +311,34 @@ void save_user(User newUser) {
         fseek(file, 0, SEEK_END);  // Move back to end for appending
     }
 
-    // Now append this user's record
-    fprintf(file, "%s,%s,%s\n", newUser.username, newUser.password, newUser.role);
-    fclose(file);
+    // Now append this user's record, and add it to the directory
+    const char *row[] = { newUser.username, newUser.password, newUser.role };
+    int written = csv_write_row(file, row, 3);
+    stats_written(written > 0 ? written : 0);
+    int closed = close_durably(file);
+    unlock_data(LOCK_USERS);
+    if (!closed) {
+        printf("Error writing user file!\n");
+        return 0;
+    }
+    if (!store_user(&newUser)) {
+        printf("Error: Not enough memory to keep the new user loaded.\n");
+    }
+    return 1;
 }
 
-// Checks if the username and password match something in the users file
+// Checks if the username and password match an account in the user directory
 int validate_credentials(char *username, char *password, char *role) {
-    FILE *file = fopen("../data/users.txt", "r");
-    if (!file) {
-        return 0;
+    STATS_TIME(STAT_VALIDATE_CREDENTIALS);
+    User *user = find_user(username);
+    if (!user) {
+        // The account may have just been made by another program
+        refresh_users();
+        user = find_user(username);
     }
-
-    // Skip the header line if it exists
-    char header[200];
-    if (fgets(header, sizeof(header), file) == NULL) {
-        // empty file or read error
-        fclose(file);
+    if (!user || strcmp(password, user->password) != 0) {
         return 0;
     }
-
-    char stored_username[50], stored_password[50], stored_role[10];
-    while (fscanf(file, "%49[^,],%49[^,],%9s\n",
-                  stored_username,
-                  stored_password,
-                  stored_role) != EOF) {
-        if (strcmp(username, stored_username) == 0 &&
-            strcmp(password, stored_password) == 0) {
-            strcpy(role, stored_role);
-            fclose(file);
-            return 1;
-        }
-    }
-    fclose(file);
-    return 0;
+    strcpy(role, user->role);
+    return 1;
 }
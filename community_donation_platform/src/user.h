@@ -18,19 +18,30 @@ typedef struct {
 } User;
 
 // Lets a new user register by giving a username, password, and role
-void signup();
+// Returns 1 if the account was created, 0 if not (bad input or username taken)
+int signup();
 
 // Logs a user in by verifying their username and password
 // Returns 1 if valid, 0 otherwise
 int login(char *logged_in_user, char *logged_in_role);
 
-// Loads all users from the users.txt file into an array
-void load_users(User users[], int *user_count);
+// Loads all users from the users.txt file into the user directory (a hash table
+// keyed by username). Only the first call reads the file.
+void load_users();
 
-// Saves a new user to the users.txt file
-void save_user(User newUser);
+// Reads the accounts other programs have added to users.txt since we last looked.
+// If the file was rewritten instead, the whole directory is read again, so don't keep
+// User pointers across a call to this.
+void refresh_users();
 
-// Checks if username and password match a record in the file
+// Finds a user by username, or returns NULL if no such account exists
+User *find_user(const char *username);
+
+// Saves a new user to the users.txt file and the user directory.
+// Returns 1 if saved, 0 if the username is taken or the file couldn't be written.
+int save_user(User newUser);
+
+// Checks if username and password match an account in the user directory
 // Copies the role into the provided role variable if it matches
 int validate_credentials(char *username, char *password, char *role);
 
@@ -0,0 +1,1039 @@
+// wishlist.c
+// Wishlists are kept in wishlists.txt, one row each:
+//   wishlist_id,recipient_username,category,keywords,conditions,status
+// Cancelling one is a status change, so it goes through the status log like items and
+// requests do. Notifications are appended to notifications.txt
+// (recipient_username,item_id,wishlist_id), and when a recipient looks at their new ones
+// we append "recipient_username,<how many they have seen>" to notifications_seen.txt.
+// Those two files only ever grow.
+//
+// In memory, three hash tables map a key to a group of store positions (see Group):
+//   - anchors: the active wishlists filed under a key. The key is the lowercase category
+//     ("*" for any) and the wishlist's two longest keywords in alphabetical order, like
+//     "clothes|coat|wool" or "*|red|stroller"; "books|novel" if it has one keyword and
+//     "books|" if it has none. An item with category C and words w1..wn can only fit
+//     wishlists filed under "C|", "C|wi", "*|wi", "C|wi|wj" or "*|wi|wj", so matching looks
+//     up those keys and checks the few wishlists found there against their other keywords
+//     and conditions. Two words narrow a key far more than one ("coat" alone is in lots of
+//     items), and the longest words are used as a guess at the rarest ones.
+//   - owners: each recipient's wishlists, for listing them.
+//   - mailboxes: each recipient's notifications, oldest first, and how many they've seen.
+
+#include "wishlist.h"
+#include "status_log.h"
+#include "id_sequence.h"
+#include "arena.h"
+#include "file_lock.h"
+#include "text_index.h"
+#include "stats.h"
+#include "durable.h"
+#include "csv.h"
+#include "data_watch.h"
+#include <ctype.h>
+#include <sys/stat.h>
+
+// A key and the store positions filed under it
+#define KEY_SIZE 72  // a category and two words (each at most MAX_WORD - 1 long), plus the '|'s
+
+typedef struct {
+    char key[KEY_SIZE];
+    int *members;   // positions in wishlist_store (anchors, owners) or notification_store
+    int count;
+    int capacity;
+    int seen;       // mailboxes only: how many of the members the recipient has seen
+} Group;
+
+// Groups with an open-addressing hash table from key to a position in groups
+typedef struct {
+    Group *groups;
+    int count;
+    int capacity;
+    int *slots;       // -1 means the slot is empty
+    int slot_count;   // always a power of two
+} GroupTable;
+
+// One notification, as stored in notifications.txt
+typedef struct {
+    int item_id;
+    int wishlist_id;
+    char recipient_username[21];
+} Notification;
+
+static RecordArena wishlist_store = { sizeof(Wishlist), 0, NULL, 0, 0 };
+static int *id_slots = NULL;        // hash table from wishlist_id to a position in wishlist_store
+static int slot_count = 0;          // always a power of two
+static int max_wishlist_id = 0;
+static int wishlists_loaded = 0;
+static GroupTable anchors, owners, mailboxes;
+
+static RecordArena notification_store = { sizeof(Notification), 0, NULL, 0, 0 };
+static unsigned long notification_version = 0;  // see wishlist_version()
+
+// How far we've read, so refresh_wishlists can pick up what other programs added since
+static long long wishlists_offset = 0;      // bytes of wishlists.txt already in the store
+static long wishlist_log_offset = 0;        // bytes of the status log already applied
+static int wishlist_generation = 0;         // data_generation() when the store was loaded
+static FileMark wishlists_mark, wishlist_log_mark;
+static long long notifications_offset = 0;  // bytes of notifications.txt already read
+static long long seen_offset = 0;           // bytes of notifications_seen.txt already read
+static FileMark notifications_mark, seen_mark;
+
+// Clears leftover characters in stdin so they don't affect future inputs
+static void clear_input_buffer() {
+    int ch;
+    while ((ch = getchar()) != '\n' && ch != EOF);
+}
+
+// Shorthands for records at a store position
+static Wishlist *stored_wishlist(int index) {
+    return arena_at(&wishlist_store, index);
+}
+
+static Notification *stored_notification(int index) {
+    return arena_at(&notification_store, index);
+}
+
+// ---------- groups ----------
+
+// Picks the starting hash slot for a key (FNV-1a)
+static int key_hash(const char *key, int slots) {
+    unsigned int h = 2166136261u;
+    for (int i = 0; key[i]; i++) {
+        h = (h ^ (unsigned char)key[i]) * 16777619u;
+    }
+    return (int)(h & (unsigned int)(slots - 1));
+}
+
+// Doubles a table's hash slots and re-inserts every group
+static int grow_group_slots(GroupTable *table) {
+    int new_count = table->slot_count ? table->slot_count * 2 : 64;
+    int *new_slots = malloc(sizeof(int) * new_count);
+    if (!new_slots) {
+        return 0;
+    }
+    free(table->slots);
+    table->slots = new_slots;
+    table->slot_count = new_count;
+    for (int i = 0; i < new_count; i++) {
+        table->slots[i] = -1;
+    }
+    for (int i = 0; i < table->count; i++) {
+        int slot = key_hash(table->groups[i].key, new_count);
+        while (table->slots[slot] != -1) {
+            slot = (slot + 1) & (new_count - 1);
+        }
+        table->slots[slot] = i;
+    }
+    return 1;
+}
+
+// Finds the group for a key. If create is set, an empty one is made when it doesn't exist yet.
+static Group *find_group(GroupTable *table, const char *key, int create) {
+    if (table->slot_count > 0) {
+        int slot = key_hash(key, table->slot_count);
+        while (table->slots[slot] != -1) {
+            if (strcmp(table->groups[table->slots[slot]].key, key) == 0) {
+                return &table->groups[table->slots[slot]];
+            }
+            slot = (slot + 1) & (table->slot_count - 1);
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    if (table->count == table->capacity) {
+        int new_capacity = table->capacity ? table->capacity * 2 : 16;
+        Group *bigger = realloc(table->groups, sizeof(Group) * new_capacity);
+        if (!bigger) {
+            return NULL;
+        }
+        table->groups = bigger;
+        table->capacity = new_capacity;
+    }
+    if ((table->count + 1) * 10 > table->slot_count * 7 && !grow_group_slots(table)) {
+        return NULL;
+    }
+
+    Group *group = &table->groups[table->count];
+    memset(group, 0, sizeof(*group));
+    strncpy(group->key, key, sizeof(group->key) - 1);
+    int slot = key_hash(group->key, table->slot_count);
+    while (table->slots[slot] != -1) {
+        slot = (slot + 1) & (table->slot_count - 1);
+    }
+    table->slots[slot] = table->count;
+    table->count++;
+    return group;
+}
+
+// Adds a store position to the end of a group. Returns 0 if we ran out of memory.
+static int group_add(Group *group, int index) {
+    if (group->count == group->capacity) {
+        int new_capacity = group->capacity ? group->capacity * 2 : 8;
+        int *bigger = realloc(group->members, sizeof(int) * new_capacity);
+        if (!bigger) {
+            return 0;
+        }
+        group->members = bigger;
+        group->capacity = new_capacity;
+    }
+    group->members[group->count++] = index;
+    return 1;
+}
+
+// Takes a store position out of a group, keeping the rest in order
+static void group_remove(Group *group, int index) {
+    for (int i = 0; i < group->count; i++) {
+        if (group->members[i] == index) {
+            memmove(&group->members[i], &group->members[i + 1],
+                    sizeof(int) * (group->count - i - 1));
+            group->count--;
+            return;
+        }
+    }
+}
+
+// Empties every group (the groups and their memory are kept for reuse)
+static void clear_groups(GroupTable *table) {
+    for (int i = 0; i < table->count; i++) {
+        table->groups[i].count = 0;
+        table->groups[i].seen = 0;
+    }
+}
+
+// ---------- wishlists ----------
+
+// Checks whether a category or conditions field means "anything"
+static int means_any(const char *text) {
+    while (isspace((unsigned char)*text)) {
+        text++;
+    }
+    return *text == '\0' || strncasecmp(text, "any", 3) == 0;
+}
+
+// Writes the lowercase category part of a key ("*" for any category)
+static void category_key(const char *category, char *key, size_t key_size) {
+    if (means_any(category)) {
+        snprintf(key, key_size, "*");
+        return;
+    }
+    snprintf(key, key_size, "%s", category);
+    to_lowercase(key);
+}
+
+// Puts a key together from the category part and up to two words (NULL for none).
+// The words go in alphabetical order, so both orders give the same key.
+static void make_key(char *key, const char *category, const char *first, const char *second) {
+    if (first && second && strcmp(first, second) > 0) {
+        const char *swap = first;
+        first = second;
+        second = swap;
+    }
+    snprintf(key, KEY_SIZE, "%.23s|%.23s%s%.23s", category, first ? first : "",
+             second ? "|" : "", second ? second : "");
+}
+
+// Works out the key a wishlist is filed under
+static void anchor_key(const Wishlist *wishlist, char *key) {
+    char category[MAX_WORD];
+    category_key(wishlist->category, category, sizeof(category));
+    char words[MAX_WISH_WORDS][MAX_WORD];
+    int word_count = text_words(wishlist->keywords, words, MAX_WISH_WORDS);
+
+    // The longest keyword, then the longest one that's different from it
+    int longest = -1, second = -1;
+    for (int i = 0; i < word_count; i++) {
+        if (longest < 0 || strlen(words[i]) > strlen(words[longest])) {
+            longest = i;
+        }
+    }
+    for (int i = 0; i < word_count; i++) {
+        if (strcmp(words[i], words[longest]) != 0 &&
+            (second < 0 || strlen(words[i]) > strlen(words[second]))) {
+            second = i;
+        }
+    }
+    make_key(key, category, longest >= 0 ? words[longest] : NULL,
+             second >= 0 ? words[second] : NULL);
+}
+
+// Files an active wishlist (by store position) under its key, or takes it back out
+static void file_wishlist(int index) {
+    char key[KEY_SIZE];
+    anchor_key(stored_wishlist(index), key);
+    Group *group = find_group(&anchors, key, 1);
+    if (group) {
+        group_add(group, index);
+    }
+}
+
+static void unfile_wishlist(int index) {
+    char key[KEY_SIZE];
+    anchor_key(stored_wishlist(index), key);
+    Group *group = find_group(&anchors, key, 0);
+    if (group) {
+        group_remove(group, index);
+    }
+}
+
+// Puts a store position into the wishlist_id hash table
+static void index_wishlist(int index) {
+    int slot = stored_wishlist(index)->wishlist_id & (slot_count - 1);
+    while (id_slots[slot] != -1) {
+        slot = (slot + 1) & (slot_count - 1);
+    }
+    id_slots[slot] = index;
+}
+
+// Doubles the wishlist_id hash table and re-inserts every wishlist
+static int grow_id_slots() {
+    int new_count = slot_count ? slot_count * 2 : 64;
+    int *new_slots = malloc(sizeof(int) * new_count);
+    if (!new_slots) {
+        return 0;
+    }
+    free(id_slots);
+    id_slots = new_slots;
+    slot_count = new_count;
+    for (int i = 0; i < slot_count; i++) {
+        id_slots[i] = -1;
+    }
+    for (int i = 0; i < wishlist_store.count; i++) {
+        index_wishlist(i);
+    }
+    return 1;
+}
+
+// Finds a wishlist's position in the store by ID, or -1 if there is no such wishlist
+static int wishlist_index(int wishlist_id) {
+    if (slot_count == 0) {
+        return -1;
+    }
+    int slot = wishlist_id & (slot_count - 1);
+    while (id_slots[slot] != -1) {
+        if (stored_wishlist(id_slots[slot])->wishlist_id == wishlist_id) {
+            return id_slots[slot];
+        }
+        slot = (slot + 1) & (slot_count - 1);
+    }
+    return -1;
+}
+
+// Adds one wishlist to the store, its owner's list and (if active) the anchors.
+// Returns 0 if we ran out of memory.
+static int store_wishlist(const Wishlist *wishlist) {
+    if ((wishlist_store.count + 1) * 10 > slot_count * 7 && !grow_id_slots()) {
+        return 0;
+    }
+    Wishlist *stored = arena_add(&wishlist_store);
+    if (!stored) {
+        return 0;
+    }
+    *stored = *wishlist;
+    int index = wishlist_store.count - 1;
+    index_wishlist(index);
+    Group *owner = find_group(&owners, wishlist->recipient_username, 1);
+    if (owner) {
+        group_add(owner, index);
+    }
+    if (strcmp(wishlist->status, "active") == 0) {
+        file_wishlist(index);
+    }
+    if (wishlist->wishlist_id > max_wishlist_id) {
+        max_wishlist_id = wishlist->wishlist_id;
+    }
+    return 1;
+}
+
+// Changes a wishlist's status, keeping the anchors in step
+static void set_wishlist_status(int index, const char *status) {
+    Wishlist *wishlist = stored_wishlist(index);
+    int was_active = strcmp(wishlist->status, "active") == 0;
+    int now_active = strcmp(status, "active") == 0;
+    if (was_active && !now_active) {
+        unfile_wishlist(index);
+    } else if (!was_active && now_active) {
+        file_wishlist(index);
+    }
+    strncpy(wishlist->status, status, sizeof(wishlist->status) - 1);
+    wishlist->status[sizeof(wishlist->status) - 1] = '\0';
+}
+
+// Applies one status change from the status log
+static void apply_logged_status(int wishlist_id, const char *status) {
+    int index = wishlist_index(wishlist_id);
+    if (index >= 0) {
+        set_wishlist_status(index, status);
+    }
+}
+
+// Turns the current record of wishlists.txt into a Wishlist. Returns 0 if it doesn't fit.
+static int wishlist_from_row(const CsvReader *reader, Wishlist *wishlist) {
+    memset(wishlist, 0, sizeof(*wishlist));
+    return reader->field_count == 6 &&
+           csv_int(reader, 0, &wishlist->wishlist_id) &&
+           csv_copy(reader, 1, wishlist->recipient_username, sizeof(wishlist->recipient_username)) &&
+           csv_copy(reader, 2, wishlist->category, sizeof(wishlist->category)) &&
+           csv_copy(reader, 3, wishlist->keywords, sizeof(wishlist->keywords)) &&
+           csv_copy(reader, 4, wishlist->conditions, sizeof(wishlist->conditions)) &&
+           csv_copy(reader, 5, wishlist->status, sizeof(wishlist->status));
+}
+
+// Opens a data file at the given offset for reading. Returns NULL if there's no file.
+static FILE *open_rows(const char *path, long long offset) {
+    FILE *file = stats_fopen(path, "r");
+    if (file && offset > 0) {
+        fseek(file, (long)offset, SEEK_SET);
+    }
+    return file;
+}
+
+// Opens a data file for appending, writing the header first if the file is empty and
+// making sure the last row ends with a newline. Returns NULL on error.
+static FILE *open_for_append(const char *path, const char *header) {
+    FILE *file = stats_fopen(path, "a+");
+    if (!file) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    if (size == 0) {
+        fprintf(file, "%s\n", header);
+    } else if (size > 0) {
+        fseek(file, -1, SEEK_END);
+        if (fgetc(file) != '\n') {
+            fprintf(file, "\n");
+        }
+        fseek(file, 0, SEEK_END);
+    }
+    return file;
+}
+
+// Stores every wishlists.txt row from wishlists_offset to the end, skipping IDs that are
+// already in the store. Call with LOCK_WISHLISTS held.
+static void read_wishlist_rows() {
+    FILE *file = open_rows(WISHLIST_FILE_PATH, wishlists_offset);
+    if (!file) {
+        mark_file(WISHLIST_FILE_PATH, wishlists_offset, &wishlists_mark);
+        return;
+    }
+    CsvReader reader;
+    if (!csv_open(&reader, file, "wishlists.txt")) {
+        printf("Error: Not enough memory to load wishlists.\n");
+        fclose(file);
+        return;
+    }
+    long long start = reader.offset;
+    long long records = 0;
+    int header = wishlists_offset == 0;
+    while (csv_next(&reader)) {
+        if (header) {
+            header = 0;
+            continue;
+        }
+        Wishlist wishlist;
+        if (!wishlist_from_row(&reader, &wishlist)) {
+            csv_skip(&reader);
+            continue;
+        }
+        records++;
+        if (wishlist_index(wishlist.wishlist_id) >= 0) {
+            continue;
+        }
+        if (!store_wishlist(&wishlist)) {
+            printf("Error: Not enough memory to load wishlists.\n");
+            break;
+        }
+    }
+    wishlists_offset = reader.offset;
+    stats_read(wishlists_offset - start, records);
+    csv_close(&reader);
+    fclose(file);
+    mark_file(WISHLIST_FILE_PATH, wishlists_offset, &wishlists_mark);
+}
+
+// ---------- notifications ----------
+
+// Adds one notification to the store and its recipient's mailbox
+static int store_notification(const Notification *notification) {
+    Group *mailbox = find_group(&mailboxes, notification->recipient_username, 1);
+    Notification *stored = mailbox ? arena_add(&notification_store) : NULL;
+    if (!stored) {
+        return 0;
+    }
+    *stored = *notification;
+    group_add(mailbox, notification_store.count - 1);
+    notification_version++;
+    return 1;
+}
+
+// Reads new rows of notifications.txt, then of notifications_seen.txt. If either file was
+// rewritten behind our back, every notification is read again. Call with LOCK_WISHLISTS held.
+static void read_notification_rows() {
+    if (file_rewritten(NOTIFICATION_FILE_PATH, &notifications_mark) ||
+        file_rewritten(NOTIFICATION_SEEN_PATH, &seen_mark)) {
+        arena_clear(&notification_store);
+        clear_groups(&mailboxes);
+        notifications_offset = 0;
+        seen_offset = 0;
+        notification_version++;
+    }
+
+    FILE *file = open_rows(NOTIFICATION_FILE_PATH, notifications_offset);
+    CsvReader reader;
+    if (file && csv_open(&reader, file, "notifications.txt")) {
+        long long start = reader.offset, records = 0;
+        int header = notifications_offset == 0;
+        while (csv_next(&reader)) {
+            if (header) {
+                header = 0;
+                continue;
+            }
+            Notification notification;
+            memset(&notification, 0, sizeof(notification));
+            if (reader.field_count != 3 ||
+                !csv_copy(&reader, 0, notification.recipient_username,
+                          sizeof(notification.recipient_username)) ||
+                !csv_int(&reader, 1, &notification.item_id) ||
+                !csv_int(&reader, 2, &notification.wishlist_id)) {
+                csv_skip(&reader);
+                continue;
+            }
+            records++;
+            store_notification(&notification);
+        }
+        notifications_offset = reader.offset;
+        stats_read(notifications_offset - start, records);
+        csv_close(&reader);
+    }
+    if (file) {
+        fclose(file);
+    }
+    mark_file(NOTIFICATION_FILE_PATH, notifications_offset, &notifications_mark);
+
+    // The newest "seen" row for a recipient wins (they only ever count up)
+    file = open_rows(NOTIFICATION_SEEN_PATH, seen_offset);
+    if (file && csv_open(&reader, file, "notifications_seen.txt")) {
+        long long start = reader.offset, records = 0;
+        int header = seen_offset == 0;
+        while (csv_next(&reader)) {
+            int seen;
+            if (header) {
+                header = 0;
+                continue;
+            }
+            if (reader.field_count != 2 || !csv_int(&reader, 1, &seen)) {
+                csv_skip(&reader);
+                continue;
+            }
+            records++;
+            Group *mailbox = find_group(&mailboxes, reader.fields[0], 1);
+            if (mailbox && seen > mailbox->seen) {
+                mailbox->seen = seen;
+                notification_version++;
+            }
+        }
+        seen_offset = reader.offset;
+        stats_read(seen_offset - start, records);
+        csv_close(&reader);
+    }
+    if (file) {
+        fclose(file);
+    }
+    mark_file(NOTIFICATION_SEEN_PATH, seen_offset, &seen_mark);
+}
+
+// ---------- loading ----------
+
+void load_wishlists() {
+    if (wishlists_loaded) {
+        return;
+    }
+    STATS_TIME(STAT_LOAD_WISHLISTS);
+    wishlists_loaded = 1;
+
+    // Keep compaction from rewriting wishlists.txt while we read it
+    lock_data(LOCK_STATUS_LOG, 0);
+    lock_data(LOCK_WISHLISTS, 0);
+    wishlist_generation = data_generation();
+    wishlists_offset = 0;
+    read_wishlist_rows();
+    read_notification_rows();
+    unlock_data(LOCK_WISHLISTS);
+
+    // Cancellations that haven't been compacted yet
+    wishlist_log_offset = 0;
+    replay_status_log('W', apply_logged_status, &wishlist_log_offset);
+    mark_file(STATUS_LOG_PATH, wishlist_log_offset, &wishlist_log_mark);
+    unlock_data(LOCK_STATUS_LOG);
+}
+
+// Empties the wishlist store so it can be loaded again (notifications are kept)
+static void reset_wishlists() {
+    arena_clear(&wishlist_store);
+    for (int i = 0; i < slot_count; i++) {
+        id_slots[i] = -1;
+    }
+    clear_groups(&anchors);
+    clear_groups(&owners);
+    max_wishlist_id = 0;
+    wishlists_loaded = 0;
+}
+
+void refresh_wishlists() {
+    if (!wishlists_loaded) {
+        load_wishlists();
+        return;
+    }
+    STATS_TIME(STAT_REFRESH_WISHLISTS);
+    lock_data(LOCK_STATUS_LOG, 0);
+    int rewritten = data_generation() != wishlist_generation ||
+                    file_rewritten(WISHLIST_FILE_PATH, &wishlists_mark) ||
+                    file_rewritten(STATUS_LOG_PATH, &wishlist_log_mark);
+    if (rewritten) {
+        reset_wishlists();
+        load_wishlists();
+    } else {
+        lock_data(LOCK_WISHLISTS, 0);
+        read_wishlist_rows();
+        read_notification_rows();
+        unlock_data(LOCK_WISHLISTS);
+        long applied = wishlist_log_offset;
+        replay_status_log('W', apply_logged_status, &wishlist_log_offset);
+        if (wishlist_log_offset != applied) {
+            mark_file(STATUS_LOG_PATH, wishlist_log_offset, &wishlist_log_mark);
+        }
+    }
+    unlock_data(LOCK_STATUS_LOG);
+}
+
+// ---------- changing wishlists ----------
+
+// Copies text into dest without leading/trailing spaces. Returns 0 if it doesn't fit.
+static int copy_trimmed(char *dest, size_t dest_size, const char *text) {
+    while (isspace((unsigned char)*text)) {
+        text++;
+    }
+    size_t length = strlen(text);
+    while (length > 0 && isspace((unsigned char)text[length - 1])) {
+        length--;
+    }
+    if (length >= dest_size) {
+        return 0;
+    }
+    memcpy(dest, text, length);
+    dest[length] = '\0';
+    return 1;
+}
+
+int add_wishlist(const char *recipient_username, const char *category,
+                 const char *keywords, const char *conditions) {
+    load_wishlists();
+    STATS_TIME(STAT_ADD_WISHLIST);
+    Wishlist wishlist;
+    memset(&wishlist, 0, sizeof(wishlist));
+    if (!copy_trimmed(wishlist.recipient_username, sizeof(wishlist.recipient_username),
+                      recipient_username) ||
+        !copy_trimmed(wishlist.category, sizeof(wishlist.category), category) ||
+        !copy_trimmed(wishlist.keywords, sizeof(wishlist.keywords), keywords) ||
+        !copy_trimmed(wishlist.conditions, sizeof(wishlist.conditions), conditions)) {
+        return WISHLIST_TOO_LONG;
+    }
+    char words[MAX_WISH_WORDS + 1][MAX_WORD];
+    int word_count = text_words(wishlist.keywords, words, MAX_WISH_WORDS + 1);
+    if (word_count > MAX_WISH_WORDS) {
+        return WISHLIST_TOO_LONG;
+    }
+    if (means_any(wishlist.category)) {
+        if (word_count == 0) {
+            return WISHLIST_TOO_BROAD;  // it would match every single item
+        }
+        strcpy(wishlist.category, "any");
+    }
+    if (means_any(wishlist.conditions)) {
+        strcpy(wishlist.conditions, "any");
+    }
+    strcpy(wishlist.status, "active");
+
+    // Hold the wishlists lock from reading the latest rows until ours is written
+    lock_data(LOCK_WISHLISTS, 1);
+    read_wishlist_rows();
+    FILE *file = open_for_append(WISHLIST_FILE_PATH,
+                                 "wishlist_id,recipient_username,category,keywords,conditions,status");
+    if (!file) {
+        printf("Error: Unable to open wishlists.txt for writing.\n");
+        unlock_data(LOCK_WISHLISTS);
+        return WISHLIST_WRITE_FAILED;
+    }
+    wishlist.wishlist_id = next_id(WISHLIST_SEQ_PATH, max_wishlist_id);
+    char id_text[16];
+    snprintf(id_text, sizeof(id_text), "%d", wishlist.wishlist_id);
+    const char *row[] = { id_text, wishlist.recipient_username, wishlist.category,
+                          wishlist.keywords, wishlist.conditions, wishlist.status };
+    int written = csv_write_row(file, row, 6);
+    stats_written(written > 0 ? written : 0);
+    int closed = close_durably(file);
+    unlock_data(LOCK_WISHLISTS);
+    if (written < 0 || !closed) {
+        printf("Error: Unable to write to wishlists.txt.\n");
+        return WISHLIST_WRITE_FAILED;
+    }
+    if (!store_wishlist(&wishlist)) {
+        printf("Error: Not enough memory to keep the new wishlist loaded.\n");
+    }
+    return wishlist.wishlist_id;
+}
+
+int cancel_wishlist(const char *recipient_username, int wishlist_id) {
+    STATS_TIME(STAT_CANCEL_WISHLIST);
+    // Catch up first, and keep other programs out until the change is logged
+    lock_data(LOCK_STATUS_LOG, 1);
+    refresh_wishlists();
+    int index = wishlist_index(wishlist_id);
+    if (index < 0 || strcmp(stored_wishlist(index)->status, "active") != 0 ||
+        strcmp(stored_wishlist(index)->recipient_username, recipient_username) != 0) {
+        unlock_data(LOCK_STATUS_LOG);
+        return WISHLIST_NOT_FOUND;
+    }
+    set_wishlist_status(index, "cancelled");
+    log_wishlist_status(wishlist_id, "cancelled");
+    int ok = commit_status_log();
+    unlock_data(LOCK_STATUS_LOG);
+    return ok ? 0 : WISHLIST_WRITE_FAILED;
+}
+
+int visit_wishlists(const char *recipient_username, WishlistVisitor visit, void *context) {
+    load_wishlists();
+    STATS_TIME(STAT_VISIT_WISHLISTS);
+    Group *owner = find_group(&owners, recipient_username, 0);
+    int visited = 0;
+    for (int i = 0; owner && i < owner->count; i++) {
+        Wishlist *wishlist = stored_wishlist(owner->members[i]);
+        if (strcmp(wishlist->status, "active") == 0) {
+            visit(wishlist, context);
+            visited++;
+        }
+    }
+    return visited;
+}
+
+// ---------- matching ----------
+
+// Checks the parts of a wishlist its key doesn't already guarantee: every keyword is one
+// of the item's words, and the item's condition is acceptable
+static int wishlist_fits(const Wishlist *wishlist, const Item *item,
+                         char item_word_list[][MAX_WORD], int item_word_count) {
+    if (strcmp(wishlist->status, "active") != 0) {
+        return 0;
+    }
+    if (!means_any(wishlist->conditions)) {
+        char accepted[8][MAX_WORD];
+        char condition[MAX_WORD];
+        int accepted_count = text_words(wishlist->conditions, accepted, 8);
+        if (text_words(item_condition(item), &condition, 1) == 0) {
+            return 0;
+        }
+        int ok = 0;
+        for (int i = 0; i < accepted_count && !ok; i++) {
+            ok = strcmp(accepted[i], condition) == 0;
+        }
+        if (!ok) {
+            return 0;
+        }
+    }
+    char words[MAX_WISH_WORDS][MAX_WORD];
+    int word_count = text_words(wishlist->keywords, words, MAX_WISH_WORDS);
+    for (int i = 0; i < word_count; i++) {
+        int found = 0;
+        for (int j = 0; j < item_word_count && !found; j++) {
+            found = strcmp(words[i], item_word_list[j]) == 0;
+        }
+        if (!found) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Checks every wishlist filed under one key
+static int visit_group(const char *key, const Item *item, char words[][MAX_WORD],
+                       int word_count, WishlistVisitor visit, void *context) {
+    Group *group = find_group(&anchors, key, 0);
+    int visited = 0;
+    for (int i = 0; group && i < group->count; i++) {
+        Wishlist *wishlist = stored_wishlist(group->members[i]);
+        if (wishlist_fits(wishlist, item, words, word_count)) {
+            visit(wishlist, context);
+            visited++;
+        }
+    }
+    return visited;
+}
+
+int visit_wishlist_matches(const Item *item, WishlistVisitor visit, void *context) {
+    STATS_TIME(STAT_VISIT_WISHLIST_MATCHES);
+    char words[MAX_ITEM_WORDS][MAX_WORD];
+    int word_count = item_words(item, words);
+    char category[MAX_WORD], key[KEY_SIZE];
+    category_key(item_category(item), category, sizeof(category));
+
+    // Wishlists for the category with no keywords, then for each of the item's words and
+    // each pair of them, with this category or any category. The item's words are all
+    // different, so no wishlist is found twice. (An item whose category is "any" only
+    // has the one category part.)
+    const char *parts[] = { category, "*" };
+    int part_count = strcmp(category, "*") == 0 ? 1 : 2;
+    make_key(key, category, NULL, NULL);
+    int visited = visit_group(key, item, words, word_count, visit, context);
+    for (int p = 0; p < part_count; p++) {
+        for (int i = 0; i < word_count; i++) {
+            make_key(key, parts[p], words[i], NULL);
+            visited += visit_group(key, item, words, word_count, visit, context);
+            for (int j = i + 1; j < word_count; j++) {
+                make_key(key, parts[p], words[i], words[j]);
+                visited += visit_group(key, item, words, word_count, visit, context);
+            }
+        }
+    }
+    return visited;
+}
+
+// What notify_wishlists passes through visit_wishlist_matches
+typedef struct {
+    const Item *item;
+    FILE *file;
+    int notified;
+    int failed;           // a row couldn't be written, or the file couldn't be opened
+    long long written;
+} NotifyContext;
+
+// Writes and stores one notification, unless the recipient already got one for this item
+static void notify_one(const Wishlist *wishlist, void *context) {
+    NotifyContext *notify = context;
+    if (notify->failed) {
+        return;
+    }
+    Group *mailbox = find_group(&mailboxes, wishlist->recipient_username, 0);
+    if (mailbox && mailbox->count > 0 &&
+        stored_notification(mailbox->members[mailbox->count - 1])->item_id == notify->item->item_id) {
+        return;
+    }
+    Notification notification;
+    memset(&notification, 0, sizeof(notification));
+    notification.item_id = notify->item->item_id;
+    notification.wishlist_id = wishlist->wishlist_id;
+    strcpy(notification.recipient_username, wishlist->recipient_username);
+
+    char item_text[16], wishlist_text[16];
+    snprintf(item_text, sizeof(item_text), "%d", notification.item_id);
+    snprintf(wishlist_text, sizeof(wishlist_text), "%d", notification.wishlist_id);
+    const char *row[] = { notification.recipient_username, item_text, wishlist_text };
+    if (!notify->file) {
+        notify->file = open_for_append(NOTIFICATION_FILE_PATH, "recipient_username,item_id,wishlist_id");
+        if (!notify->file) {
+            printf("Error: Unable to open notifications.txt for writing.\n");
+            notify->failed = 1;
+            return;
+        }
+    }
+    int written = csv_write_row(notify->file, row, 3);
+    if (written < 0) {
+        notify->failed = 1;
+        return;
+    }
+    notify->written += written;
+    store_notification(&notification);
+    notify->notified++;
+}
+
+int notify_wishlists(const Item *item) {
+    load_wishlists();
+    STATS_TIME(STAT_NOTIFY_WISHLISTS);
+
+    // Catch up (so wishlists just added by other programs count too), then hold the
+    // wishlists lock until the notifications are written, so our rows follow everything
+    // we've read and we never read them back as someone else's
+    lock_data(LOCK_STATUS_LOG, 0);
+    lock_data(LOCK_WISHLISTS, 1);
+    refresh_wishlists();
+
+    // Most items fit no wishlist at all; then the file isn't even opened
+    NotifyContext notify = { item, NULL, 0, 0, 0 };
+    visit_wishlist_matches(item, notify_one, &notify);
+    if (notify.file) {
+        stats_written(notify.written);
+        notifications_offset = (long long)ftell(notify.file);  // our rows are already stored
+        if (!close_durably(notify.file) || notify.failed) {
+            printf("Error: Unable to write to notifications.txt.\n");
+        }
+        mark_file(NOTIFICATION_FILE_PATH, notifications_offset, &notifications_mark);
+    }
+    unlock_data(LOCK_WISHLISTS);
+    unlock_data(LOCK_STATUS_LOG);
+    return notify.notified;
+}
+
+int count_new_notifications(const char *recipient_username) {
+    load_wishlists();
+    STATS_TIME(STAT_COUNT_NEW_NOTIFICATIONS);
+    Group *mailbox = find_group(&mailboxes, recipient_username, 0);
+    if (!mailbox || mailbox->seen >= mailbox->count) {
+        return 0;
+    }
+    return mailbox->count - mailbox->seen;
+}
+
+int visit_new_notifications(const char *recipient_username, NotificationVisitor visit,
+                            void *context) {
+    load_wishlists();
+    STATS_TIME(STAT_VISIT_NEW_NOTIFICATIONS);
+    lock_data(LOCK_WISHLISTS, 1);
+    read_notification_rows();
+    Group *mailbox = find_group(&mailboxes, recipient_username, 0);
+    if (!mailbox || mailbox->seen >= mailbox->count) {
+        unlock_data(LOCK_WISHLISTS);
+        return 0;
+    }
+
+    // Items that were given away since are skipped, but still count as seen
+    int visited = 0;
+    for (int i = mailbox->seen; i < mailbox->count; i++) {
+        Notification *notification = stored_notification(mailbox->members[i]);
+        Item *item = find_item(notification->item_id);
+        if (item && item->status == STATUS_AVAILABLE) {
+            visit(item, notification->wishlist_id, context);
+            visited++;
+        }
+    }
+
+    // Remember how far the recipient has read, for every program sharing the data folder
+    FILE *file = open_for_append(NOTIFICATION_SEEN_PATH, "recipient_username,seen");
+    if (file) {
+        char seen_text[16];
+        snprintf(seen_text, sizeof(seen_text), "%d", mailbox->count);
+        const char *row[] = { mailbox->key, seen_text };
+        int written = csv_write_row(file, row, 2);
+        stats_written(written > 0 ? written : 0);
+        seen_offset = (long long)ftell(file);
+        if (!close_durably(file) || written < 0) {
+            printf("Error: Unable to write to notifications_seen.txt.\n");
+        }
+        mark_file(NOTIFICATION_SEEN_PATH, seen_offset, &seen_mark);
+    } else {
+        printf("Error: Unable to open notifications_seen.txt for writing.\n");
+    }
+    mailbox->seen = mailbox->count;
+    notification_version++;
+    unlock_data(LOCK_WISHLISTS);
+    return visited;
+}
+
+unsigned long wishlist_version() {
+    return notification_version;
+}
+
+// ---------- menus ----------
+
+// Prints one wishlist as a table row
+static void print_wishlist(const Wishlist *wishlist, void *context) {
+    (void)context;
+    printf("%-5d| %-12s| %-30s| %s\n", wishlist->wishlist_id, wishlist->category,
+           wishlist->keywords[0] ? wishlist->keywords : "-", wishlist->conditions);
+}
+
+// Reads one line of input into dest (without the newline). Returns 0 at end of input.
+static int read_line(char *dest, size_t dest_size) {
+    if (!fgets(dest, (int)dest_size, stdin)) {
+        return 0;
+    }
+    if (!strchr(dest, '\n')) {
+        clear_input_buffer();  // too long; drop the rest
+    }
+    dest[strcspn(dest, "\r\n")] = '\0';
+    return 1;
+}
+
+void manage_wishlists(char *recipient_username) {
+    STATS_TIME(STAT_MANAGE_WISHLISTS);
+    printf("\nYour Wishlists:\n");
+    printf("---------------------------------------------------------------\n");
+    printf("ID   | Category    | Keywords                      | Conditions\n");
+    printf("---------------------------------------------------------------\n");
+    if (visit_wishlists(recipient_username, print_wishlist, NULL) == 0) {
+        printf("You have no wishlists yet.\n");
+    }
+
+    printf("\n1. Add a wishlist\n");
+    printf("2. Cancel a wishlist\n");
+    printf("3. Back\n");
+    printf("Enter your choice: ");
+    int choice;
+    if (scanf("%d", &choice) != 1) {
+        printf("Invalid input.\n");
+        clear_input_buffer();
+        return;
+    }
+    clear_input_buffer();
+
+    if (choice == 1) {
+        char category[64], keywords[128], conditions[64];
+        printf("Category (or \"any\"): ");
+        if (!read_line(category, sizeof(category))) {
+            return;
+        }
+        printf("Keywords that must all be in the item (or leave empty): ");
+        if (!read_line(keywords, sizeof(keywords))) {
+            return;
+        }
+        printf("Acceptable conditions, like New/Good (or \"any\"): ");
+        if (!read_line(conditions, sizeof(conditions))) {
+            return;
+        }
+        int result = add_wishlist(recipient_username, category, keywords, conditions);
+        if (result > 0) {
+            printf("Wishlist %d saved. You'll be notified about new items that fit it.\n", result);
+        } else if (result == WISHLIST_TOO_BROAD) {
+            printf("Please give a category or at least one keyword.\n");
+        } else if (result == WISHLIST_TOO_LONG) {
+            printf("That is too long (at most %d keywords).\n", MAX_WISH_WORDS);
+        } else {
+            printf("Error: Unable to save the wishlist.\n");
+        }
+    } else if (choice == 2) {
+        int wishlist_id;
+        printf("Enter the ID of the wishlist to cancel: ");
+        if (scanf("%d", &wishlist_id) != 1) {
+            printf("Invalid input.\n");
+            clear_input_buffer();
+            return;
+        }
+        clear_input_buffer();
+        int result = cancel_wishlist(recipient_username, wishlist_id);
+        if (result == 0) {
+            printf("Wishlist %d cancelled.\n", wishlist_id);
+        } else if (result == WISHLIST_NOT_FOUND) {
+            printf("You have no wishlist with ID %d.\n", wishlist_id);
+        } else {
+            printf("Error: Unable to cancel the wishlist.\n");
+        }
+    }
+}
+
+// Prints one notification as a table row
+static void print_notification(const Item *item, int wishlist_id, void *context) {
+    (void)context;
+    printf("%-7d| %-12s| %-12s| %-36s| %-10s| %d\n", item->item_id, item->donor_username,
+           item_category(item), item->description, item_condition(item), wishlist_id);
+}
+
+void view_notifications(char *recipient_username) {
+    STATS_TIME(STAT_VIEW_NOTIFICATIONS);
+    printf("\nNew Items Matching Your Wishlists:\n");
+    printf("--------------------------------------------------------------------------------\n");
+    printf("ItemID | Donor       | Category    | Description                         | Condition | Wishlist\n");
+    printf("--------------------------------------------------------------------------------\n");
+    if (visit_new_notifications(recipient_username, print_notification, NULL) == 0) {
+        printf("No new matches.\n");
+    }
+}
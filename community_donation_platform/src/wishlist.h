@@ -0,0 +1,95 @@
+// wishlist.h
+// Standing wishlists for recipients, and the notifications they produce. A recipient
+// says what they are looking for: a category (or any), some keywords that must all be in
+// the item, and the conditions they'd accept (like "New/Good", or any). Whenever a donor
+// adds an item, every wishlist it fits puts a notification in its recipient's queue,
+// which they see in the menu (or with the "notifications" batch command).
+//
+// Matching doesn't loop over the wishlists. Each wishlist is filed under one key made of
+// its category and (up to) its two longest keywords, so a new item only looks up the keys
+// its own category and words can form, and only checks the wishlists filed there. Matching
+// an item costs about the same with ten wishlists or a few hundred thousand, apart from
+// the notifications it actually produces.
+
+#ifndef WISHLIST_H
+#define WISHLIST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "items.h"  // For Item
+
+// Where wishlists and notifications are kept
+#define WISHLIST_FILE_PATH "../data/wishlists.txt"
+#define WISHLIST_SEQ_PATH "../data/wishlists.seq"
+#define NOTIFICATION_FILE_PATH "../data/notifications.txt"
+#define NOTIFICATION_SEEN_PATH "../data/notifications_seen.txt"
+
+#define MAX_WISH_KEYWORDS 61   // characters of keyword text
+#define MAX_WISH_WORDS 8       // keywords per wishlist
+
+// One wishlist, as stored in wishlists.txt
+typedef struct {
+    int wishlist_id;
+    char recipient_username[21];
+    char category[21];                  // "any" for every category
+    char keywords[MAX_WISH_KEYWORDS];   // words that must all be in the item ("" for none)
+    char conditions[31];                // acceptable conditions, like "New/Good", or "any"
+    char status[11];                    // "active" or "cancelled"
+} Wishlist;
+
+// What add_wishlist and cancel_wishlist return when they fail (all below zero)
+#define WISHLIST_TOO_BROAD -1     // neither a category nor a keyword
+#define WISHLIST_TOO_LONG -2      // a field doesn't fit, or too many keywords
+#define WISHLIST_NOT_FOUND -3     // no such active wishlist for this recipient
+#define WISHLIST_WRITE_FAILED -4
+
+// Functions called once per wishlist or per notification by the visit_* functions below
+typedef void (*WishlistVisitor)(const Wishlist *wishlist, void *context);
+typedef void (*NotificationVisitor)(const Item *item, int wishlist_id, void *context);
+
+// Reads wishlists.txt and the notification files into memory (first call only)
+void load_wishlists();
+
+// Catches up with wishlists and notifications other programs have written since, the
+// same way refresh_items does
+void refresh_wishlists();
+
+// Saves a new active wishlist. category and conditions may be "any"; keywords may be
+// empty. Returns its wishlist_id, or one of the WISHLIST_* error codes.
+int add_wishlist(const char *recipient_username, const char *category,
+                 const char *keywords, const char *conditions);
+
+// Cancels one of the recipient's wishlists. Returns 0, or a WISHLIST_* error code.
+int cancel_wishlist(const char *recipient_username, int wishlist_id);
+
+// Calls visit(wishlist, context) for each of the recipient's active wishlists, oldest
+// first. Returns how many were visited.
+int visit_wishlists(const char *recipient_username, WishlistVisitor visit, void *context);
+
+// Calls visit(wishlist, context) for every active wishlist the item fits. Only looks at
+// memory. Returns how many were visited.
+int visit_wishlist_matches(const Item *item, WishlistVisitor visit, void *context);
+
+// Puts a notification about a newly added item in the queue of every recipient with a
+// wishlist it fits (once per recipient). create_item calls this. Returns how many.
+int notify_wishlists(const Item *item);
+
+// How many notifications the recipient hasn't seen yet (kept up to date in memory)
+int count_new_notifications(const char *recipient_username);
+
+// Calls visit(item, wishlist_id, context) for each notification the recipient hasn't
+// seen yet whose item is still available, oldest first, then marks them all as seen.
+// Returns how many were visited.
+int visit_new_notifications(const char *recipient_username, NotificationVisitor visit,
+                            void *context);
+
+// A number that goes up whenever a notification is added or seen, here or picked up from
+// another program, so menus know when count_new_notifications may have changed
+unsigned long wishlist_version();
+
+// Menu screens: list/add/cancel the recipient's wishlists, and show their new matches
+void manage_wishlists(char *recipient_username);
+void view_notifications(char *recipient_username);
+
+#endif /* WISHLIST_H */
@@ -0,0 +1,33 @@
+# lib.sh
+# Helpers shared by the test scripts (run_tests.sh sources this before each test).
+# Every test runs in a sandbox of its own: an empty data folder next to a run folder,
+# since the program always finds its files at ../data.
+
+FAILED=0
+
+# Makes a new sandbox and moves into its run folder
+new_sandbox() {
+    SANDBOX=$(mktemp -d)
+    mkdir "$SANDBOX/data" "$SANDBOX/run"
+    cd "$SANDBOX/run" || exit 1
+}
+
+# Notes a failed check and carries on, so one run shows every problem
+fail() {
+    echo "FAIL: $*"
+    FAILED=1
+}
+
+# expect_output <what> <expected> <actual>: fails (showing a diff) unless they are the same
+expect_output() {
+    if [ "$2" != "$3" ]; then
+        fail "$1"
+        diff -u <(printf '%s\n' "$2") <(printf '%s\n' "$3") | tail -n +3
+    fi
+}
+
+# Removes the sandbox and exits with 1 if any check failed
+finish() {
+    cd / && rm -rf "$SANDBOX"
+    exit $FAILED
+}
@@ -0,0 +1,36 @@
+#!/bin/bash
+# run_tests.sh
+# Builds the program and runs every test_*.sh next to this script against it.
+#   ./run_tests.sh            build from ../src into a temp folder, then run all tests
+#   ./run_tests.sh roles      run only the tests whose names contain "roles"
+# Set DP=/path/to/donation_platform to test a program that is already built.
+# Needs bash and gcc; server tests also need a free TCP port on 127.0.0.1.
+
+TESTS=$(cd "$(dirname "$0")" && pwd)
+SRC="$TESTS/../src"
+
+if [ -z "$DP" ]; then
+    BUILD=$(mktemp -d)
+    trap 'rm -rf "$BUILD"' EXIT
+    DP="$BUILD/donation_platform"
+    (cd "$SRC" && gcc -Wall -O2 -o "$DP" main.c user.c items.c requests.c status_log.c \
+        id_sequence.c binary_table.c arena.c batch.c server.c file_lock.c text_index.c stats.c \
+        durable.c csv.c data_watch.c wishlist.c dictionary.c item_columns.c btree.c id_index.c \
+        -lpthread) || { echo "Build failed."; exit 1; }
+fi
+export DP TESTS
+
+passed=0
+failed=0
+for test in "$TESTS"/test_*"$1"*.sh; do
+    name=$(basename "$test" .sh)
+    if bash "$test"; then
+        echo "PASS: $name"
+        passed=$((passed + 1))
+    else
+        echo "FAIL: $name"
+        failed=$((failed + 1))
+    fi
+done
+echo "$passed passed, $failed failed"
+[ "$failed" -eq 0 ]
@@ -0,0 +1,65 @@
+# test_auto_reject.sh
+# Once an item is given away, every other pending request for it is rejected in the
+# same group of changes, whether it went through approve, decide or allocate.
+source "$TESTS/lib.sh"
+new_sandbox
+
+actual=$("$DP" --batch <<'COMMANDS'
+signup dana pw donor
+signup rob pw recipient
+signup rita pw recipient
+signup ray pw recipient
+add_item dana Books Good novel
+add_item dana Toys New kite
+add_item dana Games Fair chess
+request rob 1
+request rita 1
+request ray 1
+request rob 2
+request rita 2
+request rita 3
+request ray 3
+request rob 3
+approve dana 1
+decide dana 4 approve 5 approve
+allocate dana 3
+inbox dana
+approve dana 2
+COMMANDS
+)
+expect_output "deciding" 'ok
+ok
+ok
+ok
+ok 1
+ok 2
+ok 3
+ok 1
+ok 2
+ok 3
+ok 4
+ok 5
+ok 6
+ok 7
+ok 8
+ok
+4,approved
+5,already decided
+ok 1 of 2
+ok 6
+ok 0
+error already decided' "$actual"
+
+# Every request has been decided, and each item went to exactly one recipient
+"$DP" --to-index > /dev/null || fail "building the indexes"
+actual=$(for id in $(seq 1 8); do echo "lookup request $id"; done | "$DP" --lookup | grep -v "^ok")
+expect_output "request statuses" '1,1,rob,approved
+2,1,rita,rejected
+3,1,ray,rejected
+4,2,rob,approved
+5,2,rita,rejected
+6,3,rita,approved
+7,3,ray,rejected
+8,3,rob,rejected' "$actual"
+
+finish
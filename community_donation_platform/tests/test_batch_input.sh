@@ -0,0 +1,33 @@
+# test_batch_input.sh
+# How batch mode splits command lines: quoted arguments, "" for a quote inside them
+# and for an empty argument, and lines too long to read in one piece.
+source "$TESTS/lib.sh"
+new_sandbox
+
+actual=$("$DP" --batch <<'COMMANDS'
+signup dana pw donor
+add_item dana Books Good "He said ""hi"", then left"
+add_item dana Toys New ""
+add_item dana Games Fair "Chess set"
+# a comment, then a blank line
+
+list
+COMMANDS
+)
+expect_output "quoted arguments" 'ok
+ok 1
+ok 2
+ok 3
+1,dana,Books,"He said ""hi"", then left",Good
+2,dana,Toys,,New
+3,dana,Games,Chess set,Fair
+ok 3' "$actual"
+
+# The tail of a line that didn't fit must not run as a command of its own. The first
+# 511 bytes fill the line buffer, so the tail would be exactly "signup mallory pw donor".
+padding=$(printf 'x%.0s' $(seq 1 506))
+actual=$(printf 'find %s signup mallory pw donor\nlogin mallory pw\n' "$padding" | "$DP" --batch)
+expect_output "a line too long to read" 'error line too long
+error invalid credentials' "$actual"
+
+finish
@@ -0,0 +1,38 @@
+# test_batch_roles.sh
+# Batch mode has no login, but a command still has to name an existing user with the
+# right role: only donors add items and decide requests, only recipients request and
+# keep wishlists.
+source "$TESTS/lib.sh"
+new_sandbox
+
+actual=$("$DP" --batch <<'COMMANDS'
+signup dana pw donor
+signup rob pw recipient
+add_item dana Books Good novel
+add_item rob Books Good fake
+add_item ghost Books Good fake
+request dana 1
+request rob 1
+approve rob 1
+decide rob 1 approve
+allocate rob 1
+wish dana any any
+notifications dana
+approve dana 1
+COMMANDS
+)
+expect_output "role checks" 'ok
+ok
+ok 1
+error only a donor can do that
+error no such user
+error only a recipient can do that
+ok 1
+error only a donor can do that
+error only a donor can do that
+error only a donor can do that
+error only a recipient can do that
+error only a recipient can do that
+ok' "$actual"
+
+finish
@@ -0,0 +1,59 @@
+# test_concurrency.sh
+# Several batch runs share one data folder at once (see file_lock.h and id_sequence.h).
+# Checks that competing approvals give each item to exactly one recipient, that a
+# username can only be taken once, and that item IDs are unique and dense: each writer
+# may leave at most one block of reserved IDs unused.
+source "$TESTS/lib.sh"
+new_sandbox
+
+WRITERS=4
+ITEMS=200
+ID_BLOCK=64  # ID_BLOCK_SIZE in id_sequence.c
+
+# Every item gets one request from each of four recipients
+{
+    echo "signup dana pw donor"
+    for r in $(seq 0 $((WRITERS - 1))); do
+        echo "signup r$r pw recipient"
+    done
+    for i in $(seq 1 $ITEMS); do
+        echo "add_item dana Books Good book$i"
+    done
+    for i in $(seq 1 $ITEMS); do
+        for r in $(seq 0 $((WRITERS - 1))); do
+            echo "request r$r $i"
+        done
+    done
+} > ../setup.txt
+"$DP" --batch ../setup.txt > /dev/null || fail "setting up the data"
+
+# Writer w approves recipient w's request for every item, so all of them compete
+for w in $(seq 0 $((WRITERS - 1))); do
+    {
+        echo "signup taken pw donor"
+        for i in $(seq 1 $ITEMS); do
+            echo "approve dana $(( (i - 1) * WRITERS + 1 + w ))"
+            echo "add_item dana Toys New toy${w}_$i"
+        done
+    } > ../writer$w.txt
+done
+for w in $(seq 0 $((WRITERS - 1))); do
+    "$DP" --batch ../writer$w.txt > ../out$w.txt &
+done
+wait
+
+approved=$(cat ../out*.txt | grep -c "^ok$")
+expect_output "approvals that went through (one per item, plus one signup)" \
+    "$((ITEMS + 1))" "$approved"
+expect_output "accounts named taken" "1" "$(grep -c "^taken," ../data/users.txt)"
+
+rows=$(tail -n +2 ../data/items.txt | wc -l)
+expect_output "items added" "$((ITEMS * (WRITERS + 1)))" "$rows"
+duplicates=$(tail -n +2 ../data/items.txt | cut -d, -f1 | sort | uniq -d | wc -l)
+expect_output "duplicate item IDs" "0" "$duplicates"
+max_id=$(tail -n +2 ../data/items.txt | cut -d, -f1 | sort -n | tail -1)
+if [ "$max_id" -gt $((rows + ID_BLOCK * WRITERS)) ]; then
+    fail "item IDs go up to $max_id for $rows items"
+fi
+
+finish
@@ -0,0 +1,72 @@
+# test_server_roles.sh
+# In server mode a connection must log in, and then can only act as that user and in
+# that user's role. Also checks that a line too long to read is refused as a whole.
+source "$TESTS/lib.sh"
+new_sandbox
+
+printf 'signup dana pw donor\nsignup rob pw recipient\nadd_item dana Books Good novel\n' |
+    "$DP" --batch > /dev/null
+
+# Start a server on a free port (try a few random ones)
+server=""
+for attempt in 1 2 3 4 5; do
+    port=$((20000 + RANDOM % 20000))
+    "$DP" --serve $port --workers 2 > ../server.log 2>&1 &
+    server=$!
+    for wait in $(seq 1 50); do
+        grep -q "^Serving" ../server.log && break
+        kill -0 $server 2> /dev/null || break
+        sleep 0.1
+    done
+    grep -q "^Serving" ../server.log && break
+    kill $server 2> /dev/null
+    wait $server 2> /dev/null
+    server=""
+done
+if [ -z "$server" ]; then
+    fail "starting the server"
+    finish
+fi
+
+# session <commands>: sends the commands on one connection and prints every reply
+session() {
+    exec 3<> /dev/tcp/127.0.0.1/$port
+    printf '%s\nquit\n' "$1" >&3
+    cat <&3
+    exec 3<&-
+}
+
+actual=$(session 'add_item dana Books Good x
+login rob pw
+add_item rob Books Good x
+add_item dana Books Good x
+approve rob 1
+wish rob Books any
+request rob 1')
+expect_output "a recipient's session" 'error not logged in
+ok recipient
+error only a donor can do that
+error logged in as rob
+error only a donor can do that
+ok 1
+ok 1
+ok bye' "$actual"
+
+padding=$(printf 'x%.0s' $(seq 1 506))
+actual=$(session "login dana pw
+request dana 1
+wish dana any any
+find $padding signup mallory pw donor
+login mallory pw
+approve dana 1")
+expect_output "a donor's session" 'ok donor
+error only a recipient can do that
+error only a recipient can do that
+error line too long
+error invalid credentials
+ok
+ok bye' "$actual"
+
+kill -INT $server
+wait $server
+finish